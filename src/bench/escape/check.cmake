@@ -0,0 +1,26 @@
+# `nl_escape_check`目标中执行：cmake -DNL=<nl> -DWORK_DIR=<dir> -P check.cmake
+# 汇编本目录中的每个程序，分别开启和关闭逃逸分析运行，退出码或输出不同时失败
+FILE(GLOB PROGRAMS ${CMAKE_CURRENT_LIST_DIR}/*.nas)
+FOREACH(PROGRAM ${PROGRAMS})
+    GET_FILENAME_COMPONENT(NAME ${PROGRAM} NAME_WE)
+    SET(NLC ${WORK_DIR}/escape_${NAME}.nlc)
+    EXECUTE_PROCESS(COMMAND ${NL} asm ${PROGRAM} ${NLC} RESULT_VARIABLE RESULT)
+    IF(NOT RESULT EQUAL 0)
+        MESSAGE(FATAL_ERROR "${NAME}: nl asm failed")
+    ENDIF()
+
+    EXECUTE_PROCESS(COMMAND ${NL} run --no-escape-analysis ${NLC}
+                    OUTPUT_VARIABLE EXPECTED ERROR_VARIABLE EXPECTED_ERROR RESULT_VARIABLE EXPECTED_RESULT)
+    IF(NOT EXPECTED_RESULT EQUAL 0)
+        MESSAGE(FATAL_ERROR "${NAME}: failed without escape analysis\n${EXPECTED_ERROR}")
+    ENDIF()
+
+    EXECUTE_PROCESS(COMMAND ${NL} run ${NLC}
+                    OUTPUT_VARIABLE ACTUAL ERROR_VARIABLE ACTUAL_ERROR RESULT_VARIABLE ACTUAL_RESULT)
+    IF(NOT ACTUAL_RESULT STREQUAL EXPECTED_RESULT OR NOT ACTUAL STREQUAL EXPECTED)
+        MESSAGE(FATAL_ERROR "${NAME}: the output differs with escape analysis\n"
+                            "without: ${EXPECTED}\nwith:    ${ACTUAL}${ACTUAL_ERROR}")
+    ENDIF()
+
+    MESSAGE(STATUS "${NAME}: ok")
+ENDFOREACH()
\ No newline at end of file
@@ -0,0 +1,74 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 13:10:27
+ * @Description: 基准测试所用的外部函数
+ */
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include "nl.hpp"
+
+NL_EXPORT_ABI_VERSION;
+NL_EXPORT_BORROWS_ARGS;     // 只读取或增长参数，见`escape/calle_grow.nas`
+
+extern "C" {
+    std::vector<std::string>* driver(void) {
+        std::vector<std::string>* externFNNameTable = new std::vector<std::string>();
+        *externFNNameTable = { "bench_nop", "bench_sleep", "bench_push" };
+
+        return externFNNameTable;
+    }
+
+    // 什么也不做，只用于测量`CALLE`本身的开销
+    NlObject* bench_nop(Nlthread* thread, ListObject* args) {
+        NlObject* returnValue = new NlObject();
+        returnValue -> type = NUM;
+        returnValue -> num = 0;
+
+        return returnValue;
+    }
+
+    // 等待的定时器，按调用线程区分，`nlWait`后以相同参数重新调用时取回
+    static std::mutex timerMutex;
+    static std::map<Nlthread*, int> timers;
+
+    // 用`timerfd`等待参数指定的毫秒数，等待期间通过`nlWait`挂起，用于测量大量任务同时等待I/O时的调度开销
+    NlObject* bench_sleep(Nlthread* thread, ListObject* args) {
+        std::lock_guard<std::mutex> lock(timerMutex);
+        auto timer = timers.find(thread);
+        if(timer == timers.end()) {
+            long ms = args -> size() ? (long)(*args)[0].num : 0;
+            int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+            itimerspec spec = {};
+            spec.it_value.tv_sec = ms / 1000;
+            spec.it_value.tv_nsec = ms % 1000 * 1000000 + 1;    // 全为`0`时定时器不启动
+            timerfd_settime(fd, 0, &spec, nullptr);
+            timers[thread] = fd;
+            return nlWait(thread, fd, NL_READABLE);
+        }
+
+        uint64_t expirations;
+        if(read(timer -> second, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+            return nlWait(thread, timer -> second, NL_READABLE);
+        }
+
+        close(timer -> second);
+        timers.erase(timer);
+        return bench_nop(thread, args);
+    }
+
+    // 把第二个参数追加到第一个参数（`list`）末尾，用于检查逃逸分析对外部函数增长参数的处理（见`escape/calle_grow.nas`）
+    NlObject* bench_push(Nlthread* thread, ListObject* args) {
+        if(args -> size() == 2 && (*args)[0].type == POINTER) {
+            ((ListObject*)(*args)[0].pointer) -> push_back((*args)[1]);
+        }
+
+        return bench_nop(thread, args);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,207 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 15:10:19
+ * @Description: 合成程序生成器：通过`Ndr`生成指定规模、指令组合的合法nl程序
+ */
+#include "gen.hpp"
+
+static const size_t localNum = 8;  // 每个函数中使用的数字局部变量`v0`～`v7`
+
+Ngen::Ngen(Option _option) : option(_option), random(_option.seed) {
+    if(option.labels < option.functions + 1) {
+        option.labels = option.functions + 1;  // 每个函数至少一个基本块
+    }
+
+    if(option.constants < 1) option.constants = 1;
+    if(option.strings < 1) option.strings = 1;
+
+    std::vector<int> weights;
+    for(auto& kind : option.mix) {
+        if(kind.second > 0) {
+            kinds.push_back(kind.first);
+            weights.push_back(kind.second);
+        }
+    }
+
+    if(kinds.empty()) {
+        error("Ngen: instruction mix is empty");
+    }
+
+    pick = std::discrete_distribution<int>(weights.begin(), weights.end());
+}
+
+std::map<std::string, int> Ngen::parseMix(std::string text) {
+    std::map<std::string, int> mix;
+    size_t begin = 0;
+    while(begin < text.length()) {
+        size_t end = text.find(',', begin);
+        if(end == std::string::npos) {
+            end = text.length();
+        }
+
+        std::string item = text.substr(begin, end - begin);
+        size_t equal = item.find('=');
+        if(equal == std::string::npos) {
+            error("Ngen: bad mix item: " + item);
+        }
+
+        std::string kind = item.substr(0, equal);
+        if(kind != "load" && kind != "arith" && kind != "compare" && kind != "call"
+        && kind != "list" && kind != "map" && kind != "string") {
+            error("Ngen: unknown mix kind: " + kind);
+        }
+
+        mix[kind] = atoi(item.c_str() + equal + 1);
+        begin = end + 1;
+    }
+
+    return mix;
+}
+
+NlcFile::Num Ngen::number(void) {
+    return random() % option.constants + 1;    // 不为`0`，避免`DIV`、`MOD`报错
+}
+
+std::string Ngen::string(void) {
+    return "str_" + std::to_string(random() % option.strings);
+}
+
+std::string Ngen::local(void) {
+    return "v" + std::to_string(random() % localNum);
+}
+
+// 定义函数中用到的局部变量
+void Ngen::prologue(Ndr& ndr, std::shared_ptr<Ndr::Block> block) {
+    for(size_t i = 0; i < localNum; i ++) {
+        ndr.newInstrLoadNum(block, i + 1);
+        ndr.newInstrStoreLocal(block, "v" + std::to_string(i));
+    }
+
+    ndr.newInstrMakeList(block);
+    ndr.newInstrStoreLocal(block, "list");
+    ndr.newInstrMakeMap(block);
+    ndr.newInstrStoreLocal(block, "map");
+    instrNum += localNum * 2 + 4;
+}
+
+void Ngen::statement(Ndr& ndr, std::shared_ptr<Ndr::Block> block, size_t function) {
+    std::string kind = kinds[pick(random)];
+
+    // 每个函数最多被调用一次，且只调用编号比自己大的函数，使执行的指令条数与程序规模成线性关系
+    if(kind == "call" && (called + 1 >= functions.size() || called + 1 <= function)) {
+        kind = "load";
+    }
+
+    if(kind == "load") {
+        ndr.newInstrLoadNum(block, number());
+        ndr.newInstrStoreLocal(block, local());
+        instrNum += 2;
+    } else if(kind == "arith") {
+        static void (Ndr::*ops[])(std::shared_ptr<Ndr::Block>) = {
+            &Ndr::newInstrAdd, &Ndr::newInstrSub, &Ndr::newInstrMul, &Ndr::newInstrDiv, &Ndr::newInstrMod,
+        };
+
+        std::string name = local();
+        ndr.newInstrLoadNum(block, number());
+        ndr.newInstrLoadLocal(block, name);
+        (ndr.*ops[random() % 5])(block);
+        ndr.newInstrStoreLocal(block, name);
+        instrNum += 4;
+    } else if(kind == "compare") {
+        static const char* ops[] = { "LES", "LE", "GRE", "GE", "EQU", "NE" };
+        ndr.newInstrLoadLocal(block, local());
+        ndr.newInstrLoadNum(block, number());
+        ndr.newInstrCompare(block, ops[random() % 6]);
+        ndr.newInstrPopTop(block);
+        instrNum += 5;
+    } else if(kind == "call") {
+        size_t callee = ++ called;
+        ndr.newInstrMakeList(block);
+        ndr.newInstrLoadNum(block, number());
+        ndr.newInstrActionList(block, "PUSH");
+        ndr.newInstrLoadAddr(block, functions[callee].blocks[0] -> name);
+        ndr.newInstrCall(block);
+        ndr.newInstrPopTop(block);
+        instrNum += 7;
+    } else if(kind == "list") {
+        ndr.newInstrLoadLocal(block, "list");
+        ndr.newInstrLoadNum(block, number());
+        ndr.newInstrActionList(block, "PUSH");
+        ndr.newInstrPopTop(block);
+        instrNum += 5;
+    } else if(kind == "map") {
+        ndr.newInstrLoadLocal(block, "map");
+        ndr.newInstrLoadString(block, string());
+        ndr.newInstrLoadNum(block, number());
+        ndr.newInstrActionMap(block, "ASSIGN");
+        ndr.newInstrPopTop(block);
+        instrNum += 6;
+    } else if(kind == "string") {
+        ndr.newInstrLoadString(block, string());
+        ndr.newInstrLoadString(block, string());
+        ndr.newInstrCompare(block, "EQU");
+        ndr.newInstrPopTop(block);
+        instrNum += 5;
+    }
+}
+
+// 条件跳转与无条件跳转都到达`next`，两条路径上条件值都留在栈上，由`next`开头的`POP_TOP`弹出
+void Ngen::terminator(Ndr& ndr, std::shared_ptr<Ndr::Block> block, std::shared_ptr<Ndr::Block> next) {
+    ndr.newInstrLoadLocal(block, local());
+    ndr.newInstrLoadNum(block, number());
+    ndr.newInstrCompare(block, "LES");
+    ndr.newInstrJmpc(block, next -> name);
+    ndr.newInstrJmp(block, next -> name);
+    instrNum += 6;
+}
+
+void Ngen::build(Ndr& ndr) {
+    srand(option.seed);    // `Ndr::newBlock`用`rand`生成基本块名的后缀
+    instrNum = 0;
+    called = 0;
+
+    // 基本块平均分配给主程序和各函数，主程序分得余数部分
+    functions.assign(option.functions + 1, Function());
+    for(size_t f = 0; f < functions.size(); f ++) {
+        size_t blockNum = option.labels / functions.size() + (f == 0 ? option.labels % functions.size() : 0);
+        std::string prefix = (f == 0 ? "main" : "fn" + std::to_string(f) + "_");
+        for(size_t b = 0; b < blockNum; b ++) {
+            functions[f].blocks.push_back(ndr.newBlock(prefix));
+        }
+    }
+
+    ndr.setBeginBlock(functions[0].blocks[0]);
+
+    // 除前导部分、跳转及函数结尾外的指令按基本块平均分配
+    size_t overhead = functions.size() * (localNum * 2 + 5) + option.labels * 7;
+    size_t statementInstrs = (option.instrs > overhead ? option.instrs - overhead : 0) / option.labels;
+    for(size_t f = 0; f < functions.size(); f ++) {
+        std::vector<std::shared_ptr<Ndr::Block>>& blocks = functions[f].blocks;
+        prologue(ndr, blocks[0]);
+
+        for(size_t b = 0; b < blocks.size(); b ++) {
+            if(b > 0) {
+                ndr.newInstrPopTop(blocks[b]);
+                instrNum ++;
+            }
+
+            size_t target = instrNum + statementInstrs;
+            while(instrNum < target) {
+                statement(ndr, blocks[b], f);
+            }
+
+            if(b + 1 < blocks.size()) {
+                terminator(ndr, blocks[b], blocks[b + 1]);
+            }
+        }
+
+        // 函数返回参数列表，主程序结束
+        if(f == 0) {
+            ndr.newInstrExit(blocks.back());
+        } else {
+            ndr.newInstrRet(blocks.back());
+        }
+
+        instrNum ++;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 15:02:44
+ * @Description: 合成程序生成器头文件
+ */
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdlib>
+
+#include "ndr.hpp"
+#include "global.hpp"
+
+/*
+ * `Ngen`用法：
+ * 通过`Ndr`的构建接口生成指定规模的合法nl程序，用于测试工具链各阶段随程序规模的变化
+ * 程序由主程序和`functions`个函数组成，共`labels`个基本块，每个基本块由若干栈平衡的语句组成，
+ * 以`COMPARE`加`JMPC`、`JMP`跳至下一个基本块结尾（下一个基本块以`POP_TOP`弹出条件），所以程序只向前跳转，必然终止
+ * 语句按`mix`中的权重随机选取，数字和字符串常量分别取自大小为`constants`、`strings`的池，
+ * 函数只调用编号比自己大且未被调用过的函数，所以没有递归，每个函数最多执行一次；相同的`seed`生成相同的程序
+ */
+class Ngen {
+public:
+    struct Option {
+        size_t instrs = 1000;       // 目标指令条数（近似，最后一条语句可能略微超出）
+        size_t labels = 64;
+        size_t constants = 256;
+        size_t strings = 256;
+        size_t functions = 8;
+        unsigned seed = 1;
+        std::map<std::string, int> mix = {
+            { "load", 4 }, { "arith", 3 }, { "compare", 1 }, { "call", 1 },
+            { "list", 1 }, { "map", 1 }, { "string", 1 },
+        };
+    };
+
+    Ngen(Option _option);
+
+    // 解析形如`load=4,arith=3`的指令组合，未写出的语句类别权重为`0`
+    static std::map<std::string, int> parseMix(std::string text);
+
+    void build(Ndr& ndr);
+    size_t instrNum = 0;    // 实际生成的指令条数
+
+private:
+    Option option;
+    std::mt19937 random;
+
+    std::vector<std::string> kinds;
+    std::discrete_distribution<int> pick;
+
+    // 一个函数（主程序编号为`0`）的基本块
+    struct Function {
+        std::vector<std::shared_ptr<Ndr::Block>> blocks;
+    };
+
+    std::vector<Function> functions;
+    size_t called = 0;  // 已被调用的函数中最大的编号
+
+    NlcFile::Num number(void);
+    std::string string(void);
+    std::string local(void);
+
+    void prologue(Ndr& ndr, std::shared_ptr<Ndr::Block> block);
+    void statement(Ndr& ndr, std::shared_ptr<Ndr::Block> block, size_t function);
+    void terminator(Ndr& ndr, std::shared_ptr<Ndr::Block> block, std::shared_ptr<Ndr::Block> next);
+};
\ No newline at end of file
@@ -0,0 +1,101 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 14:04:37
+ * @Description: 各阶段微基准测试的公共计时部分
+ */
+#include "micro.hpp"
+
+Micro::Options Micro::options;
+
+void Micro::fail(std::string message) {
+    std::cerr << "micro ERROR: " << message << '\n';
+    exit(- 1);
+}
+
+void Micro::parse(int argc, char** argv) {
+    for(int i = 1; i < argc; i ++) {
+        std::string arg = argv[i];
+        if(arg == "--warmup" && i + 1 < argc) {
+            options.warmup = atoi(argv[++ i]);
+        } else if(arg == "--repeats" && i + 1 < argc) {
+            options.repeats = atoi(argv[++ i]);
+        } else if(arg == "--scale" && i + 1 < argc) {
+            options.scale = atof(argv[++ i]);
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--warmup <n>] [--repeats <n>] [--scale <x>]\n";
+            exit(- 1);
+        }
+    }
+
+    if(options.warmup < 0 || options.repeats < 1 || options.scale <= 0) {
+        fail("invalid options");
+    }
+}
+
+static cpu_set_t unpinned;   // `pin`之前的绑定
+static bool pinned = false;
+
+void Micro::pin(void) {
+    pinned = sched_getaffinity(0, sizeof(unpinned), &unpinned) == 0;
+    int cpu = sched_getcpu();
+    if(cpu < 0) {
+        return;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if(sched_setaffinity(0, sizeof(set), &set) != 0) {
+        std::cerr << "micro WARNING: cannot pin to cpu " << cpu << '\n';
+    }
+}
+
+void Micro::unpin(void) {
+    if(pinned) {
+        sched_setaffinity(0, sizeof(unpinned), &unpinned);
+    }
+}
+
+double Micro::now(void) {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+Micro::Result Micro::measure(std::function<void(void)> fn) {
+    for(int i = 0; i < options.warmup; i ++) {
+        fn();
+    }
+
+    std::vector<double> times;
+    for(int i = 0; i < options.repeats; i ++) {
+        double begin = now();
+        fn();
+        times.push_back(now() - begin);
+    }
+
+    Result result;
+    result.median = median(times);
+    result.min = *std::min_element(times.begin(), times.end());
+    for(auto& time : times) {
+        time = time > result.median ? time - result.median : result.median - time;
+    }
+
+    result.mad = median(times);
+    return result;
+}
+
+std::string Micro::tempDir(void) {
+    char path[] = "/tmp/nlmicroXXXXXX";
+    if(! mkdtemp(path)) {
+        fail("mkdtemp error");
+    }
+
+    return path;
+}
\ No newline at end of file
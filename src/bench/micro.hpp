@@ -0,0 +1,50 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 14:02:10
+ * @Description: 各阶段微基准测试的公共计时部分头文件
+ */
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+
+/*
+ * `Micro`用法：
+ * 1. `Micro::parse`解析公共参数`--warmup <n>`、`--repeats <n>`、`--scale <x>`（`scale`用于按比例缩放输入规模）
+ * 2. `Micro::pin`把进程绑定到当前所在的CPU上，避免测量过程中被调度到其他核心导致缓存失效；测量多线程时在各线程中调用`Micro::unpin`恢复绑定前的设置
+ * 3. `Micro::measure`先运行`warmup`次不计时，再运行`repeats`次并返回耗时（秒）的中位数、最小值及中位数绝对偏差
+ */
+namespace Micro {
+    struct Options {
+        int warmup = 2;
+        int repeats = 9;
+        double scale = 1;
+    };
+
+    struct Result {
+        double median;
+        double min;
+        double mad;
+    };
+
+    extern Options options;
+
+    void parse(int argc, char** argv);
+    void pin(void);
+    void unpin(void);   // 只作用于调用线程
+    double now(void);
+    Result measure(std::function<void(void)> fn);
+
+    std::string tempDir(void);     // 在`/tmp`中创建本次运行使用的临时目录
+    void fail(std::string message);
+}
\ No newline at end of file
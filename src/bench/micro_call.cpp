@@ -0,0 +1,161 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 18:40:26
+ * @Description: 微基准测试：嵌入接口`Nlib`反复调用同一函数的开销，与每次重新加载程序及每次新建隔离区比较
+ */
+#include "micro.hpp"
+#include "nas.hpp"
+#include "nlib.hpp"
+
+// `fib`与`fib.nas`相同，`fail`用于测量出错并恢复上下文的开销
+static const char* program =
+    "JMP $main\n"
+    "fib:\n"
+    "LOAD_NUM 0\nLOAD_STRING \"GET\"\nACTION_LIST\nSTORE_LOCAL \"n\"\nPOP_TOP\n"
+    "LOAD_LOCAL \"n\"\nLOAD_NUM 2\nLOAD_STRING \"LES\"\nCOMPARE\nJMPC $fib_base\nPOP_TOP\n"
+    "MAKE_LIST\nLOAD_NUM 1\nLOAD_LOCAL \"n\"\nSUB\nLOAD_STRING \"PUSH\"\nACTION_LIST\nLOAD_ADDR $fib\nCALL\n"
+    "MAKE_LIST\nLOAD_NUM 2\nLOAD_LOCAL \"n\"\nSUB\nLOAD_STRING \"PUSH\"\nACTION_LIST\nLOAD_ADDR $fib\nCALL\n"
+    "ADD\nRET\n"
+    "fib_base:\nPOP_TOP\nLOAD_LOCAL \"n\"\nRET\n"
+    "fail:\nLOAD_LOCAL \"undefined\"\nRET\n"
+    "main:\nEXIT\n";
+
+int main(int argc, char** argv) {
+    Micro::parse(argc, argv);
+    Micro::pin();
+
+    std::string dir = Micro::tempDir();
+    std::string nlc = dir + "/call.nlc";
+    Nas(program, nlc);
+
+    Nlib lib;
+    if(lib.load(nlc) != nl_ok) {
+        Micro::fail(lib.message);
+    }
+
+    Nlthread* context = lib.newContext();
+    if(lib.run(context) != nl_ok) {
+        Micro::fail(lib.message);
+    }
+
+    size_t calls = 1000 * Micro::options.scale;
+    auto warm = [&](const char* label, long double n, NlStatus expected) {
+        NlObject arg;
+        arg.type = NUM;
+        arg.num = n;
+        return Micro::measure([&] {
+            for(size_t i = 0; i < calls; i ++) {
+                NlObject result;
+                if(lib.call(context, label, { arg }, result) != expected) {
+                    Micro::fail(lib.message);
+                }
+            }
+        });
+    };
+
+    // 每次调用都重新加载程序并建立上下文，相当于进程内的“每次执行一个进程”
+    auto cold = [&](long double n) {
+        NlObject arg;
+        arg.type = NUM;
+        arg.num = n;
+        return Micro::measure([&] {
+            for(size_t i = 0; i < calls; i ++) {
+                Nlib fresh;
+                fresh.load(nlc);
+                Nlthread* freshContext = fresh.newContext();
+                NlObject result;
+                if(fresh.run(freshContext) != nl_ok || fresh.call(freshContext, "fib", { arg }, result) != nl_ok) {
+                    Micro::fail(fresh.message);
+                }
+
+                fresh.freeContext(freshContext);
+            }
+        });
+    };
+
+    // 每次调用都新建一个共用`lib`程序的隔离区，只省去读取文件的部分
+    auto isolate = [&](long double n) {
+        NlObject arg;
+        arg.type = NUM;
+        arg.num = n;
+        return Micro::measure([&] {
+            for(size_t i = 0; i < calls; i ++) {
+                Nlib fresh;
+                fresh.share(lib);
+                Nlthread* freshContext = fresh.newContext();
+                NlObject result;
+                if(fresh.run(freshContext) != nl_ok || fresh.call(freshContext, "fib", { arg }, result) != nl_ok) {
+                    Micro::fail(fresh.message);
+                }
+
+                fresh.freeContext(freshContext);
+            }
+        });
+    };
+
+    // 每个系统线程一个隔离区，共`calls`次调用平均分给各线程，多核时每次调用的平均耗时应随线程数近似线性下降
+    auto concurrent = [&](size_t threadNum, long double n) {
+        NlObject arg;
+        arg.type = NUM;
+        arg.num = n;
+        std::vector<std::unique_ptr<Nlib>> isolates;
+        std::vector<Nlthread*> contexts;
+        for(size_t t = 0; t < threadNum; t ++) {
+            isolates.emplace_back(new Nlib());
+            if(isolates.back() -> share(lib) != nl_ok) {
+                Micro::fail(isolates.back() -> message);
+            }
+
+            contexts.push_back(isolates.back() -> newContext());
+            isolates.back() -> run(contexts.back());
+        }
+
+        Micro::Result result = Micro::measure([&] {
+            std::vector<std::thread> threads;
+            for(size_t t = 0; t < threadNum; t ++) {
+                threads.emplace_back([&, t]() {
+                    Micro::unpin();
+                    for(size_t i = t; i < calls; i += threadNum) {
+                        NlObject value;
+                        if(isolates[t] -> call(contexts[t], "fib", { arg }, value) != nl_ok) {
+                            Micro::fail(isolates[t] -> message);
+                        }
+                    }
+                });
+            }
+
+            for(auto& thread : threads) {
+                thread.join();
+            }
+        });
+
+        for(size_t t = 0; t < threadNum; t ++) {
+            isolates[t] -> freeContext(contexts[t]);
+        }
+
+        return result;
+    };
+
+    printf("%-16s %12s %10s %14s\n", "call", "us/call", "mad %", "calls/s");
+    auto row = [&](std::string name, Micro::Result result) {
+        double perCall = result.median / calls;
+        printf("%-16s %12.3f %10.2f %14.0f\n", name.c_str(), perCall * 1e6, result.mad / result.median * 100, 1 / perCall);
+    };
+
+    for(int n : { 1, 10, 15 }) {
+        row("fib(" + std::to_string(n) + ")", warm("fib", n, nl_ok));
+    }
+
+    row("fail", warm("fail", 0, nl_runtime_error));
+    row("cold fib(1)", cold(1));
+    row("isolate fib(1)", isolate(1));
+
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    for(size_t threadNum = 1; threadNum <= cores; threadNum *= 2) {
+        row(std::to_string(threadNum) + "x fib(10)", concurrent(threadNum, 10));
+    }
+
+    lib.freeContext(context);
+    std::filesystem::remove_all(dir);
+    return 0;
+}
\ No newline at end of file
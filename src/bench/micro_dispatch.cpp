@@ -0,0 +1,127 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 14:37:15
+ * @Description: 微基准测试：分派循环中每种`Mnem`的单条指令开销
+ */
+#include "micro.hpp"
+#include "nas.hpp"
+#include "nvm.hpp"
+
+/*
+ * 每种指令用一段栈平衡的代码片段测量，片段中除被测指令外的辅助指令（压入操作数、弹出结果等）称为`helpers`
+ * 片段展开`copies`次成直线代码，减去只有前导部分的空程序的耗时后得到每个片段的耗时，
+ * 再减去已测得的辅助指令的开销得到被测指令本身的开销，所以表中的指令需按依赖顺序排列
+ * `LOAD_NUM`单独连续执行（操作数栈随之增长），以此作为其他片段的基础
+ * 片段中的`{}`替换为片段的序号，用于生成不重复的标签名
+ * `IMPORT`（重复导入同名外部函数会报错）与`EXIT`（只能执行一次）不测量
+ * `arena`为`true`的片段以`NvmOption::arena`执行，对象从请求作用域的`arena`分配
+ */
+struct Case {
+    const char* name;
+    const char* snippet;
+    std::vector<const char*> helpers;
+    bool arena = false;
+};
+
+static const std::vector<Case> cases = {
+    { "NOP",          "NOP\n", {} },
+    { "LOAD_NUM",     "LOAD_NUM 2\n", {} },
+    { "POP_TOP",      "LOAD_NUM 2\nPOP_TOP\n", { "LOAD_NUM" } },
+    { "LOAD_STRING",  "LOAD_STRING \"s\"\nPOP_TOP\n", { "POP_TOP" } },
+    { "LOAD_LOCAL",   "LOAD_LOCAL \"x\"\nPOP_TOP\n", { "POP_TOP" } },
+    { "LOAD_GLOBAL",  "LOAD_GLOBAL \"g\"\nPOP_TOP\n", { "POP_TOP" } },
+    { "LOAD_ADDR",    "LOAD_ADDR $f\nPOP_TOP\n", { "POP_TOP" } },
+    { "STORE_LOCAL",  "LOAD_NUM 2\nSTORE_LOCAL \"y\"\n", { "LOAD_NUM" } },
+    { "STORE_GLOBAL", "LOAD_NUM 2\nSTORE_GLOBAL \"h\"\n", { "LOAD_NUM" } },
+    { "ADD",          "LOAD_NUM 2\nLOAD_NUM 3\nADD\nPOP_TOP\n", { "LOAD_NUM", "LOAD_NUM", "POP_TOP" } },
+    { "SUB",          "LOAD_NUM 2\nLOAD_NUM 3\nSUB\nPOP_TOP\n", { "LOAD_NUM", "LOAD_NUM", "POP_TOP" } },
+    { "MUL",          "LOAD_NUM 2\nLOAD_NUM 3\nMUL\nPOP_TOP\n", { "LOAD_NUM", "LOAD_NUM", "POP_TOP" } },
+    { "DIV",          "LOAD_NUM 2\nLOAD_NUM 3\nDIV\nPOP_TOP\n", { "LOAD_NUM", "LOAD_NUM", "POP_TOP" } },
+    { "MOD",          "LOAD_NUM 2\nLOAD_NUM 3\nMOD\nPOP_TOP\n", { "LOAD_NUM", "LOAD_NUM", "POP_TOP" } },
+    { "POW",          "LOAD_NUM 2\nLOAD_NUM 3\nPOW\nPOP_TOP\n", { "LOAD_NUM", "LOAD_NUM", "POP_TOP" } },
+    { "NOT",          "LOAD_NUM 2\nNOT\nPOP_TOP\n", { "LOAD_NUM", "POP_TOP" } },
+    { "COMPARE",      "LOAD_NUM 2\nLOAD_NUM 3\nLOAD_STRING \"LES\"\nCOMPARE\nPOP_TOP\n", { "LOAD_NUM", "LOAD_NUM", "LOAD_STRING", "POP_TOP" } },
+    { "JMP",          "JMP $j{}\nj{}:\n", {} },
+    { "JMPC",         "LOAD_NUM 1\nJMPC $c{}\nc{}:\nPOP_TOP\n", { "LOAD_NUM", "POP_TOP" } },
+    { "MAKE_LIST",    "MAKE_LIST\nPOP_TOP\n", { "POP_TOP" } },
+    { "MAKE_MAP",     "MAKE_MAP\nPOP_TOP\n", { "POP_TOP" } },
+    { "CALL+RET",     "MAKE_LIST\nLOAD_ADDR $f\nCALL\nPOP_TOP\n", { "MAKE_LIST", "LOAD_ADDR", "POP_TOP" } },
+    { "ACTION_LIST",  "LOAD_LOCAL \"l\"\nLOAD_NUM 0\nLOAD_STRING \"GET\"\nACTION_LIST\nPOP_TOP\nPOP_TOP\n",
+                      { "LOAD_LOCAL", "LOAD_NUM", "LOAD_STRING", "POP_TOP", "POP_TOP" } },
+    { "ACTION_MAP",   "LOAD_LOCAL \"m\"\nLOAD_STRING \"k\"\nLOAD_STRING \"GET\"\nACTION_MAP\nPOP_TOP\nPOP_TOP\n",
+                      { "LOAD_LOCAL", "LOAD_STRING", "LOAD_STRING", "POP_TOP", "POP_TOP" } },
+    { "CALLE",        "MAKE_LIST\nLOAD_STRING \"bench_nop\"\nCALLE\nPOP_TOP\n", { "MAKE_LIST", "LOAD_STRING", "POP_TOP" } },
+    { "SPAWN+JOIN",   "MAKE_LIST\nLOAD_ADDR $f\nSPAWN\nJOIN\nPOP_TOP\n", { "MAKE_LIST", "LOAD_ADDR", "POP_TOP" } },
+    { "TASK+AWAIT",   "MAKE_LIST\nLOAD_ADDR $f\nTASK\nAWAIT\nPOP_TOP\n", { "MAKE_LIST", "LOAD_ADDR", "POP_TOP" } },
+    { "SEND+RECV",    "LOAD_LOCAL \"c\"\nLOAD_NUM 1\nSEND\nRECV\nPOP_TOP\nPOP_TOP\nPOP_TOP\n",
+                      { "LOAD_LOCAL", "LOAD_NUM", "POP_TOP", "POP_TOP", "POP_TOP" } },
+    { "MAKE_LIST/a",  "MAKE_LIST\nPOP_TOP\n", { "POP_TOP" }, true },
+    { "MAKE_MAP/a",   "MAKE_MAP\nPOP_TOP\n", { "POP_TOP" }, true },
+    { "LOAD_ADDR/a",  "LOAD_ADDR $f\nPOP_TOP\n", { "POP_TOP" }, true },
+    { "PROMOTE/a",    "MAKE_LIST\nPROMOTE\nPOP_TOP\n", { "MAKE_LIST/a", "POP_TOP" }, true },
+};
+
+// 前导部分：导入外部函数，准备片段中用到的变量、`list`、`map`、通道及函数`f`
+static std::string prologue(void) {
+    return "LOAD_STRING \"" BENCHEXT_PATH "\"\nIMPORT\n"
+           "MAKE_LIST\nSTORE_LOCAL \"l\"\nLOAD_LOCAL \"l\"\nLOAD_NUM 1\nLOAD_STRING \"PUSH\"\nACTION_LIST\nPOP_TOP\n"
+           "MAKE_MAP\nSTORE_LOCAL \"m\"\nLOAD_LOCAL \"m\"\nLOAD_STRING \"k\"\nLOAD_NUM 1\nLOAD_STRING \"ASSIGN\"\nACTION_MAP\nPOP_TOP\n"
+           "LOAD_NUM 1\nSTORE_LOCAL \"x\"\nLOAD_NUM 1\nSTORE_GLOBAL \"g\"\n"
+           "LOAD_NUM 0\nMAKE_CHANNEL\nSTORE_LOCAL \"c\"\n"
+           "JMP $body\nf:\nRET\nbody:\n";
+}
+
+static std::string generate(const char* snippet, size_t copies) {
+    std::string src = prologue();
+    std::string text = snippet;
+    for(size_t i = 0; i < copies; i ++) {
+        std::string copy = text;
+        for(size_t position; (position = copy.find("{}")) != std::string::npos; ) {
+            copy.replace(position, 2, std::to_string(i));
+        }
+
+        src += copy;
+    }
+
+    return src + "EXIT\n";
+}
+
+int main(int argc, char** argv) {
+    Micro::parse(argc, argv);
+    Micro::pin();
+
+    std::string dir = Micro::tempDir();
+    std::string nlc = dir + "/dispatch.nlc";
+    size_t copies = 20000 * Micro::options.scale;
+
+    auto run = [&](const char* snippet, size_t n, bool arena) {
+        NvmOption option;
+        option.arena = arena;
+        Nas(generate(snippet, n), nlc);
+        return Micro::measure([&] {
+            Nvm nvm(nlc, option);
+            nvm.run();
+        });
+    };
+
+    Micro::Result empty = run("", 0, false);
+    Micro::Result emptyArena = run("", 0, true);
+
+    std::map<std::string, double> cost;    // 每条指令的开销（纳秒）
+    printf("%-13s %14s %10s %14s\n", "mnem", "ns/snippet", "mad %", "ns/instr");
+    for(auto& c : cases) {
+        Micro::Result result = run(c.snippet, copies, c.arena);
+        double snippet = (result.median - (c.arena ? emptyArena : empty).median) * 1e9 / copies;
+
+        double instr = snippet;
+        for(auto helper : c.helpers) {
+            instr -= cost.at(helper);
+        }
+
+        cost[c.name] = instr;
+        printf("%-13s %14.1f %10.2f %14.1f\n", c.name, snippet, result.mad / result.median * 100, instr);
+    }
+
+    std::filesystem::remove_all(dir);
+    return 0;
+}
\ No newline at end of file
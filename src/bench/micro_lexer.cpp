@@ -0,0 +1,53 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 14:10:26
+ * @Description: 微基准测试：`Nfe::getToken`的吞吐量（MB/s）
+ */
+#include "micro.hpp"
+#include "nfe.hpp"
+
+// 生成包含关键字、标识符、各进制数字、字符串、运算符、连接符及注释的源码，大小约为`bytes`字节
+static std::string generate(size_t bytes) {
+    const char* lines[] = {
+        "let value_%zu = 0x1f + 3.25 * count_%zu ;\n",
+        "const name%zu = \"string literal %zu\" ;\n",
+        "if ( a%zu >= 0b101 && b%zu != .5e3 ) { x = x ** 2 ; }\n",
+        "// comment line %zu %zu\n",
+        "fn f%zu ( a , b ) => a - b % 0755 - n%zu ;\n",
+    };
+
+    std::string src;
+    char buffer[128];
+    for(size_t i = 0; src.size() < bytes; i ++) {
+        snprintf(buffer, sizeof(buffer), lines[i % 5], i, i);
+        src += buffer;
+    }
+
+    return src;
+}
+
+int main(int argc, char** argv) {
+    Micro::parse(argc, argv);
+    Micro::pin();
+
+    printf("%-10s %10s %12s %10s %10s\n", "bytes", "tokens", "median ms", "mad %", "MB/s");
+    for(size_t size : { 1 << 16, 1 << 20, 1 << 22 }) {
+        Nfe nfe(generate(size * Micro::options.scale));
+
+        size_t tokens = 0;
+        Micro::Result result = Micro::measure([&] {
+            nfe.index = 0;
+            tokens = 0;
+            do {
+                nfe.getToken();
+                tokens ++;
+            } while(nfe.token != Nfe::tok_eof);
+        });
+
+        double bytes = nfe.src.size();
+        printf("%-10.0f %10zu %12.3f %10.2f %10.2f\n", bytes, tokens, result.median * 1000,
+               result.mad / result.median * 100, bytes / result.median / (1 << 20));
+    }
+
+    return 0;
+}
\ No newline at end of file
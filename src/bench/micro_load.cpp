@@ -0,0 +1,45 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 14:25:49
+ * @Description: 微基准测试：`Nvm`加载程序的耗时与常量池大小的关系
+ */
+#include "micro.hpp"
+#include "nas.hpp"
+#include "nvm.hpp"
+
+// 生成数字常量和字符串常量各`constants`个的程序，计时的部分只有加载，不执行
+static std::string generate(size_t constants) {
+    std::string src = "EXIT\n";
+    char buffer[128];
+    for(size_t i = 0; i < constants; i ++) {
+        snprintf(buffer, sizeof(buffer), "LOAD_NUM %zu\nLOAD_STRING \"constant string %zu\"\n", i, i);
+        src += buffer;
+    }
+
+    return src;
+}
+
+int main(int argc, char** argv) {
+    Micro::parse(argc, argv);
+    Micro::pin();
+
+    std::string dir = Micro::tempDir();
+    std::string nlc = dir + "/load.nlc";
+
+    printf("%-10s %10s %12s %10s %14s\n", "constants", "file KB", "median ms", "mad %", "ns/constant");
+    for(size_t size : { 1000, 10000, 100000, 1000000 }) {
+        size_t constants = size * Micro::options.scale;
+        Nas(generate(constants), nlc);
+
+        Micro::Result result = Micro::measure([&] {
+            Nvm nvm(nlc);
+        });
+
+        // 数字和字符串各`constants`个
+        printf("%-10zu %10ju %12.3f %10.2f %14.1f\n", constants, (uintmax_t)std::filesystem::file_size(nlc) / 1024,
+               result.median * 1000, result.mad / result.median * 100, result.median * 1e9 / (constants * 2));
+    }
+
+    std::filesystem::remove_all(dir);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 14:18:03
+ * @Description: 微基准测试：`Nas`汇编耗时与指令条数的关系及多MB输入的吞吐量
+ */
+#include "micro.hpp"
+#include "nas.hpp"
+#include "nmap.hpp"
+
+// 生成`instrs`条指令，每16条指令定义一个标签，数字和字符串常量各取自大小为1000的池
+static std::string generate(size_t instrs) {
+    std::string src;
+    char buffer[128];
+    for(size_t i = 0; i < instrs; i ++) {
+        if(i % 16 == 0) {
+            snprintf(buffer, sizeof(buffer), "label_%zu:\n", i / 16);
+            src += buffer;
+        }
+
+        switch(i % 8) {
+            case 0: snprintf(buffer, sizeof(buffer), "    LOAD_NUM %zu\n", i % 1000); break;
+            case 1: snprintf(buffer, sizeof(buffer), "    LOAD_STRING \"str_%zu\"\n", i % 1000); break;
+            case 2: snprintf(buffer, sizeof(buffer), "    LOAD_LOCAL \"var_%zu\"\n", i % 1000); break;
+            case 3: snprintf(buffer, sizeof(buffer), "    ADD\n"); break;
+            case 4: snprintf(buffer, sizeof(buffer), "    JMPC $label_%zu\n", i / 16); break;
+            case 5: snprintf(buffer, sizeof(buffer), "    STORE_LOCAL \"var_%zu\"\n", i % 1000); break;
+            case 6: snprintf(buffer, sizeof(buffer), "    LOAD_ADDR $label_%zu\n", i / 16); break;
+            case 7: snprintf(buffer, sizeof(buffer), "    POP_TOP\n"); break;
+        }
+
+        src += buffer;
+    }
+
+    return src;
+}
+
+int main(int argc, char** argv) {
+    Micro::parse(argc, argv);
+    Micro::pin();
+
+    std::string dir = Micro::tempDir();
+    std::string output = dir + "/out.nlc";
+
+    printf("%-10s %10s %12s %10s %12s %10s\n", "instrs", "src KB", "median ms", "mad %", "ns/instr", "MB/s");
+    for(size_t size : { 1000, 10000, 100000, 1000000 }) {
+        size_t instrs = size * Micro::options.scale;
+        std::string src = generate(instrs);
+
+        Micro::Result result = Micro::measure([&] {
+            Nas nas(src, output);
+        });
+
+        printf("%-10zu %10zu %12.3f %10.2f %12.1f %10.2f\n", instrs, src.size() / 1024, result.median * 1000,
+               result.mad / result.median * 100, result.median * 1e9 / instrs, src.size() / result.median / (1 << 20));
+    }
+
+    // 与`nl asm`相同的路径：从映射的源码文件汇编
+    size_t instrs = 1000000 * Micro::options.scale;
+    std::string input = dir + "/in.nas";
+    {
+        std::ofstream file(input, std::ios::binary);
+        file << generate(instrs);
+    }
+
+    Micro::Result result = Micro::measure([&] {
+        Nmap source(input);
+        Nas nas(source.view(), output);
+    });
+
+    size_t bytes = std::filesystem::file_size(input);
+    printf("%-10s %10zu %12.3f %10.2f %12.1f %10.2f\n", "mmap file", bytes / 1024, result.median * 1000,
+           result.mad / result.median * 100, result.median * 1e9 / instrs, bytes / result.median / (1 << 20));
+
+    std::filesystem::remove_all(dir);
+    return 0;
+}
\ No newline at end of file
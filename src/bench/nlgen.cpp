@@ -0,0 +1,70 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 15:31:52
+ * @Description: 合成程序生成工具：生成指定规模的nl汇编程序
+ */
+#include <fstream>
+#include <iostream>
+
+#include "gen.hpp"
+
+static void usage(void) {
+    std::cerr << "usage: nlgen [options] <out.nas|out.nlc>\n"
+                 "  output ending in .nlc is encoded to bytecode directly, otherwise assembly text is written\n"
+                 "  --instrs <n>       number of instructions (default 1000)\n"
+                 "  --labels <n>       number of labels / basic blocks (default 64)\n"
+                 "  --constants <n>    size of the number constant pool (default 256)\n"
+                 "  --strings <n>      size of the string constant pool (default 256)\n"
+                 "  --functions <n>    number of functions (default 8)\n"
+                 "  --mix <k=w,...>    statement weights, kinds: load arith compare call list map string\n"
+                 "  --seed <n>         random seed (default 1)\n";
+    exit(- 1);
+}
+
+int main(int argc, char** argv) {
+    Ngen::Option option;
+    std::string outputFileName = "";
+    for(int i = 1; i < argc; i ++) {
+        std::string arg = argv[i];
+        if(arg[0] != '-') {
+            outputFileName = arg;
+        } else if(i + 1 >= argc) {
+            usage();
+        } else if(arg == "--instrs") {
+            option.instrs = atof(argv[++ i]);  // 允许`1e6`这种写法
+        } else if(arg == "--labels") {
+            option.labels = atof(argv[++ i]);
+        } else if(arg == "--constants") {
+            option.constants = atof(argv[++ i]);
+        } else if(arg == "--strings") {
+            option.strings = atof(argv[++ i]);
+        } else if(arg == "--functions") {
+            option.functions = atof(argv[++ i]);
+        } else if(arg == "--mix") {
+            option.mix = Ngen::parseMix(argv[++ i]);
+        } else if(arg == "--seed") {
+            option.seed = atoi(argv[++ i]);
+        } else {
+            usage();
+        }
+    }
+
+    if(outputFileName == "") {
+        usage();
+    }
+
+    Ndr ndr;
+    Ngen gen(option);
+    gen.build(ndr);
+
+    std::ofstream output(outputFileName, std::ios::binary);
+    if(! output.is_open()) {
+        error(outputFileName + " open error");
+    }
+
+    bool bytecode = outputFileName.size() > 4 && outputFileName.substr(outputFileName.size() - 4) == ".nlc";
+    std::string content = bytecode ? ndr.encode() : ndr.codegen();
+    output.write(content.data(), content.size());
+    std::cerr << "nlgen: " << gen.instrNum << " instructions\n";
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,222 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 15:48:06
+ * @Description: 工具链规模测试：用`Ngen`生成从小到大的程序，统计`Ndr`、`Nas`、`Nvm`各阶段的耗时与峰值内存
+ */
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <functional>
+
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "gen.hpp"
+#include "nas.hpp"
+#include "nvm.hpp"
+
+struct StageResult {
+    std::vector<double> seconds;    // 子进程内计时的各部分耗时
+    long peakRSSKB;
+};
+
+static double now(void) {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// 每个阶段在单独的子进程中运行，使峰值内存互不影响；`fn`返回各部分的耗时，通过管道传回
+static StageResult stage(std::function<std::vector<double>(void)> fn) {
+    int pipeFD[2];
+    if(pipe(pipeFD) != 0) {
+        error("pipe error");
+    }
+
+    pid_t pid = fork();
+    if(pid < 0) {
+        error("fork error");
+    }
+
+    if(pid == 0) {
+        close(pipeFD[0]);
+        try {
+            std::vector<double> seconds = fn();
+            write(pipeFD[1], seconds.data(), seconds.size() * sizeof(double));
+        } catch(NlError& e) {
+            // 子进程不能让异常传回`stage`的调用者，否则会继续执行父进程的流程
+            std::cerr << "Nl ERROR: " << e.what() << '\n';
+            _exit(1);
+        }
+
+        _exit(0);
+    }
+
+    close(pipeFD[1]);
+    StageResult result;
+    double value;
+    while(read(pipeFD[0], &value, sizeof(value)) == sizeof(value)) {
+        result.seconds.push_back(value);
+    }
+
+    close(pipeFD[0]);
+
+    int status;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    if(! WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        error("stage failed");
+    }
+
+    result.peakRSSKB = usage.ru_maxrss;
+    return result;
+}
+
+static std::string readFile(std::string fileName) {
+    std::ifstream input(fileName);
+    if(! input.is_open()) {
+        error(fileName + " open error");
+    }
+
+    std::stringstream buffer;
+    buffer << input.rdbuf();
+    return buffer.str();
+}
+
+static void usage(void) {
+    std::cerr << "usage: nlscale [options]\n"
+                 "  --min <n> --max <n>      instruction counts, growing by 10x (default 1e3 to 1e6, up to 1e7)\n"
+                 "  --label-every <n>        one label per n instructions (default 16)\n"
+                 "  --constant-every <n>     one number and one string constant per n instructions (default 8)\n"
+                 "  --functions <n>          number of functions (default 8)\n"
+                 "  --mix <k=w,...>          statement weights, see nlgen\n"
+                 "  --work-dir <dir>         where generated files are written (default .)\n"
+                 "  --output <result.json>\n";
+    exit(- 1);
+}
+
+int main(int argc, char** argv) {
+    double minSize = 1e3, maxSize = 1e6, labelEvery = 16, constantEvery = 8;
+    std::string workDir = ".", outputFileName = "";
+    Ngen::Option base;
+    for(int i = 1; i < argc; i ++) {
+        std::string arg = argv[i];
+        if(i + 1 >= argc) {
+            usage();
+        } else if(arg == "--min") {
+            minSize = atof(argv[++ i]);
+        } else if(arg == "--max") {
+            maxSize = atof(argv[++ i]);
+        } else if(arg == "--label-every") {
+            labelEvery = atof(argv[++ i]);
+        } else if(arg == "--constant-every") {
+            constantEvery = atof(argv[++ i]);
+        } else if(arg == "--functions") {
+            base.functions = atof(argv[++ i]);
+        } else if(arg == "--mix") {
+            base.mix = Ngen::parseMix(argv[++ i]);
+        } else if(arg == "--work-dir") {
+            workDir = argv[++ i];
+        } else if(arg == "--output") {
+            outputFileName = argv[++ i];
+        } else {
+            usage();
+        }
+    }
+
+    if(minSize < 1 || maxSize < minSize || labelEvery < 1 || constantEvery < 1) {
+        usage();
+    }
+
+    // `Nvm`运行的是`Ndr::encode`直接生成的字节码，`Nas`汇编`codegen`生成的文本只用于比较两条路径的耗时
+    std::string nas = workDir + "/scale.nas", nlc = workDir + "/scale.nlc", assembledNlc = workDir + "/scale_nas.nlc";
+    const int stageNum = 5;
+    const char* stageName[stageNum] = { "ndr build", "ndr codegen", "nas", "ndr encode", "nvm" };
+
+    // `growth`为本规模与上一规模每条指令耗时之比，明显大于`1`说明该阶段是超线性的
+    printf("%-10s %-12s %12s %12s %8s %12s\n", "instrs", "stage", "ms", "ns/instr", "growth", "peak RSS MB");
+
+    std::string json = "{\n  \"results\": [";
+    std::vector<double> previous(stageNum, 0);
+    bool first = true;
+    for(double size = minSize; size <= maxSize * 1.0001; size *= 10) {
+        Ngen::Option option = base;
+        option.instrs = size;
+        option.labels = size / labelEvery;
+        option.constants = option.strings = size / constantEvery;
+
+        StageResult generated = stage([&] {
+            double begin = now();
+            Ndr ndr;
+            Ngen gen(option);
+            gen.build(ndr);
+            double built = now();
+
+            std::ofstream output(nas);
+            output << ndr.codegen();
+            output.close();
+            double generated = now();
+
+            std::ofstream encoded(nlc, std::ios::binary);
+            std::string file = ndr.encode();
+            encoded.write(file.data(), file.size());
+            encoded.close();
+
+            return std::vector<double>{ built - begin, generated - built, now() - generated, (double)gen.instrNum };
+        });
+
+        size_t instrNum = generated.seconds[3];
+        StageResult assembled = stage([&] {
+            std::string src = readFile(nas);
+            double begin = now();
+            Nas(src, assembledNlc);
+            return std::vector<double>{ now() - begin };
+        });
+
+        StageResult executed = stage([&] {
+            double begin = now();
+            Nvm nvm(nlc);
+            nvm.run();
+            return std::vector<double>{ now() - begin };
+        });
+
+        double seconds[stageNum] = { generated.seconds[0], generated.seconds[1], assembled.seconds[0], generated.seconds[2], executed.seconds[0] };
+        long rss[stageNum] = { generated.peakRSSKB, generated.peakRSSKB, assembled.peakRSSKB, generated.peakRSSKB, executed.peakRSSKB };
+        for(int s = 0; s < stageNum; s ++) {
+            double perInstr = seconds[s] * 1e9 / instrNum;
+            char growth[16] = "-";
+            if(previous[s] > 0) {
+                snprintf(growth, sizeof(growth), "%.2f", perInstr / previous[s]);
+            }
+
+            printf("%-10zu %-12s %12.2f %12.1f %8s %12.1f\n", instrNum, stageName[s], seconds[s] * 1000, perInstr, growth, rss[s] / 1024.0);
+
+            char buffer[256];
+            snprintf(buffer, sizeof(buffer), "%s\n    { \"instructions\": %zu, \"stage\": \"%s\", \"ms\": %.3f, \"ns_per_instr\": %.2f, \"peak_rss_kb\": %ld }",
+                     first ? "" : ",", instrNum, stageName[s], seconds[s] * 1000, perInstr, rss[s]);
+            json += buffer;
+            first = false;
+            previous[s] = perInstr;
+        }
+    }
+
+    json += "\n  ]\n}\n";
+    if(outputFileName != "") {
+        std::ofstream output(outputFileName);
+        if(! output.is_open()) {
+            error(outputFileName + " open error");
+        }
+
+        output << json;
+    }
+
+    unlink(nas.c_str());
+    unlink(nlc.c_str());
+    unlink(assembledNlc.c_str());
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,204 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 13:18:52
+ * @Description: 基准测试运行器：汇编并多次运行各基准程序，统计耗时、每秒指令数及峰值内存并输出JSON
+ */
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+struct RunResult {
+    int status;
+    double wallSeconds;
+    long peakRSSKB;
+    std::string err;    // 子进程的`stderr`输出
+};
+
+static void fail(std::string message) {
+    std::cerr << "nlbench ERROR: " << message << '\n';
+    exit(- 1);
+}
+
+// 运行命令，`stdout`丢弃，`stderr`收集起来，通过`wait4`得到子进程的峰值内存
+static RunResult run(std::vector<std::string> args) {
+    int pipeFD[2];
+    if(pipe(pipeFD) != 0) {
+        fail("pipe error");
+    }
+
+    timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    pid_t pid = fork();
+    if(pid < 0) {
+        fail("fork error");
+    }
+
+    if(pid == 0) {
+        int devNull = open("/dev/null", O_WRONLY);
+        dup2(devNull, STDOUT_FILENO);
+        dup2(pipeFD[1], STDERR_FILENO);
+        close(pipeFD[0]);
+
+        std::vector<char*> argv;
+        for(auto& arg : args) {
+            argv.push_back((char*)arg.c_str());
+        }
+
+        argv.push_back(NULL);
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+
+    close(pipeFD[1]);
+    RunResult result;
+    char buffer[4096];
+    ssize_t length;
+    while((length = read(pipeFD[0], buffer, sizeof(buffer))) > 0) {
+        result.err.append(buffer, length);
+    }
+
+    close(pipeFD[0]);
+
+    struct rusage usage;
+    wait4(pid, &result.status, 0, &usage);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    result.wallSeconds = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+    result.peakRSSKB = usage.ru_maxrss;
+    return result;
+}
+
+static double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+// 中位数绝对偏差，比标准差更不易受偶发的慢运行影响
+static double mad(std::vector<double> values) {
+    double m = median(values);
+    for(auto& value : values) {
+        value = value > m ? value - m : m - value;
+    }
+
+    return median(values);
+}
+
+static std::string baseName(std::string path) {
+    size_t slash = path.find_last_of('/');
+    std::string name = (slash == std::string::npos ? path : path.substr(slash + 1));
+    size_t dot = name.find_last_of('.');
+    return dot == std::string::npos ? name : name.substr(0, dot);
+}
+
+static void usage(void) {
+    std::cerr << "usage: nlbench --nl <nl> [--lib-dir <dir>] [--work-dir <dir>] [--runs <n>] [--output <result.json>] <program.nas>...\n";
+    exit(- 1);
+}
+
+int main(int argc, char** argv) {
+    std::string nl = "", libDir = "", workDir = ".", outputFileName = "";
+    int runs = 5;
+    std::vector<std::string> programs;
+    for(int i = 1; i < argc; i ++) {
+        std::string arg = argv[i];
+        if(arg == "--nl" && i + 1 < argc) {
+            nl = argv[++ i];
+        } else if(arg == "--lib-dir" && i + 1 < argc) {
+            libDir = argv[++ i];
+        } else if(arg == "--work-dir" && i + 1 < argc) {
+            workDir = argv[++ i];
+        } else if(arg == "--runs" && i + 1 < argc) {
+            runs = atoi(argv[++ i]);
+        } else if(arg == "--output" && i + 1 < argc) {
+            outputFileName = argv[++ i];
+        } else if(arg[0] != '-') {
+            programs.push_back(arg);
+        } else {
+            usage();
+        }
+    }
+
+    if(nl == "" || programs.empty() || runs < 1) {
+        usage();
+    }
+
+    // 基准程序中的`IMPORT`只写共享库文件名，由`dlopen`在`LD_LIBRARY_PATH`中查找
+    if(libDir != "") {
+        const char* old = getenv("LD_LIBRARY_PATH");
+        std::string path = libDir + (old ? ":" + std::string(old) : "");
+        setenv("LD_LIBRARY_PATH", path.c_str(), 1);
+    }
+
+    std::sort(programs.begin(), programs.end());
+
+    std::string json = "{\n  \"runs\": " + std::to_string(runs) + ",\n  \"benchmarks\": [";
+    printf("%-10s %12s %10s %10s %10s %14s %12s\n", "name", "instrs", "median ms", "min ms", "mad %", "instrs/s", "peak RSS KB");
+    for(size_t p = 0; p < programs.size(); p ++) {
+        std::string name = baseName(programs[p]);
+        std::string nlc = workDir + "/" + name + ".nlc";
+
+        RunResult assembled = run({ nl, "asm", programs[p], nlc });
+        if(assembled.status != 0) {
+            fail(name + ": assemble failed: " + assembled.err);
+        }
+
+        // 先单独运行一次得到指令条数，同时作为预热
+        RunResult counted = run({ nl, "run", "--instr-count", nlc });
+        size_t position = counted.err.find("Nl instructions: ");
+        if(counted.status != 0 || position == std::string::npos) {
+            fail(name + ": run failed: " + counted.err);
+        }
+
+        double instrs = atof(counted.err.c_str() + position + strlen("Nl instructions: "));
+
+        std::vector<double> walls, rsses;
+        for(int r = 0; r < runs; r ++) {
+            RunResult result = run({ nl, "run", nlc });
+            if(result.status != 0) {
+                fail(name + ": run failed: " + result.err);
+            }
+
+            walls.push_back(result.wallSeconds);
+            rsses.push_back(result.peakRSSKB);
+        }
+
+        double wall = median(walls);
+        double spread = mad(walls) / wall * 100;
+        double minWall = *std::min_element(walls.begin(), walls.end());
+        double maxWall = *std::max_element(walls.begin(), walls.end());
+        double rss = median(rsses);
+        printf("%-10s %12.0f %10.2f %10.2f %10.2f %14.0f %12.0f\n", name.c_str(), instrs, wall * 1000, minWall * 1000, spread, instrs / wall, rss);
+
+        char buffer[512];
+        snprintf(buffer, sizeof(buffer),
+                 "%s\n    { \"name\": \"%s\", \"instructions\": %.0f, \"wall_ms\": { \"median\": %.3f, \"min\": %.3f, \"max\": %.3f, \"mad\": %.3f },"
+                 " \"instrs_per_sec\": %.0f, \"peak_rss_kb\": %.0f }",
+                 p ? "," : "", name.c_str(), instrs, wall * 1000, minWall * 1000, maxWall * 1000, mad(walls) * 1000, instrs / wall, rss);
+        json += buffer;
+    }
+
+    json += "\n  ]\n}\n";
+    if(outputFileName != "") {
+        std::ofstream output(outputFileName);
+        if(! output.is_open()) {
+            fail(outputFileName + " open error");
+        }
+
+        output << json;
+    }
+
+    return 0;
+}
\ No newline at end of file
@@ -5,7 +5,12 @@
  */
 #include "global.hpp"
 
+thread_local std::function<std::string(void)> errorContext = nullptr;
+
 void error(std::string message) {
-    std::cerr << "Nl ERROR: " << message << '\n';
-    exit(- 1);
+    if(errorContext) {
+        message += " " + errorContext();
+    }
+
+    throw NlError(message);
 }
\ No newline at end of file
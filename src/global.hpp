@@ -6,10 +6,20 @@
 #pragma once
 #include <string>
 #include <iostream>
+#include <stdexcept>
+#include <functional>
 
 /*
  * 编写代码规则：
  * 1. 为了代码更加清晰及减少冗余代码，`.cpp`代码文件中所需要的头文件只能在其对应的`.hpp`头文件中引用
  * 2. 为了统一代码风格，使用`sizeof`时后面尽量跟变量
  */
-void error(std::string message);
\ No newline at end of file
+// `error`抛出的异常，`what`为附加了`errorContext`的完整错误信息
+// 命令行程序在`main`中捕获后输出并退出，嵌入接口`Nlib`捕获后转为状态码，使宿主进程不会因脚本出错而退出
+class NlError : public std::runtime_error {
+public:
+    NlError(std::string message) : std::runtime_error(message) {}
+};
+
+void error(std::string message);
+extern thread_local std::function<std::string(void)> errorContext;  // 报错时附加的上下文信息（如虚拟机当前执行位置），由各模块按需设置，每个线程一份
\ No newline at end of file
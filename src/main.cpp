@@ -5,22 +5,168 @@
  */
 #include <iostream>
 #include <fstream>
-#include <sstream>
 #include "nas.hpp"
+#include "nmap.hpp"
 #include "nvm.hpp"
 #include "ndr.hpp"
 #include "nfe.hpp"
+#include "nsrv.hpp"
+
+static void usage(void) {
+    std::cerr << "usage: nl asm [--strip] [--nlc-v1] <input.nas> <output.nlc>\n"
+              << "       nl run [options] <input.nlc>\n"
+              << "run options:\n"
+              << "  --profile <output.folded>   sample with SIGPROF and write folded stacks\n"
+              << "  --profile-hz <hz>           sampling frequency (default 99)\n"
+              << "  --perf-stats[=class]        report hardware counters, optionally per opcode class\n"
+              << "  --mem-stats[=sites]         report memory usage by object kind (also on SIGUSR1)\n"
+              << "  --instr-count               report the number of executed instructions\n"
+              << "  --image-cache <dir>         map a shared program image from <dir>, creating it on first use\n"
+              << "  --task-workers <n>          worker threads for TASK (default: number of CPUs)\n"
+              << "  --arena                     bump-allocate lists, maps and addresses, freed at once on exit\n"
+              << "  --no-escape-analysis        heap-allocate lists and maps that never leave their frame\n"
+              << "  --snapshot-out <file>       run until SNAPSHOT, then save globals and their objects to <file>\n"
+              << "  --snapshot <file>           restore from <file> and continue after SNAPSHOT\n"
+              << "       nl serve [--workers <n>] [--socket <path>] [--image-cache <dir>] [--snapshot <file>] <input.nlc>\n"
+              << "       nl call [--socket <path>] [--repeat <n>] <label> [args...]\n";
+    exit(- 1);
+}
 
 int main(int argc, char** argv) {
-    Nfe nfe("if()=> {}");
-    while(true) {
-        nfe.getToken();
-        if(nfe.token == Nfe::Token::tok_eof) {
-            break;
-        }
+    if(argc < 2) {
+        usage();
+    }
+
+    // 各模块出错时`error`抛出`NlError`，在这里统一输出并退出
+    try {
+        std::string command = argv[1];
+        if(command == "asm") {
+            // `--strip`：不生成调试段，`--nlc-v1`：生成旧的v1格式
+            bool withDebug = true;
+            uint32_t version = NlcFile::version;
+            std::vector<std::string> files;
+            for(int i = 2; i < argc; i ++) {
+                std::string arg = argv[i];
+                if(arg == "--strip") {
+                    withDebug = false;
+                } else if(arg == "--nlc-v1") {
+                    version = 1;
+                } else if(arg[0] != '-') {
+                    files.push_back(arg);
+                } else {
+                    usage();
+                }
+            }
+
+            if(files.size() != 2) {
+                usage();
+            }
+
+            Nmap source(files[0]);
+            Nas nas(source.view(), files[1], withDebug, version);
+        } else if(command == "run") {
+            NvmOption option;
+            std::string inputFileName = "";
+            for(int i = 2; i < argc; i ++) {
+                std::string arg = argv[i];
+                if(arg == "--profile" && i + 1 < argc) {
+                    option.profileFileName = argv[++ i];
+                } else if(arg == "--profile-hz" && i + 1 < argc) {
+                    option.profileHz = atoi(argv[++ i]);
+                } else if(arg == "--perf-stats") {
+                    option.perfStats = true;
+                } else if(arg == "--perf-stats=class") {
+                    option.perfStats = option.perfByClass = true;
+                } else if(arg == "--mem-stats") {
+                    option.memStats = true;
+                } else if(arg == "--mem-stats=sites") {
+                    option.memStats = option.memSites = true;
+                } else if(arg == "--instr-count") {
+                    option.instrCount = true;
+                } else if(arg == "--image-cache" && i + 1 < argc) {
+                    option.imageCache = argv[++ i];
+                } else if(arg == "--task-workers" && i + 1 < argc) {
+                    option.taskWorkers = atoi(argv[++ i]);
+                } else if(arg == "--arena") {
+                    option.arena = true;
+                } else if(arg == "--no-escape-analysis") {
+                    option.escapeAnalysis = false;
+                } else if(arg == "--snapshot-out" && i + 1 < argc) {
+                    option.snapshotOut = argv[++ i];
+                } else if(arg == "--snapshot" && i + 1 < argc) {
+                    option.snapshot = argv[++ i];
+                } else if(inputFileName == "" && arg[0] != '-') {
+                    inputFileName = arg;
+                } else {
+                    usage();
+                }
+            }
+
+            if(inputFileName == "") {
+                usage();
+            }
 
-        std::cout << nfe.tokVal << ' ';
+            Nvm nvm(inputFileName, option);
+            nvm.run();
+        } else if(command == "serve") {
+            NsrvOption option;
+            std::string inputFileName = "";
+            for(int i = 2; i < argc; i ++) {
+                std::string arg = argv[i];
+                if(arg == "--workers" && i + 1 < argc) {
+                    option.workers = atoi(argv[++ i]);
+                } else if(arg == "--socket" && i + 1 < argc) {
+                    option.socketPath = argv[++ i];
+                } else if(arg == "--image-cache" && i + 1 < argc) {
+                    option.vm.imageCache = argv[++ i];
+                } else if(arg == "--snapshot" && i + 1 < argc) {
+                    option.vm.snapshot = argv[++ i];
+                } else if(inputFileName == "" && arg[0] != '-') {
+                    inputFileName = arg;
+                } else {
+                    usage();
+                }
+            }
+
+            if(inputFileName == "") {
+                usage();
+            }
+
+            Nsrv server(inputFileName, option);
+        } else if(command == "call") {
+            // 标签之后的参数原样拼成请求，所以可以是负数
+            std::string socketPath = NsrvOption().socketPath, request = "";
+            size_t repeat = 1;
+            int i = 2;
+            for(; i < argc && request == ""; i ++) {
+                std::string arg = argv[i];
+                if(arg == "--socket" && i + 1 < argc) {
+                    socketPath = argv[++ i];
+                } else if(arg == "--repeat" && i + 1 < argc) {
+                    repeat = strtoull(argv[++ i], NULL, 10);
+                } else if(arg[0] != '-') {
+                    request = arg;
+                } else {
+                    usage();
+                }
+            }
+
+            for(; i < argc; i ++) {
+                request += " " + std::string(argv[i]);
+            }
+
+            if(request == "" || repeat < 1) {
+                usage();
+            }
+
+            return Nsrv::call(socketPath, request, repeat);
+        } else {
+            usage();
+        }
+    } catch(NlError& e) {
+        std::cerr << "Nl ERROR: " << e.what() << '\n';
+        exit(- 1);
     }
-    
+
     return 0;
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
  */
 #pragma once
 
+// 指令在组中的序号即其在nlc文件中的操作码，新指令只能添加在末尾，否则已有的nlc文件将无法运行
 #define MNEM_GROUP \
     DEF_X(LOAD_LOCAL)   \
     DEF_X(LOAD_GLOBAL)  \
@@ -38,10 +39,24 @@
     DEF_X(POP_TOP)  \
     DEF_X(IMPORT)   \
     DEF_X(EXIT) \
-    DEF_X(NOP)
+    DEF_X(NOP)  \
+    \
+    DEF_X(SPAWN)    \
+    DEF_X(JOIN) \
+    DEF_X(TASK) \
+    DEF_X(AWAIT)    \
+    DEF_X(YIELD)    \
+    DEF_X(MAKE_CHANNEL) \
+    DEF_X(SEND) \
+    DEF_X(RECV) \
+    DEF_X(TRY_RECV) \
+    DEF_X(CLOSE)    \
+    DEF_X(PROMOTE)  \
+    DEF_X(SNAPSHOT)
 
 #define DEF_X(x) x,
 enum Mnem {
     MNEM_GROUP
+    MNEM_NUM,   // 指令数量
 };
 #undef DEF_X
\ No newline at end of file
@@ -5,102 +5,142 @@
  */
 #include "nas.hpp"
 
-Nas::Nas(std::string input, std::string outputFileName) {
-    src = input;
-    output.open(outputFileName, std::ios::binary | std::ios::out);
+#define DEF_X(x) { #x, x },
+const std::unordered_map<std::string_view, Mnem> Nas::stringToMnem = {
+    MNEM_GROUP
+};
+#undef DEF_X
+
+// 只判断汇编源码中会用到的ASCII字符类别，避免`isspace`等函数每次都要查询`locale`
+static inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline bool isAlpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static inline bool isSpace(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+Nas::Nas(std::string_view input, std::string outputFileName, bool withDebug, uint32_t version) : src(input), enc(withDebug, version) {
+    std::ofstream output(outputFileName, std::ios::binary | std::ios::out);
     if(! output.is_open()) {
         error(outputFileName + " open error");
     }
-    
+
+    enc.reserve(src.length());  // 代码段大小与源码大小大致相当
     parser();
-    pack();
+
+    // 整个文件在内存中生成后一次写入
+    std::string file = enc.finish();
+    output.write(file.data(), file.size());
     output.close();
 }
 
 void Nas::getToken() {
-    tokVal = "";
+    tokVal = std::string_view();
     token = - 1;
+    size_t length = src.length();
     while(true) {
-        if(src[index] == '#') {
-            while(src[index] != '\n') {
-                index ++;
-            }
-
-            index ++;
+        if(index >= length) {
+            token = tok_eof;
+            return;
+        }
 
-            if(src[index] == '#') {
-                continue;
-            }
+        char c = src[index];
+        if(c == '#') {
+            const char* end = (const char*)memchr(src.data() + index, '\n', length - index);
+            index = (end ? end - src.data() + 1 : length);
+            continue;
         }
 
-        // 解析注释后可能会到文件末尾，若此时不及时返回`tok_eof`那么后续对`src[index]`的判断将导致访问非法内存，所以判断结束的代码必须在解析注释代码之后
-        if(index >= src.length()) {
-            token = tok_eof;
-            return;
+        if(isSpace(c)) {
+            index ++;
+            continue;
         }
 
-        if(isdigit(src[index]) || src[index] == '-') {
+        size_t begin = index;
+        if(isDigit(c) || c == '-') {
             token = tok_num;
-            if(src[index] == '-') {
-                tokVal += '-';
+            if(c == '-') {
                 index ++;
-                if(index >= src.length() || (! isdigit(src[index]))) {
+                if(index >= length || ! isDigit(src[index])) {
                     error("Number format error");
                 }
             }
 
             int dotNum = 0;
-            while(isdigit(src[index]) || src[index] == '.') {
+            while(index < length && (isDigit(src[index]) || src[index] == '.')) {
                 if(src[index] == '.') {
                     dotNum ++;
                 }
 
-                tokVal += src[index];
                 index ++;
             }
 
             // nl汇编只支持十进制浮点数
-            if(dotNum > 1 || (dotNum == 0 && tokVal[0] == 0)) {
-                error("Number format error " + tokVal);
+            tokVal = src.substr(begin, index - begin);
+            if(dotNum > 1) {
+                error("Number format error " + std::string(tokVal));
             }
 
             return;
         }
 
-        if(isalpha(src[index]) || src[index] == '$') {
-            while(isalpha(src[index])
-               || isdigit(src[index]) 
+        if(isAlpha(c) || c == '$') {
+            while(index < length
+               && (isAlpha(src[index])
+               || isDigit(src[index])
                || src[index] == '$'
-               || src[index] == '_') {
-                tokVal += src[index];
+               || src[index] == '_')) {
                 index ++;
             }
 
+            tokVal = src.substr(begin, index - begin);
+
             // 标签定义优先级大于标签使用
-            if(src[index] == ':') {
+            if(index < length && src[index] == ':') {
                 token = tok_label_def;
                 index ++;
             } else if(tokVal[0] == '$') {
                 token = tok_label_name;
-                tokVal = tokVal.substr(1, tokVal.length() - 1);
+                tokVal.remove_prefix(1);
             } else {
                 token = tok_ident;
             }
-            
+
             return;
         }
 
-        if(src[index] == '"') {
+        if(c == '"') {
             token = tok_str;
-            index ++;
+            begin = ++ index;
+            while(index < length && src[index] != '"' && src[index] != '\\') {
+                index ++;
+            }
+
+            if(index < length && src[index] == '\\') {
+                // 有转义字符时才拷贝，反斜杠后的字符按原样处理
+                escaped.assign(src.data() + begin, index - begin);
+                while(index < length && src[index] != '"') {
+                    if(src[index] == '\\') {
+                        index ++;
+                    }
 
-            while(src[index] != '"') {
-                if(src[index] == '\\') {
-                    index ++;
+                    if(index < length) {
+                        escaped += src[index ++];
+                    }
                 }
-                
-                tokVal += src[index];
-                index ++;
+
+                tokVal = escaped;
+            } else {
+                tokVal = src.substr(begin, index - begin);
+            }
+
+            if(index >= length) {
+                error("Unterminated string");
             }
 
             index ++;
@@ -108,31 +148,91 @@ void Nas::getToken() {
         }
 
         // 既不是空白字符或注释，也不是需要处理的字符，那么只可能为非法字符
-        if(isspace(src[index])) {
-            index ++;
-        } else {
-            error("Illegal character");
+        error("Illegal character");
+    }
+}
+
+size_t Nas::currentLine(void) {
+    if(lineIndex < index) {
+        line += std::count(src.begin() + lineIndex, src.begin() + index, '\n');
+        lineIndex = index;
+    }
+
+    return line;
+}
+
+Mnem Nas::toMnem(std::string_view name) {
+    char buffer[32];
+    if(name.length() < sizeof(buffer)) {
+        for(size_t i = 0; i < name.length(); i ++) {
+            buffer[i] = (name[i] >= 'a' && name[i] <= 'z' ? name[i] - 'a' + 'A' : name[i]);
+        }
+
+        auto mnem = stringToMnem.find(std::string_view(buffer, name.length()));
+        if(mnem != stringToMnem.end()) {
+            return mnem -> second;
         }
     }
+
+    error(std::string(name) + " mnemonic does not exist");
+    return NOP;
+}
+
+/*
+ * 数字的有效数字不超过19位、小数不超过27位时，整数部分与小数部分合成的`uint64_t`及`10`的幂在`long double`中都能精确表示，
+ * 一次除法只舍入一次，结果与`strtold`相同；其余情况交给`std::from_chars`
+ */
+NlcFile::Num Nas::toNum(std::string_view text) {
+    static const NlcFile::Num powerOf10[] = {
+        1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L, 1e6L, 1e7L, 1e8L, 1e9L, 1e10L, 1e11L, 1e12L, 1e13L,
+        1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L, 1e20L, 1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L,
+    };
+
+    size_t i = (text[0] == '-' ? 1 : 0);
+    uint64_t mantissa = 0;
+    int digits = 0, fractionDigits = - 1;
+    for(; i < text.length(); i ++) {
+        if(text[i] == '.') {
+            fractionDigits = 0;
+            continue;
+        }
+
+        if(mantissa || text[i] != '0') {
+            digits ++;
+        }
+
+        mantissa = mantissa * 10 + (text[i] - '0');
+        if(fractionDigits >= 0) {
+            fractionDigits ++;
+        }
+    }
+
+    if(digits <= 19 && fractionDigits <= 27) {
+        NlcFile::Num num = mantissa;
+        if(fractionDigits > 0) {
+            num /= powerOf10[fractionDigits];
+        }
+
+        return text[0] == '-' ? - num : num;
+    }
+
+    NlcFile::Num num;
+    auto result = std::from_chars(text.data(), text.data() + text.length(), num);
+    if(result.ec != std::errc() || result.ptr != text.data() + text.length()) {
+        error("Number format error " + std::string(text));
+    }
+
+    return num;
 }
 
 void Nas::parser(void) {
     getToken();
     while(token != tok_eof) {
         if(token == tok_label_def) {
-            labels[tokVal] = offset;
+            enc.label(tokVal);
             getToken();
         } else if(token == tok_ident) {
-            Instr instr;
-            // 通过将助记符全部转为大写以实现助记符大小写无关的功能
-            std::transform(tokVal.begin(), tokVal.end(), tokVal.begin(), ::toupper);
-            if(stringToMnem.count(tokVal)) {
-                instr.mnem = stringToMnem[tokVal];
-            } else {
-                error(tokVal + " mnemonic does not exist");
-            }
-
-            offset += 1;
+            enc.instr(toMnem(tokVal), currentLine());
 
             getToken();
             while(token != tok_ident
@@ -140,109 +240,25 @@ void Nas::parser(void) {
                && token != tok_eof) {
                 switch(token) {
                     case tok_num: {
-                        NlcFile::Num num = std::stold(tokVal);
-
-                        Value value;
-                        value.type = NUM;
-                        if(! numTable.count(num)) {
-                            numTable.insert({ num, numTable.size() });  // 因为使用x[y]=z形式会出现差错，所以只能使用`insert`函数插入
-                        }
-                        value.id = numTable[num];
-
-                        instr.values.push_back(value);
+                        enc.operandNum(toNum(tokVal));
                         break;
                     }
 
                     case tok_str: {
-                        Value value;
-                        value.type = STRING;
-                        if(! stringTable.count(tokVal)) {
-                            stringTable.insert({ tokVal, stringTable.size() });
-                        }
-                        value.id = stringTable[tokVal];
-
-                        instr.values.push_back(value);
+                        enc.operandString(tokVal);
                         break;
                     }
 
                     case tok_label_name: {
-                        Value value;
-                        value.type = LABEL_NAME;
-                        labelNameTable.push_back(tokVal);
-                        value.id = labelNameTable.size() - 1;
-
-                        instr.values.push_back(value);
+                        enc.operandLabel(tokVal);
                         break;
                     }
                 }
 
-                offset += sizeof(size_t);
                 getToken();
             }
-
-            instrs.push_back(instr);
         } else {
             error("Each line of nl assembly can only start with a label or mnemonic");
         }
     }
-}
-
-void Nas::pack(void) {
-    /* 1. file header */
-    NlcFile::FileHeader fileHeader = {
-        .numNum = numTable.size(),
-        .strNum = stringTable.size(),
-    };
-    output.write((char*)&fileHeader, sizeof(fileHeader));
-
-    /* 2. numbers */
-    // 为了解决使用`forEach`直接将`map`写入文件发生的乱序问题，先将`map`转为`vector`再进行从小到大的排序，最后按照已经排好从小到大的顺序正确的写入文件
-    std::vector<std::pair<NlcFile::Num, size_t>> nums(numTable.begin(), numTable.end());
-    std::sort(nums.begin(), nums.end(), 
-        [](const std::pair<NlcFile::Num, size_t>& x, const std::pair<NlcFile::Num, size_t>& y) {
-            return x.second < y.second; // 从小到大排序
-        });
-
-    for(size_t i = 0; i < nums.size(); i ++) {
-        output.write((char*)&nums[i].first, sizeof(NlcFile::Num));
-    }
-
-    /* 3. strings */
-    // 同写`number`到文件的缘由一致
-    std::vector<std::pair<std::string, size_t>> strings(stringTable.begin(), stringTable.end());
-    std::sort(strings.begin(), strings.end(),
-        [](const std::pair<std::string, size_t>& x, const std::pair<std::string, size_t>& y) {
-            return x.second < y.second;
-        });
-    for(size_t i = 0; i < strings.size(); i ++) {
-        // stringLength
-        int stringLength = strings[i].first.length();
-        output.write((char*)&stringLength, sizeof(stringLength));
-
-        // char*
-        output.write((char*)strings[i].first.c_str(), stringLength);
-    }
-
-    /* 4. code */
-    size_t offset = output.tellp(); // 得到文件头和一些数字和字符串常量造成的偏移
-    for(auto instr : instrs) {
-        // mnem
-        char mnem = (char)instr.mnem;
-        output.write(&mnem, sizeof(mnem));
-
-        // values
-        for(auto value : instr.values) {
-            if(value.type == LABEL_NAME) {
-                std::string labelName = labelNameTable[value.id];
-                if(labels.count(labelName)) {
-                    labels[labelName] += offset;   // 添加文件头和一些数字和字符串常量造成的偏移得到真实偏移
-                    output.write((char*)&labels[labelName], sizeof(size_t));
-                } else {
-                    error("Reference non-existent label " + labelName);
-                }
-            } else {
-                output.write((char*)&value.id, sizeof(value.id));
-            }
-        }
-    }
 }
\ No newline at end of file
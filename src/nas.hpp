@@ -4,25 +4,35 @@
  * @Description: nl汇编器头文件
  */
 #pragma once
-#include <map>
 #include <string>
 #include <vector>
 #include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <charconv>
 #include <iostream>
 #include <algorithm>
+#include <string_view>
+#include <unordered_map>
 
 #include "global.hpp"
+#include "nenc.hpp"
 #include "nlc_def.hpp"
 #include "mnem_def.hpp"
 
+/*
+ * `Nas`用法：
+ * `input`通常为`Nmap`映射的源码文件，`Token`都是指向`input`的`std::string_view`，只有含转义字符的字符串才会拷贝
+ * 解析的同时通过`Nenc`直接编码到内存中的代码缓冲区，最后一次写入输出文件，所以`input`在构造期间必须有效
+ */
 class Nas {
 public:
-    Nas(std::string input, std::string outputFileName);
+    // `withDebug`为`false`时不生成调试段，`version`为生成的nlc格式版本
+    Nas(std::string_view input, std::string outputFileName, bool withDebug = true, uint32_t version = NlcFile::version);
 
 private:
-    std::string src;
-    size_t index;
-    std::ofstream output;
+    std::string_view src;
+    size_t index = 0;
 
     /************ Tokenizer部分 ************/
     enum Token {
@@ -35,40 +45,22 @@ private:
     };
 
     int token = - 1;
-    std::string tokVal;
+    std::string_view tokVal;
+    std::string escaped;    // 含转义字符的字符串去除转义后存放于此，`tokVal`指向它
     void getToken(void);
 
+    // 行号只在需要时从上次计算到的位置继续向后数换行符得到，不影响`getToken`本身
+    size_t line = 1;
+    size_t lineIndex = 0;
+    size_t currentLine(void);
+
     /************ Parser部分 ************/
-    #define DEF_X(x) { #x, x },
-    std::map<std::string, Mnem> stringToMnem = {
-        MNEM_GROUP
-    };
-    #undef DEF_X
+    static const std::unordered_map<std::string_view, Mnem> stringToMnem;
+    Mnem toMnem(std::string_view name);     // 助记符大小写无关
+    NlcFile::Num toNum(std::string_view text);
 
     // 定义：指令为包括助记符和参数在内的一个整体，助记符是指令组成部分中所不可或缺者
-    std::map<NlcFile::Num, size_t> numTable;
-    std::map<std::string, size_t> stringTable;
-    std::vector<std::string> labelNameTable;    // `labelNameTable`中的元素可以重复，只是为了结构统一而使用，所以没有必要使用`map`
-    std::map<std::string, size_t> labels;
-
-    enum InstrArg {
-        NUM, STRING, LABEL_NAME,
-    };
-
-    struct Value {
-        InstrArg type;
-        size_t id;
-    };
-
-    struct Instr {
-        Mnem mnem;
-        std::vector<Value> values;
-    };
-
-    std::vector<Instr> instrs;
-    size_t offset;  // 操作码一字节，指令值`sizeof(size_t)`字节，不断计算偏移量用于得出标签所对应的值
+    // 解析的同时直接通过`enc`编码，不再保存中间的指令表
+    Nenc enc;
     void parser(void);
-
-    /************ Pack部分（包装生成最后的字节码文件） ************/
-    void pack(void);
 };
\ No newline at end of file
@@ -0,0 +1,301 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 20:49:03
+ * @Description: 通道，有界时为Vyukov环形缓冲区，无界时为段链表，收发都不加锁
+ */
+#include "nchan.hpp"
+
+Nchan::Nchan(size_t _capacity) : capacity(_capacity) {
+    if(capacity) {
+        cells.reset(new Cell[capacity]);
+        for(size_t i = 0; i < capacity; i ++) {
+            cells[i].sequence.store(2 * i, std::memory_order_relaxed);
+        }
+    } else {
+        Segment* segment = new Segment();
+        head.store(segment);
+        tail.store(segment);
+    }
+}
+
+Nchan::~Nchan() {
+    for(Segment* segment = head.load(); segment; ) {
+        Segment* next = segment -> next.load();
+        delete segment;
+        segment = next;
+    }
+
+    for(Segment* segment = retired.load(); segment; ) {
+        Segment* next = segment -> retiredNext;
+        delete segment;
+        segment = next;
+    }
+}
+
+size_t Nchan::bytes(void) {
+    return sizeof(*this) + (capacity ? capacity * sizeof(Cell) : sizeof(Segment));
+}
+
+Nchan::Result Nchan::boundedSend(NlObject value) {
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    while(true) {
+        Cell& cell = cells[pos % capacity];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)(2 * pos);
+        if(diff == 0) {
+            if(enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                cell.value = value;
+                cell.sequence.store(2 * pos + 1, std::memory_order_release);
+                return chan_ok;
+            }
+        } else if(diff < 0) {
+            return chan_again;  // 该格子上一轮的值还没有被读走
+        } else {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+Nchan::Result Nchan::boundedRecv(NlObject& value) {
+    size_t pos = dequeuePos.load(std::memory_order_relaxed);
+    while(true) {
+        Cell& cell = cells[pos % capacity];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)(2 * pos + 1);
+        if(diff == 0) {
+            if(dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                value = cell.value;
+                cell.sequence.store(2 * (pos + capacity), std::memory_order_release);
+                return chan_ok;
+            }
+        } else if(diff < 0) {
+            return chan_again;
+        } else {
+            pos = dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+Nchan::Result Nchan::unboundedSend(NlObject value) {
+    active.fetch_add(1);
+    while(true) {
+        Segment* segment = tail.load();
+        size_t i = segment -> enqueued.fetch_add(1);
+        if(i < segmentSize) {
+            segment -> slots[i].value = value;
+            segment -> slots[i].state.store(1, std::memory_order_release);
+            leave();
+            return chan_ok;
+        }
+
+        // 该段已写满，追加新段（只有一个生产者能追加成功）
+        Segment* next = segment -> next.load();
+        if(! next) {
+            Segment* fresh = new Segment();
+            if(segment -> next.compare_exchange_strong(next, fresh)) {
+                next = fresh;
+            } else {
+                delete fresh;
+            }
+        }
+
+        tail.compare_exchange_strong(segment, next);
+    }
+}
+
+Nchan::Result Nchan::unboundedRecv(NlObject& value) {
+    active.fetch_add(1);
+    while(true) {
+        Segment* segment = head.load();
+        size_t i = segment -> dequeued.load();
+        if(i >= segmentSize) {
+            // 该段已读完，后面还没有新段时通道为空
+            Segment* next = segment -> next.load();
+            if(! next) {
+                leave();
+                return chan_again;
+            }
+
+            // `tail`可能仍指向该段，摘下前先移走，之后新进入的线程就不会再访问该段
+            if(head.compare_exchange_strong(segment, next)) {
+                Segment* expected = segment;
+                tail.compare_exchange_strong(expected, next);
+                retire(segment);
+            }
+
+            continue;
+        }
+
+        if(i >= std::min(segment -> enqueued.load(), (size_t)segmentSize)) {
+            leave();
+            return chan_again;
+        }
+
+        if(! segment -> dequeued.compare_exchange_weak(i, i + 1)) {
+            continue;
+        }
+
+        // 生产者已领取该位置，可能还没有写完
+        Slot& slot = segment -> slots[i];
+        while(slot.state.load(std::memory_order_acquire) != 1) {
+            std::this_thread::yield();
+        }
+
+        value = slot.value;
+        leave();
+        return chan_ok;
+    }
+}
+
+void Nchan::retire(Segment* segment) {
+    segment -> retiredNext = retired.load();
+    while(! retired.compare_exchange_weak(segment -> retiredNext, segment)) {}
+}
+
+// 先取走待释放的段再退出，退出时没有其他线程在操作通道，说明摘下这些段之前进入的线程都已离开，可以释放；否则放回去
+void Nchan::leave(void) {
+    Segment* list = retired.load() ? retired.exchange(nullptr) : nullptr;
+    if(active.fetch_sub(1) == 1) {
+        while(list) {
+            Segment* next = list -> retiredNext;
+            delete list;
+            list = next;
+        }
+    } else if(list) {
+        Segment* last = list;
+        while(last -> retiredNext) {
+            last = last -> retiredNext;
+        }
+
+        last -> retiredNext = retired.load();
+        while(! retired.compare_exchange_weak(last -> retiredNext, list)) {}
+    }
+}
+
+// 唤醒等待的线程，并重新提交登记的任务
+void Nchan::notify(void) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(! waiting.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    std::vector<Parked> woken;
+    {
+        std::lock_guard<std::mutex> lock(waitMutex);
+        woken.swap(parked);
+        waiting.fetch_sub(woken.size());
+        changed.notify_all();
+    }
+
+    for(Parked& entry : woken) {
+        entry.sched -> submit(entry.task);
+    }
+}
+
+Nchan::Result Nchan::put(NlObject value) {
+    if(closed.load()) {
+        return chan_closed;
+    }
+
+    return capacity ? boundedSend(value) : unboundedSend(value);
+}
+
+// 关闭后仍要读完已发送的值，看到关闭后必须再读一次，否则可能漏掉关闭前刚写入的值
+Nchan::Result Nchan::take(NlObject& value) {
+    Result result = capacity ? boundedRecv(value) : unboundedRecv(value);
+    if(result == chan_again && closed.load()) {
+        result = capacity ? boundedRecv(value) : unboundedRecv(value);
+        if(result == chan_again) {
+            return chan_closed;
+        }
+    }
+
+    return result;
+}
+
+Nchan::Result Nchan::trySend(NlObject value) {
+    Result result = put(value);
+    if(result == chan_ok) {
+        notify();
+    }
+
+    return result;
+}
+
+Nchan::Result Nchan::tryRecv(NlObject& value) {
+    Result result = take(value);
+    if(result == chan_ok) {
+        notify();
+    }
+
+    return result;
+}
+
+template<class Try> Nchan::Result Nchan::block(Try attempt) {
+    Result result = attempt();
+    for(size_t i = 0; result == chan_again && i < spinRounds; i ++) {
+        std::this_thread::yield();
+        result = attempt();
+    }
+
+    if(result == chan_again) {
+        waiting.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::unique_lock<std::mutex> lock(waitMutex);
+        while((result = attempt()) == chan_again) {
+            changed.wait(lock);
+        }
+
+        lock.unlock();
+        waiting.fetch_sub(1);
+    }
+
+    if(result == chan_ok) {
+        notify();
+    }
+
+    return result;
+}
+
+template<class Try> Nchan::Result Nchan::park(Try attempt, Ntask* task, Nsched* sched) {
+    Result result = attempt();
+    if(result == chan_again) {
+        waiting.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::lock_guard<std::mutex> lock(waitMutex);
+        result = attempt();
+        if(result == chan_again) {
+            parked.push_back({task, sched});
+            return result;
+        }
+
+        waiting.fetch_sub(1);
+    }
+
+    if(result == chan_ok) {
+        notify();
+    }
+
+    return result;
+}
+
+Nchan::Result Nchan::send(NlObject value) {
+    return block([this, value]() { return put(value); });
+}
+
+Nchan::Result Nchan::recv(NlObject& value) {
+    return block([this, &value]() { return take(value); });
+}
+
+Nchan::Result Nchan::parkSend(NlObject value, Ntask* task, Nsched* sched) {
+    return park([this, value]() { return put(value); }, task, sched);
+}
+
+Nchan::Result Nchan::parkRecv(NlObject& value, Ntask* task, Nsched* sched) {
+    return park([this, &value]() { return take(value); }, task, sched);
+}
+
+void Nchan::close(void) {
+    closed.store(true);
+    notify();
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 20:48:26
+ * @Description: 通道头文件
+ */
+#pragma once
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <condition_variable>
+
+#include "nl.hpp"
+#include "nsched.hpp"
+#include "global.hpp"
+
+/*
+ * `Nchan`用法（`MAKE_CHANNEL`创建，`SEND`/`RECV`/`TRY_RECV`/`CLOSE`操作）：
+ * 多生产者多消费者的通道，值（`NlObject`）按发送顺序传递，`list`、`map`只传递指针，发送后归接收方所有，发送方不应再访问
+ * 有界通道为Vyukov环形缓冲区，每个格子带序号，生产者和消费者各自通过`CAS`领取位置，不需要加锁
+ * 无界通道为格子数固定的段组成的链表，写满一段时追加新段，读完的段在没有线程正在操作通道时释放
+ * `trySend`/`tryRecv`从不阻塞，`send`/`recv`在满或空时先让出若干次，再在条件变量上等待（只有这时才用到锁）
+ * 任务中用`parkSend`/`parkRecv`：满或空时任务登记到通道上，不占用工作线程，之后的收发或`close`通过`Nsched::submit`重新提交它
+ * 等待方先增加`waiting`再在锁中重试，收发成功后读`waiting`，两边之间都有`seq_cst`屏障，所以要么重试看到这次收发，要么收发方看到登记并唤醒
+ */
+class Nchan {
+public:
+    enum Result {
+        chan_ok = 0,
+        chan_again,     // 通道满（发送）或空（接收），稍后再试
+        chan_closed,    // 已关闭（发送），或已关闭且已读完（接收）
+    };
+
+    Nchan(size_t _capacity);    // `_capacity`为`0`时无界
+    ~Nchan();
+
+    Result trySend(NlObject value);
+    Result tryRecv(NlObject& value);
+    Result send(NlObject value);
+    Result recv(NlObject& value);
+    // 返回`chan_again`时`task`已登记在通道上，调用方必须立即挂起任务且不再访问它（它可能已被重新提交）
+    Result parkSend(NlObject value, Ntask* task, Nsched* sched);
+    Result parkRecv(NlObject& value, Ntask* task, Nsched* sched);
+    void close(void);
+
+    size_t bytes(void);     // 创建时分配的字节数，用于统计
+
+private:
+    static const size_t segmentSize = 256;
+    static const size_t spinRounds = 64;
+
+    // 有界：Vyukov环形缓冲区，`sequence`等于位置的两倍时可写，再加一时可读（取两倍使容量为`1`时下一轮可写与本轮可读的序号不同）
+    struct Cell {
+        std::atomic<size_t> sequence;
+        NlObject value;
+    };
+
+    size_t capacity;
+    std::unique_ptr<Cell[]> cells;
+    alignas(64) std::atomic<size_t> enqueuePos{0};
+    alignas(64) std::atomic<size_t> dequeuePos{0};
+
+    // 无界：每段的格子只用一次，`state`为`1`时已写入
+    struct Slot {
+        std::atomic<int> state{0};
+        NlObject value;
+    };
+
+    struct Segment {
+        std::atomic<size_t> enqueued{0};    // 已领取的写入位置
+        std::atomic<size_t> dequeued{0};    // 已领取的读取位置
+        std::atomic<Segment*> next{nullptr};
+        Segment* retiredNext = nullptr;
+        Slot slots[segmentSize];
+    };
+
+    alignas(64) std::atomic<Segment*> head{nullptr};
+    alignas(64) std::atomic<Segment*> tail{nullptr};
+    std::atomic<Segment*> retired{nullptr};     // 已从链表中摘下、等待释放的段
+    std::atomic<size_t> active{0};  // 正在操作无界通道的线程数，为`0`时才能释放`retired`中的段
+
+    std::atomic<bool> closed{false};
+
+    struct Parked {
+        Ntask* task;
+        Nsched* sched;
+    };
+
+    std::mutex waitMutex;   // 保护`parked`
+    std::condition_variable changed;
+    std::vector<Parked> parked;     // 等待通道变化的任务
+    std::atomic<size_t> waiting{0};     // 正在等待的线程数加上`parked`中的任务数
+
+    Result boundedSend(NlObject value);
+    Result boundedRecv(NlObject& value);
+    Result unboundedSend(NlObject value);
+    Result unboundedRecv(NlObject& value);
+    Result put(NlObject value);     // 不通知等待方的`trySend`/`tryRecv`
+    Result take(NlObject& value);
+    void retire(Segment* segment);
+    void leave(void);
+    void notify(void);
+    template<class Try> Result block(Try attempt);
+    template<class Try> Result park(Try attempt, Ntask* task, Nsched* sched);
+};
\ No newline at end of file
@@ -0,0 +1,127 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 10:02:40
+ * @Description: nlc调试段读取器，按需将偏移还原为标签名和源码行号
+ */
+#include "ndbg.hpp"
+
+bool Ndbg::empty(void) {
+    return trailer.labelNum == 0 && trailer.lineNum == 0;
+}
+
+void Ndbg::load(void) {
+    if(loaded) {
+        return;
+    }
+
+    loaded = true;
+    if(empty()) {
+        return;
+    }
+
+    // 调试信息只是辅助，读取失败时当作没有调试段处理，不能因此报错（报错本身就可能需要调试信息）
+    std::ifstream input(fileName, std::ios::binary | std::ios::in);
+    if(! input.is_open()) {
+        return;
+    }
+
+    input.seekg(begin, std::ios::beg);
+    for(size_t i = 0; i < trailer.labelNum; i ++) {
+        size_t offset;
+        input.read((char*)&offset, sizeof(offset));
+
+        int nameLength;
+        input.read((char*)&nameLength, sizeof(nameLength));
+        std::string name(nameLength, '\0');
+        input.read(&name[0], nameLength);
+
+        labelTable.push_back({ offset, name });
+    }
+
+    for(size_t i = 0; i < trailer.lineNum; i ++) {
+        std::pair<size_t, size_t> line;
+        input.read((char*)&line.first, sizeof(line.first));
+        input.read((char*)&line.second, sizeof(line.second));
+        lineTable.push_back(line);
+    }
+
+    if(! input) {
+        labelTable.clear();
+        lineTable.clear();
+        return;
+    }
+
+    std::sort(labelTable.begin(), labelTable.end());
+    std::sort(lineTable.begin(), lineTable.end());
+}
+
+bool Ndbg::find(std::string name, size_t& offset) {
+    load();
+    for(auto& label : labelTable) {
+        if(label.second == name) {
+            offset = label.first;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::string Ndbg::symbolize(size_t offset) {
+    load();
+
+    // 找到最后一个不大于`offset`的标签
+    auto label = std::upper_bound(labelTable.begin(), labelTable.end(), offset,
+        [](size_t offset, const std::pair<size_t, std::string>& label) {
+            return offset < label.first;
+        });
+
+    if(label == labelTable.begin()) {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "0x%zx", offset);
+        return buffer;
+    }
+
+    return (label - 1) -> second;
+}
+
+size_t Ndbg::line(size_t offset) {
+    load();
+
+    auto line = std::upper_bound(lineTable.begin(), lineTable.end(), offset,
+        [](size_t offset, const std::pair<size_t, size_t>& line) {
+            return offset < line.first;
+        });
+
+    if(line == lineTable.begin()) {
+        return 0;
+    }
+
+    return (line - 1) -> second;
+}
+
+std::string Ndbg::describe(size_t offset) {
+    load();
+
+    char buffer[64];
+    auto label = std::upper_bound(labelTable.begin(), labelTable.end(), offset,
+        [](size_t offset, const std::pair<size_t, std::string>& label) {
+            return offset < label.first;
+        });
+
+    std::string description;
+    if(label == labelTable.begin()) {
+        snprintf(buffer, sizeof(buffer), "0x%zx", offset);
+        description = buffer;
+    } else {
+        snprintf(buffer, sizeof(buffer), "+0x%zx", offset - (label - 1) -> first);
+        description = (label - 1) -> second + buffer;
+    }
+
+    size_t lineNo = line(offset);
+    if(lineNo) {
+        description += " (line " + std::to_string(lineNo) + ")";
+    }
+
+    return description;
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 10:02:17
+ * @Description: nlc调试段读取器头文件
+ */
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+
+#include "global.hpp"
+#include "nlc_def.hpp"
+
+/*
+ * `Ndbg`用法：
+ * 构造时只记录调试段的位置，不读取任何内容，只有在报错、采样分析等需要将偏移还原为标签名和源码行号时才打开文件读取调试段
+ * 因此没有调试段或从未出错的程序不会因调试信息付出任何启动时间和内存
+ */
+class Ndbg {
+public:
+    Ndbg(void) {}
+    Ndbg(std::string _fileName, size_t _begin, NlcFile::DebugTrailer _trailer)
+        : fileName(_fileName), begin(_begin), trailer(_trailer) {}
+
+    bool empty(void);
+    std::string symbolize(size_t offset);   // 偏移所在的标签名，没有对应标签时输出十六进制偏移
+    size_t line(size_t offset);     // 偏移所对应的源码行号，没有对应行号时为`0`
+    std::string describe(size_t offset);    // 供报错使用：`label+0xN (line L)`
+    bool find(std::string name, size_t& offset);    // 按名字查找标签，找到时将其偏移写入`offset`
+
+private:
+    std::string fileName;
+    size_t begin = 0;
+    NlcFile::DebugTrailer trailer = { .labelNum = 0, .lineNum = 0, .size = 0 };
+
+    // 均按偏移从小到大排列
+    bool loaded = false;
+    std::vector<std::pair<size_t, std::string>> labelTable;
+    std::vector<std::pair<size_t, size_t>> lineTable;
+    void load(void);
+};
\ No newline at end of file
@@ -14,123 +14,173 @@ std::shared_ptr<Ndr::Block> Ndr::newBlock(std::string blockName) {
 }
 
 void Ndr::newInstrLoadLocal(std::shared_ptr<Block> block, std::string localName) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("LOAD_LOCAL", { std::make_shared<StrVal>(localName) })));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(LOAD_LOCAL, { std::make_shared<StrVal>(localName) })));
 }
 
 void Ndr::newInstrLoadGlobal(std::shared_ptr<Block> block, std::string globalName) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("LOAD_GLOBAL", { std::make_shared<StrVal>(globalName) })));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(LOAD_GLOBAL, { std::make_shared<StrVal>(globalName) })));
 }
 
 void Ndr::newInstrLoadNum(std::shared_ptr<Block> block, NlcFile::Num num) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("LOAD_NUM", { std::make_shared<NumVal>(num) })));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(LOAD_NUM, { std::make_shared<NumVal>(num) })));
 }
 
 void Ndr::newInstrLoadString(std::shared_ptr<Block> block, std::string string) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("LOAD_STRING", { std::make_shared<StrVal>(string) })));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(LOAD_STRING, { std::make_shared<StrVal>(string) })));
 }
 
 void Ndr::newInstrLoadAddr(std::shared_ptr<Block> block, std::string labelName) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("LOAD_ADDR", { std::make_shared<LabelNameVal>(labelName) })));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(LOAD_ADDR, { std::make_shared<LabelNameVal>(labelName) })));
 }
 
 void Ndr::newInstrStoreLocal(std::shared_ptr<Block> block, std::string localName) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("STORE_LOCAL", { std::make_shared<StrVal>(localName) })));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(STORE_LOCAL, { std::make_shared<StrVal>(localName) })));
 }
 
 void Ndr::newInstrStoreGlobal(std::shared_ptr<Block> block, std::string globalName) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("STORE_GLOBAL", { std::make_shared<StrVal>(globalName) })));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(STORE_GLOBAL, { std::make_shared<StrVal>(globalName) })));
 }
 
 
 void Ndr::newInstrAdd(std::shared_ptr<Block> block) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("ADD", {})));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(ADD, {})));
 }
 
 void Ndr::newInstrSub(std::shared_ptr<Block> block) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("SUB", {})));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(SUB, {})));
 }
 
 void Ndr::newInstrMul(std::shared_ptr<Block> block) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("MUL", {})));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(MUL, {})));
 }
 
 void Ndr::newInstrDiv(std::shared_ptr<Block> block) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("DIV", {})));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(DIV, {})));
 }
 
 void Ndr::newInstrMod(std::shared_ptr<Block> block) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("MOD", {})));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(MOD, {})));
 }
 
 void Ndr::newInstrPow(std::shared_ptr<Block> block) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("POW", {})));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(POW, {})));
 }
 
 void Ndr::newInstrNot(std::shared_ptr<Block> block) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("NOT", {})));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(NOT, {})));
 }
 
 void Ndr::newInstrCompare(std::shared_ptr<Block> block, std::string op) {
     newInstrLoadString(block, op);
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("COMPARE", {})));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(COMPARE, {})));
 }
 
 
 void Ndr::newInstrJmp(std::shared_ptr<Block> block, std::string labelName) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("JMP", { std::make_shared<LabelNameVal>(labelName) })));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(JMP, { std::make_shared<LabelNameVal>(labelName) })));
 }
 
 void Ndr::newInstrJmpc(std::shared_ptr<Block> block, std::string labelName) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("JMPC", { std::make_shared<LabelNameVal>(labelName) })));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(JMPC, { std::make_shared<LabelNameVal>(labelName) })));
 }
 
 void Ndr::newInstrCall(std::shared_ptr<Block> block) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("CALL", {})));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(CALL, {})));
 }
 
 void Ndr::newInstrCalle(std::shared_ptr<Block> block) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("CALLE", {})));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(CALLE, {})));
 }
 
 void Ndr::newInstrRet(std::shared_ptr<Block> block) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("RET", {})));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(RET, {})));
 }
 
 
 void Ndr::newInstrMakeList(std::shared_ptr<Block> block) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("MAKE_LIST", {})));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(MAKE_LIST, {})));
 }
 
 // `ACTION`系列所操作的对象的一系列操作在前端直接转译为汇编，所以模式是固定的，即`LOAD_STRING`加`ACTION_LIST`，因此为了方便操作，这里直接将二者合二为一入作为一个伪指令
 void Ndr::newInstrActionList(std::shared_ptr<Block> block, std::string actionName) {
     newInstrLoadString(block, actionName);
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("ACTION_LIST", {})));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(ACTION_LIST, {})));
 }
 
 void Ndr::newInstrMakeMap(std::shared_ptr<Block> block) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("MAKE_MAP", {})));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(MAKE_MAP, {})));
 }
 
 void Ndr::newInstrActionMap(std::shared_ptr<Block> block, std::string actionName) {
     newInstrLoadString(block, actionName);
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("ACTION_MAP", {})));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(ACTION_MAP, {})));
 }
 
 
 void Ndr::newInstrPopTop(std::shared_ptr<Block> block) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("POP_TOP", {})));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(POP_TOP, {})));
 }
 
 void Ndr::newInstrImport(std::shared_ptr<Block> block) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("IMPORT", {})));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(IMPORT, {})));
 }
 
 void Ndr::newInstrExit(std::shared_ptr<Block> block) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("EXIT", {})));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(EXIT, {})));
 }
 
 void Ndr::newInstrNop(std::shared_ptr<Block> block) {
-    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr("NOP", {})));
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(NOP, {})));
+}
+
+
+void Ndr::newInstrSpawn(std::shared_ptr<Block> block) {
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(SPAWN, {})));
+}
+
+void Ndr::newInstrJoin(std::shared_ptr<Block> block) {
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(JOIN, {})));
+}
+
+void Ndr::newInstrTask(std::shared_ptr<Block> block) {
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(TASK, {})));
+}
+
+void Ndr::newInstrAwait(std::shared_ptr<Block> block) {
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(AWAIT, {})));
+}
+
+void Ndr::newInstrYield(std::shared_ptr<Block> block) {
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(YIELD, {})));
+}
+
+
+void Ndr::newInstrMakeChannel(std::shared_ptr<Block> block) {
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(MAKE_CHANNEL, {})));
+}
+
+void Ndr::newInstrSend(std::shared_ptr<Block> block) {
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(SEND, {})));
+}
+
+void Ndr::newInstrRecv(std::shared_ptr<Block> block) {
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(RECV, {})));
+}
+
+void Ndr::newInstrTryRecv(std::shared_ptr<Block> block) {
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(TRY_RECV, {})));
+}
+
+void Ndr::newInstrClose(std::shared_ptr<Block> block) {
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(CLOSE, {})));
+}
+
+void Ndr::newInstrPromote(std::shared_ptr<Block> block) {
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(PROMOTE, {})));
+}
+
+void Ndr::newInstrSnapshot(std::shared_ptr<Block> block) {
+    block -> instrs.push_back(std::shared_ptr<Instr>(new Instr(SNAPSHOT, {})));
 }
 
 
@@ -166,7 +216,13 @@ std::string Ndr::Block::codegen() {
 }
 
 std::string Ndr::Instr::codegen() {
-    std::string code = name + " ";
+    #define DEF_X(x) #x,
+    static const char* mnemName[] = {
+        MNEM_GROUP
+    };
+    #undef DEF_X
+
+    std::string code = std::string(mnemName[mnem]) + " ";
     for(auto arg : args) {
         code += arg -> codegen();
     }
@@ -179,9 +235,57 @@ std::string Ndr::NumVal::codegen() {
 }
 
 std::string Ndr::StrVal::codegen() {
-    return " \"" + string + "\" ";
+    // 汇编器中反斜杠后的字符按原样处理，所以只需转义引号和反斜杠本身
+    std::string escaped = "";
+    for(auto c : string) {
+        if(c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+
+        escaped += c;
+    }
+
+    return " \"" + escaped + "\" ";
 }
 
 std::string Ndr::LabelNameVal::codegen() {
     return  " $" + labelName + " ";
+}
+
+
+/* 直接编码为字节码 */
+// 行号与`codegen`生成的文本的行号一致，这样调试时可以对照文本输出查看
+std::string Ndr::encode(bool withDebug, uint32_t version) {
+    Nenc enc(withDebug, version);
+    size_t line = 1;
+    if(beginBlock) {
+        enc.instr(JMP, line ++);
+        enc.operandLabel(beginBlock -> name);
+    }
+
+    for(auto block : program) {
+        enc.label(block -> name);
+        line ++;
+
+        for(auto instr : block -> instrs) {
+            enc.instr(instr -> mnem, line ++);
+            for(auto arg : instr -> args) {
+                arg -> encode(enc);
+            }
+        }
+    }
+
+    return enc.finish();
+}
+
+void Ndr::NumVal::encode(Nenc& enc) {
+    enc.operandNum(num);
+}
+
+void Ndr::StrVal::encode(Nenc& enc) {
+    enc.operandString(string);
+}
+
+void Ndr::LabelNameVal::encode(Nenc& enc) {
+    enc.operandLabel(labelName);
 }
\ No newline at end of file
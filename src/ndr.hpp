@@ -11,18 +11,22 @@
 #include <memory>
 
 #include "global.hpp"
+#include "nenc.hpp"
 #include "nlc_def.hpp"
+#include "mnem_def.hpp"
 
 /*
  * `Ndr`用法：
  * `Ndr`提供一种汇编的内存表示形式，在内存中，一个汇编程序由多个基本块组成，每个基本块由多条指令组成
- * 用户可以通过`Ndr`提供的一系列函数构建这样的汇编内存表示形式，同时也可以将内存表示形式转换为文本表示形式提供给汇编器进行处理
+ * 用户可以通过`Ndr`提供的一系列函数构建这样的汇编内存表示形式，再通过`encode`直接编码为nlc字节码
+ * `codegen`生成的文本表示形式只用于调试，也可以交给汇编器处理（文本中的数字只保留六位小数，可能与`encode`的结果有差异）
  */
 class Ndr {
 private:
     // 参数值
     struct Value {
         virtual std::string codegen() = 0;
+        virtual void encode(Nenc& enc) = 0;
     };
 
     struct NumVal : public Value {
@@ -30,6 +34,7 @@ private:
         
         NumVal(NlcFile::Num _num) : num(_num) {}
         std::string codegen();
+        void encode(Nenc& enc);
     };
 
     struct StrVal : public Value {
@@ -37,6 +42,7 @@ private:
 
         StrVal(std::string _string) : string(_string) {}
         std::string codegen();
+        void encode(Nenc& enc);
     };
 
     struct LabelNameVal : public Value {
@@ -44,14 +50,15 @@ private:
 
         LabelNameVal(std::string _labelName) : labelName(_labelName) {}
         std::string codegen();
+        void encode(Nenc& enc);
     };
 
     // 指令
     struct Instr {
-        std::string name;
+        Mnem mnem;
         std::vector<std::shared_ptr<Value>> args;
 
-        Instr(std::string _name, std::vector<std::shared_ptr<Value>> _args) : name(_name), args(_args) {}
+        Instr(Mnem _mnem, std::vector<std::shared_ptr<Value>> _args) : mnem(_mnem), args(_args) {}
         std::string codegen();
     };
 
@@ -102,10 +109,28 @@ public:
     void newInstrExit(std::shared_ptr<Block> block);
     void newInstrNop(std::shared_ptr<Block> block);
 
+    void newInstrSpawn(std::shared_ptr<Block> block);
+    void newInstrJoin(std::shared_ptr<Block> block);
+    void newInstrTask(std::shared_ptr<Block> block);
+    void newInstrAwait(std::shared_ptr<Block> block);
+    void newInstrYield(std::shared_ptr<Block> block);
+
+    void newInstrMakeChannel(std::shared_ptr<Block> block);
+    void newInstrSend(std::shared_ptr<Block> block);
+    void newInstrRecv(std::shared_ptr<Block> block);
+    void newInstrTryRecv(std::shared_ptr<Block> block);
+    void newInstrClose(std::shared_ptr<Block> block);
+
+    void newInstrPromote(std::shared_ptr<Block> block);
+    void newInstrSnapshot(std::shared_ptr<Block> block);
+
     /************ 生成nl汇编 ************/
     std::shared_ptr<Block>beginBlock = nullptr;
     void setBeginBlock(std::shared_ptr<Block> block);
 
     std::vector<std::shared_ptr<Block>> program;
     std::string codegen(void);
+
+    /************ 直接生成nlc字节码 ************/
+    std::string encode(bool withDebug = true, uint32_t version = NlcFile::version);  // 返回完整的nlc文件内容
 };
\ No newline at end of file
@@ -0,0 +1,311 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 16:09:40
+ * @Description: nlc字节码编码器，`Nas`与`Ndr`共用，在内存中生成nlc文件
+ */
+#include "nenc.hpp"
+
+static_assert(MNEM_NUM - 1 <= NlcFile::mnemMask, "Mnem must fit in the low bits of the opcode byte");
+
+Nenc::Nenc(bool _withDebug, uint32_t _version) : withDebug(_withDebug), version(_version) {
+    if(version != 1 && version != NlcFile::version) {
+        error("Nenc: unsupported nlc version " + std::to_string(version));
+    }
+}
+
+void Nenc::reserve(size_t codeBytes) {
+    code.reserve(codeBytes);
+    if(withDebug) {
+        lineTable.reserve(codeBytes / 16);
+    }
+}
+
+void Nenc::put(size_t value, int bytes) {
+    code.append((char*)&value, bytes);  // 小端序，取低`bytes`个字节
+}
+
+void Nenc::patch(size_t position, size_t value, int bytes) {
+    memcpy(&code[position], &value, bytes);
+}
+
+// 将`begin`处指令中`position`处的标签操作数回填为`offset`（均为相对代码段的偏移）
+void Nenc::patchLabel(size_t position, size_t begin, size_t offset) {
+    if(version == 1) {
+        patch(position, offset, sizeof(size_t));
+        return;
+    }
+
+    int64_t relative = (int64_t)offset - (int64_t)begin;
+    if(relative < INT32_MIN || relative > INT32_MAX) {
+        error("Nenc: jump distance exceeds 32 bits");
+    }
+
+    patch(position, (uint32_t)(int32_t)relative, 4);
+}
+
+size_t Nenc::find(std::string_view name) {
+    auto label = labelTable.find(name);
+    if(label != labelTable.end()) {
+        return label -> second;
+    }
+
+    labelNames.emplace_back(name);
+    labelTable.insert({ labelNames.back(), labels.size() });
+    labels.emplace_back();
+    return labels.size() - 1;
+}
+
+void Nenc::label(std::string_view name) {
+    flush();
+
+    Label& target = labels[find(name)];
+    if(target.offset != undefined) {
+        error("Label " + std::string(name) + " is defined more than once");
+    }
+
+    target.offset = code.size();
+    for(auto& ref : target.pending) {
+        patchLabel(ref.first, ref.second, target.offset);
+    }
+
+    target.pending.clear();
+    target.pending.shrink_to_fit();
+}
+
+void Nenc::instr(Mnem mnem, size_t line) {
+    flush();
+
+    if(line && (lineTable.empty() || lineTable[lineTable.size() - 1].second != line)) {
+        lineTable.push_back({ code.size(), line });
+    }
+
+    instrBegin = code.size();
+    code += (char)mnem;
+}
+
+void Nenc::operandNum(NlcFile::Num num) {
+    NumKey key = { 0, 0 };
+    memcpy(&key, &num, sizeof(num) < 10 ? sizeof(num) : 10);  // `x86`上`long double`只有前10个字节有效，其余为填充
+    auto id = numTable.find(key);
+    if(id == numTable.end()) {
+        id = numTable.insert({ key, nums.size() }).first;
+        nums.push_back(num);
+    }
+
+    operands.push_back({ false, id -> second });
+}
+
+void Nenc::operandString(std::string_view string) {
+    auto id = stringTable.find(string);
+    if(id == stringTable.end()) {
+        strings.emplace_back(string);
+        id = stringTable.insert({ strings.back(), strings.size() - 1 }).first;
+    }
+
+    operands.push_back({ false, id -> second });
+}
+
+void Nenc::operandLabel(std::string_view name) {
+    operands.push_back({ true, find(name) });
+}
+
+void Nenc::flush(void) {
+    if(operands.empty()) {
+        return;
+    }
+
+    if(instrBegin == undefined) {
+        error("Nenc: operand without an instruction");
+    }
+
+    // v1每个操作数都是`size_t`，v2取能容纳所有操作数的最小宽度
+    int bytes = sizeof(size_t);
+    if(version != 1) {
+        int width = 0;
+        for(auto& operand : operands) {
+            int need = (operand.isLabel || operand.value > UINT16_MAX ? 2 : operand.value > UINT8_MAX ? 1 : 0);
+            width = std::max(width, need);
+        }
+
+        if(width == 2) {
+            for(auto& operand : operands) {
+                if(! operand.isLabel && operand.value > UINT32_MAX) {
+                    error("Nenc: constant id exceeds 32 bits");
+                }
+            }
+        }
+
+        code[instrBegin] = (char)((unsigned char)code[instrBegin] | (width << NlcFile::mnemBits));
+        bytes = 1 << width;
+    }
+
+    for(auto& operand : operands) {
+        if(! operand.isLabel) {
+            put(operand.value, bytes);
+            continue;
+        }
+
+        Label& target = labels[operand.value];
+        size_t position = code.size();
+        put(0, bytes);
+        if(version == 1) {
+            labelRefs.push_back(position);
+        }
+
+        if(target.offset == undefined) {
+            target.pending.push_back({ position, instrBegin });
+        } else {
+            patchLabel(position, instrBegin, target.offset);
+        }
+    }
+
+    operands.clear();
+}
+
+std::string Nenc::finish(void) {
+    flush();
+
+    for(size_t i = 0; i < labels.size(); i ++) {
+        if(labels[i].offset == undefined) {
+            error("Reference non-existent label " + labelNames[i]);
+        }
+    }
+
+    return version == 1 ? finishV1() : finishV2();
+}
+
+// 保留标签表和行号表以便虚拟机将偏移还原为标签名和源码行号，`base`为代码段的文件偏移
+void Nenc::appendDebug(std::string& file, size_t base) {
+    size_t debugBegin = file.size();
+    for(size_t i = 0; i < labels.size(); i ++) {
+        size_t offset = labels[i].offset + base;
+        file.append((char*)&offset, sizeof(offset));
+
+        int nameLength = labelNames[i].length();
+        file.append((char*)&nameLength, sizeof(nameLength));
+        file += labelNames[i];
+    }
+
+    for(auto& line : lineTable) {
+        size_t offset = line.first + base;
+        file.append((char*)&offset, sizeof(offset));
+        file.append((char*)&line.second, sizeof(line.second));
+    }
+
+    NlcFile::DebugTrailer debugTrailer = {
+        .labelNum = labels.size(),
+        .lineNum = lineTable.size(),
+        .size = file.size() - debugBegin,
+    };
+
+    file.append((char*)&debugTrailer, sizeof(debugTrailer));
+}
+
+std::string Nenc::finishV1(void) {
+    /* 1. file header */
+    NlcFile::FileHeader fileHeader = {
+        .numNum = nums.size(),
+        .strNum = strings.size(),
+    };
+
+    std::string file;
+    file.reserve(sizeof(fileHeader) + nums.size() * sizeof(NlcFile::Num) + code.size()
+               + (withDebug ? lineTable.size() * 2 * sizeof(size_t) : 0));
+    file.append((char*)&fileHeader, sizeof(fileHeader));
+
+    /* 2. numbers */
+    file.append((char*)nums.data(), nums.size() * sizeof(NlcFile::Num));
+
+    /* 3. strings */
+    for(auto& string : strings) {
+        int stringLength = string.length();
+        file.append((char*)&stringLength, sizeof(stringLength));
+        file += string;
+    }
+
+    /* 4. code */
+    // 常量池大小至此才确定，给所有标签操作数加上代码段的起始偏移得到真实偏移
+    size_t base = file.size();
+    for(auto position : labelRefs) {
+        size_t value;
+        memcpy(&value, &code[position], sizeof(value));
+        patch(position, value + base, sizeof(size_t));
+    }
+
+    file += code;
+
+    /* 5. debug */
+    if(withDebug) {
+        appendDebug(file, base);
+    }
+
+    return file;
+}
+
+std::string Nenc::finishV2(void) {
+    size_t stringBytes = 0;
+    for(auto& string : strings) {
+        stringBytes += string.length();
+    }
+
+    if(stringBytes > UINT32_MAX || strings.size() >= UINT32_MAX) {
+        error("Nenc: string table exceeds 32 bits");
+    }
+
+    std::vector<NlcFile::Section> sections;
+    NlcFile::FileHeaderV2 fileHeader;
+    fileHeader.sectionNum = withDebug ? 4 : 3;
+
+    std::string file;
+    file.reserve(sizeof(fileHeader) + fileHeader.sectionNum * sizeof(NlcFile::Section) + nums.size() * sizeof(NlcFile::Num)
+               + (strings.size() + 2) * sizeof(uint32_t) + stringBytes + code.size() + 64
+               + (withDebug ? lineTable.size() * 2 * sizeof(size_t) : 0));
+    file.append((char*)&fileHeader, sizeof(fileHeader));
+    file.append(fileHeader.sectionNum * sizeof(NlcFile::Section), '\0');   // 段表最后再回填
+
+    auto begin = [&](uint32_t kind, uint32_t align) {
+        file.append((align - file.size() % align) % align, '\0');
+        sections.push_back({ kind, align, file.size(), 0 });
+    };
+
+    auto end = [&]() {
+        sections[sections.size() - 1].size = file.size() - sections[sections.size() - 1].offset;
+    };
+
+    /* numbers */
+    begin(NlcFile::sec_nums, alignof(NlcFile::Num));
+    file.append((char*)nums.data(), nums.size() * sizeof(NlcFile::Num));
+    end();
+
+    /* strings */
+    begin(NlcFile::sec_strings, sizeof(uint32_t));
+    uint32_t count = strings.size(), offset = 0;
+    file.append((char*)&count, sizeof(count));
+    for(auto& string : strings) {
+        file.append((char*)&offset, sizeof(offset));
+        offset += string.length();
+    }
+
+    file.append((char*)&offset, sizeof(offset));
+    for(auto& string : strings) {
+        file += string;
+    }
+
+    end();
+
+    /* code */
+    begin(NlcFile::sec_code, 16);
+    size_t base = file.size();
+    file += code;
+    end();
+
+    /* debug */
+    if(withDebug) {
+        begin(NlcFile::sec_debug, sizeof(size_t));
+        appendDebug(file, base);
+        end();
+    }
+
+    memcpy(&file[sizeof(fileHeader)], sections.data(), sections.size() * sizeof(NlcFile::Section));
+    return file;
+}
\ No newline at end of file
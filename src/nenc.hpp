@@ -0,0 +1,92 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 16:05:12
+ * @Description: nlc字节码编码器头文件
+ */
+#pragma once
+#include <deque>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+
+#include "global.hpp"
+#include "nlc_def.hpp"
+#include "mnem_def.hpp"
+
+/*
+ * `Nenc`用法：
+ * `Nas`与`Ndr`共用的字节码编码器，按顺序调用`label`、`instr`及`operand*`把程序直接编码到内存中，最后由`finish`得到完整的nlc文件内容
+ * 默认生成v2格式（变长操作数），`version`为`1`时生成每个操作数都为`size_t`的v1格式
+ * 标签在定义前被引用时，引用位置挂在该标签的待回填列表上，定义时立即回填，所以只需要一遍；
+ * v1中代码的标签值先记为相对代码段的偏移，常量池的大小在`finish`时才确定，届时再统一加上代码段的起始偏移，v2中则是相对于指令的偏移，不需要再调整
+ * v2中一条指令的操作数宽度取决于它的所有操作数，所以操作数先暂存，到下一条指令、标签定义或`finish`时再写出
+ * 常量与标签名用哈希表去重，字符串只在第一次出现时拷贝一份，哈希表的键指向这份拷贝
+ */
+class Nenc {
+public:
+    Nenc(bool _withDebug = true, uint32_t _version = NlcFile::version);   // `withDebug`为`false`时不生成调试段
+
+    void label(std::string_view name);
+    void instr(Mnem mnem, size_t line = 0);    // `line`为`0`表示没有对应的源码行
+    void operandNum(NlcFile::Num num);
+    void operandString(std::string_view string);
+    void operandLabel(std::string_view name);
+
+    void reserve(size_t codeBytes);   // 预估代码段大小，减少编码过程中代码缓冲区的扩容
+    std::string finish(void);
+
+private:
+    bool withDebug;
+    uint32_t version;
+
+    // `std::hash<long double>`需调用`frexpl`，较慢，所以按数字的位模式（`long double`的前10个字节）去重，`0`与`-0`也因此区分开
+    struct NumKey {
+        uint64_t low, high;
+        bool operator==(const NumKey& other) const { return low == other.low && high == other.high; }
+    };
+
+    struct NumKeyHash {
+        size_t operator()(const NumKey& key) const { return (key.low ^ (key.high << 48)) * 0x9e3779b97f4a7c15ull; }
+    };
+
+    std::unordered_map<NumKey, size_t, NumKeyHash> numTable;
+    std::vector<NlcFile::Num> nums;
+    std::deque<std::string> strings;    // 按编号排列，`deque`扩容时已有元素的地址不变
+    std::unordered_map<std::string_view, size_t> stringTable;
+
+    static const size_t undefined = (size_t)- 1;
+    struct Label {
+        size_t offset = undefined;  // 相对代码段的偏移
+        std::vector<std::pair<size_t, size_t>> pending;    // 定义前引用该标签的操作数在`code`中的位置及其所在指令的起始位置
+    };
+
+    std::deque<std::string> labelNames;
+    std::unordered_map<std::string_view, size_t> labelTable;
+    std::vector<Label> labels;      // 按第一次出现的顺序编号
+    size_t find(std::string_view name);
+    std::vector<size_t> labelRefs;  // v1中所有标签操作数在`code`中的位置
+
+    struct Operand {
+        bool isLabel;
+        size_t value;   // 常量编号或标签编号
+    };
+
+    size_t instrBegin = undefined;  // 当前指令在`code`中的起始位置
+    std::vector<Operand> operands;  // 当前指令尚未写出的操作数
+    void flush(void);
+
+    std::string code;
+    std::vector<std::pair<size_t, size_t>> lineTable;   // 相对代码段的偏移与行号
+
+    void put(size_t value, int bytes);
+    void patch(size_t position, size_t value, int bytes);
+    void patchLabel(size_t position, size_t begin, size_t offset);
+
+    void appendDebug(std::string& file, size_t base);
+    std::string finishV1(void);
+    std::string finishV2(void);
+};
\ No newline at end of file
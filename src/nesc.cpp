@@ -0,0 +1,639 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 23:04:51
+ * @Description: 逃逸分析，找出只在创建它的栈帧中使用的`list`、`map`，由虚拟机从栈帧局部的区域分配
+ */
+#include "nesc.hpp"
+
+Nesc::Nesc(const char* _code, uint32_t _version, size_t _codeBegin, size_t _codeEnd, std::function<std::string_view(size_t)> _string)
+    : code(_code), version(_version), codeBegin(_codeBegin), codeEnd(_codeEnd), string(_string) {
+    if(codeEnd <= codeBegin) {
+        return;
+    }
+
+    // 正常的程序每条指令只分析一次，共用代码的函数及合并点处常量的变化会使部分指令再分析几次
+    budget = 16 * (codeEnd - codeBegin) + 4096;
+
+    Function base;
+    base.entry = codeBegin;
+    functions.push_back(base);
+    scan();
+
+    for(size_t i = 0; i < functions.size(); i ++) {
+        if(! analyze(i)) {
+            return;
+        }
+    }
+
+    resolve();
+}
+
+// 与`Nvm::operand`、`Nvm::target`相同地解码，越界或不是合法的操作码时返回`false`
+bool Nesc::decode(size_t pc, Instr& instr) {
+    if(pc < codeBegin || pc >= codeEnd) {
+        return false;
+    }
+
+    int mnem = (uint8_t)code[pc];
+    int width = 3;
+    if(version != 1) {
+        width = mnem >> NlcFile::mnemBits;
+        mnem &= NlcFile::mnemMask;
+    }
+
+    if(mnem >= MNEM_NUM) {
+        return false;
+    }
+
+    instr.mnem = mnem;
+    instr.operand = 0;
+    instr.next = pc + 1;
+    switch(mnem) {
+        case LOAD_LOCAL: case LOAD_GLOBAL: case LOAD_NUM: case LOAD_STRING: case STORE_LOCAL: case STORE_GLOBAL:
+        case LOAD_ADDR: case JMP: case JMPC: {
+            size_t bytes = (size_t)1 << width;
+            if(codeEnd - instr.next < bytes) {
+                return false;
+            }
+
+            size_t value = 0;
+            if(width == 0) {
+                value = (uint8_t)code[instr.next];
+            } else if(width == 1) {
+                uint16_t v;
+                memcpy(&v, &code[instr.next], sizeof(v));
+                value = v;
+            } else if(width == 2) {
+                uint32_t v;
+                memcpy(&v, &code[instr.next], sizeof(v));
+                value = v;
+            } else {
+                memcpy(&value, &code[instr.next], sizeof(value));
+            }
+
+            instr.next += bytes;
+            if(mnem == LOAD_ADDR || mnem == JMP || mnem == JMPC) {
+                value = (version == 1 ? value : pc + (int32_t)(uint32_t)value);
+            }
+
+            instr.operand = value;
+            break;
+        }
+    }
+
+    return true;
+}
+
+int Nesc::newNode(void) {
+    parent.push_back(parent.size());
+    escaped.push_back(0);
+    mutated.push_back(0);
+    lent.push_back(0);
+    return parent.size() - 1;
+}
+
+int Nesc::find(int node) {
+    while(parent[node] != node) {
+        parent[node] = parent[parent[node]];
+        node = parent[node];
+    }
+
+    return node;
+}
+
+void Nesc::unite(int a, int b) {
+    a = find(a);
+    b = find(b);
+    if(a != b) {
+        parent[b] = a;
+        escaped[a] |= escaped[b];
+        mutated[a] |= mutated[b];
+        lent[a] |= lent[b];
+    }
+}
+
+void Nesc::escape(const Value& value) {
+    if(value.node >= 0) {
+        escaped[find(value.node)] = 1;
+    }
+}
+
+void Nesc::mutate(const Value& value) {
+    if(value.node >= 0) {
+        mutated[find(value.node)] = 1;
+    }
+}
+
+void Nesc::lend(const Value& value) {
+    if(value.node >= 0) {
+        lent[find(value.node)] = 1;
+    }
+}
+
+// 线性扫描一遍得到跳转目标（分析时作为基本块的起点）及所有函数入口
+void Nesc::scan(void) {
+    starts.assign((codeEnd - codeBegin + 63) / 64, 0);
+    Instr instr;
+    for(size_t pc = codeBegin; decode(pc, instr); pc = instr.next) {
+        if((instr.mnem == JMP || instr.mnem == JMPC || instr.mnem == LOAD_ADDR)
+        && instr.operand >= codeBegin && instr.operand < codeEnd) {
+            start(instr.operand);
+            if(instr.mnem == LOAD_ADDR) {
+                function(instr.operand);
+            }
+        }
+    }
+}
+
+void Nesc::start(size_t offset) {
+    starts[(offset - codeBegin) / 64] |= (uint64_t)1 << ((offset - codeBegin) % 64);
+}
+
+size_t Nesc::function(size_t entry) {
+    auto it = functionIndex.find(entry);
+    if(it != functionIndex.end()) {
+        return it -> second;
+    }
+
+    Function function;
+    function.entry = entry;
+    function.param = newNode();
+    functions.push_back(function);
+    functionIndex[entry] = functions.size() - 1;
+    return functions.size() - 1;
+}
+
+// 第一次到达时为栈中每个位置建立新节点，之后到达时与已有节点合并，常量不一致时改为非常量并重新分析该基本块
+bool Nesc::flow(Function& function, size_t target, const std::vector<Value>& stack) {
+    if(target >= codeEnd) {
+        return true;    // 执行到代码末尾时结束
+    }
+
+    if(target < codeBegin) {
+        return false;
+    }
+
+    auto it = function.states.find(target);
+    if(it == function.states.end()) {
+        std::vector<Value> state(stack.size());
+        for(size_t i = 0; i < stack.size(); i ++) {
+            state[i].node = newNode();
+            if(stack[i].node >= 0) {
+                unite(state[i].node, stack[i].node);
+            }
+
+            state[i].str = stack[i].str;
+            state[i].addr = stack[i].addr;
+        }
+
+        function.states.emplace(target, std::move(state));
+        function.work.push_back(target);
+        start(target);  // 其他函数也在这里切分基本块，只是多一个合并点
+        return true;
+    }
+
+    std::vector<Value>& state = it -> second;
+    if(state.size() != stack.size()) {
+        return false;
+    }
+
+    bool changed = false;
+    for(size_t i = 0; i < stack.size(); i ++) {
+        if(stack[i].node >= 0) {
+            unite(state[i].node, stack[i].node);
+        }
+
+        if(state[i].str != stack[i].str && state[i].str != none) {
+            state[i].str = none;
+            changed = true;
+        }
+
+        if(state[i].addr != stack[i].addr && state[i].addr != none) {
+            state[i].addr = none;
+            changed = true;
+        }
+    }
+
+    if(changed) {
+        function.work.push_back(target);
+    }
+
+    return true;
+}
+
+bool Nesc::analyze(size_t index) {
+    Function& function = functions[index];
+    std::vector<Value> stack;
+    if(function.param >= 0) {
+        Value param;
+        param.node = function.param;
+        stack.push_back(param);
+    }
+
+    flow(function, function.entry, stack);
+    while(function.work.size() && ! function.failed) {
+        size_t begin = function.work.back();
+        function.work.pop_back();
+        stack = function.states[begin];
+
+        auto need = [&](size_t n) {
+            if(stack.size() < n) {
+                function.failed = true;
+            }
+
+            return ! function.failed;
+        };
+
+        auto pop = [&]() {
+            Value value = stack.back();
+            stack.pop_back();
+            return value;
+        };
+
+        auto local = [&](size_t id) {
+            auto it = function.locals.find(id);
+            if(it == function.locals.end()) {
+                it = function.locals.emplace(id, newNode()).first;
+            }
+
+            return it -> second;
+        };
+
+        auto action = [&](const Value& name) {
+            std::string actionName(string(name.str));
+            std::transform(actionName.begin(), actionName.end(), actionName.begin(), ::toupper);
+            return actionName;
+        };
+
+        bool end = false;
+        for(size_t pc = begin; ! end && ! function.failed; ) {
+            if(pc >= codeEnd) {
+                break;
+            }
+
+            // 到达另一个基本块的起点时转入该基本块
+            if(pc != begin && (starts[(pc - codeBegin) / 64] >> ((pc - codeBegin) % 64) & 1)) {
+                function.failed = ! flow(function, pc, stack);
+                break;
+            }
+
+            if(budget == 0) {
+                return false;
+            }
+
+            budget --;
+            Instr instr;
+            if(! decode(pc, instr)) {
+                function.failed = true;
+                break;
+            }
+
+            Value value;
+            switch(instr.mnem) {
+                case LOAD_LOCAL: {
+                    value.node = local(instr.operand);
+                    stack.push_back(value);
+                    break;
+                }
+
+                case LOAD_GLOBAL: case LOAD_NUM: {
+                    stack.push_back(value);
+                    break;
+                }
+
+                case LOAD_STRING: {
+                    value.str = instr.operand;
+                    stack.push_back(value);
+                    break;
+                }
+
+                case LOAD_ADDR: {
+                    value.addr = instr.operand;
+                    stack.push_back(value);
+                    break;
+                }
+
+                case STORE_LOCAL: {
+                    if(need(1)) {
+                        value = pop();
+                        if(value.node >= 0) {
+                            unite(local(instr.operand), value.node);
+                        }
+                    }
+
+                    break;
+                }
+
+                case STORE_GLOBAL: case SEND: {
+                    if(need(instr.mnem == SEND ? 2 : 1)) {
+                        escape(pop());
+                    }
+
+                    break;
+                }
+
+                case ADD: case SUB: case MUL: case DIV: case MOD: case POW: {
+                    if(need(2)) {
+                        pop();
+                        stack.back() = value;
+                    }
+
+                    break;
+                }
+
+                case COMPARE: {
+                    if(need(3)) {
+                        pop();
+                        pop();
+                        stack.back() = value;
+                    }
+
+                    break;
+                }
+
+                case NOT: case JOIN: case AWAIT: case MAKE_CHANNEL: {
+                    if(need(1)) {
+                        stack.back() = value;
+                    }
+
+                    break;
+                }
+
+                case JMP: {
+                    function.failed = ! flow(function, instr.operand, stack);
+                    end = true;
+                    break;
+                }
+
+                case JMPC: {
+                    if(need(1)) {
+                        function.failed = ! flow(function, instr.operand, stack);
+                    }
+
+                    break;
+                }
+
+                // 目标为常量时参数是否逃逸取决于被调用的函数，在`resolve`中确定
+                case CALL: {
+                    if(need(2)) {
+                        Value addr = pop();
+                        Value args = pop();
+                        if(args.node >= 0 && addr.addr >= codeBegin && addr.addr < codeEnd) {
+                            calls.push_back({ args.node, index, addr.addr });
+                            this -> function(addr.addr);
+                        } else {
+                            escape(args);
+                        }
+
+                        stack.push_back(value);
+                    }
+
+                    break;
+                }
+
+                case CALLE: {
+                    if(need(2)) {
+                        pop();
+                        mutate(stack.back());
+                        lend(stack.back());
+                        stack.back() = value;
+                    }
+
+                    break;
+                }
+
+                case RET: {
+                    if(need(1)) {
+                        escape(stack.back());
+                    }
+
+                    end = true;
+                    break;
+                }
+
+                case MAKE_LIST: case MAKE_MAP: {
+                    value.node = newNode();
+                    sites.push_back({ pc, value.node });
+                    stack.push_back(value);
+                    break;
+                }
+
+                case ACTION_LIST: {
+                    if(! need(1)) {
+                        break;
+                    }
+
+                    Value name = pop();
+                    if(name.str == none) {
+                        function.failed = true;
+                        break;
+                    }
+
+                    std::string actionName = action(name);
+                    if(actionName == "PUSH" && need(2)) {
+                        escape(pop());
+                        mutate(stack.back());
+                    } else if(actionName == "POP" && need(1)) {
+                        stack.push_back(value);
+                    } else if(actionName == "ASSIGN" && need(3)) {
+                        escape(pop());
+                        pop();
+                    } else if((actionName == "GET" || actionName == "DEL") && need(2)) {
+                        pop();
+                        if(actionName == "GET") {
+                            stack.push_back(value);
+                        }
+                    } else if(actionName == "LEN" && need(1)) {
+                        stack.push_back(value);
+                    } else if(actionName == "PARALLEL_MAP" && need(2)) {
+                        escape(stack[stack.size() - 2]);
+                        stack.back() = value;
+                    } else if(actionName == "PARALLEL_REDUCE" && need(3)) {
+                        escape(stack[stack.size() - 3]);
+                        escape(pop());
+                        stack.back() = value;
+                    } else {
+                        end = true;     // 没有该操作时报错
+                    }
+
+                    break;
+                }
+
+                case ACTION_MAP: {
+                    if(! need(1)) {
+                        break;
+                    }
+
+                    Value name = pop();
+                    if(name.str == none) {
+                        function.failed = true;
+                        break;
+                    }
+
+                    // 没有该操作时什么也不做
+                    std::string actionName = action(name);
+                    if(actionName == "ASSIGN" && need(3)) {
+                        escape(pop());
+                        pop();
+                        mutate(stack.back());
+                    } else if((actionName == "GET" || actionName == "DEL") && need(2)) {
+                        pop();
+                        if(actionName == "GET") {
+                            stack.push_back(value);
+                        }
+                    } else if(actionName == "LEN" && need(1)) {
+                        stack.push_back(value);
+                    }
+
+                    break;
+                }
+
+                case POP_TOP: case IMPORT: {
+                    if(need(1)) {
+                        pop();
+                    }
+
+                    break;
+                }
+
+                case EXIT: {
+                    end = true;
+                    break;
+                }
+
+                case SPAWN: case TASK: {
+                    if(need(2)) {
+                        pop();
+                        escape(stack.back());
+                        stack.back() = value;
+                    }
+
+                    break;
+                }
+
+                case RECV: case TRY_RECV: {
+                    if(need(1)) {
+                        stack.push_back(value);
+                        stack.push_back(value);
+                    }
+
+                    break;
+                }
+
+                // `PROMOTE`只复制请求作用域中的对象，其他对象原样返回，所以结果与操作数视为同一个值
+                case CLOSE: case PROMOTE: {
+                    need(1);
+                    break;
+                }
+
+                // 写出快照时不从`Nregion`分配，恢复后的对象都在堆上
+                case NOP: case YIELD: case SNAPSHOT: {
+                    break;
+                }
+
+                default: {
+                    function.failed = true;
+                    break;
+                }
+            }
+
+            pc = instr.next;
+        }
+    }
+
+    if(function.failed) {
+        taint(function.entry);
+    }
+
+    return true;
+}
+
+// 放弃分析的函数中能执行到的所有`MAKE_LIST`/`MAKE_MAP`都视为逃逸，参数也视为逃逸（见`resolve`）
+void Nesc::taint(size_t entry) {
+    std::unordered_set<size_t> visited;
+    std::vector<size_t> work = { entry };
+    while(work.size()) {
+        size_t pc = work.back();
+        work.pop_back();
+
+        Instr instr;
+        while(visited.insert(pc).second && decode(pc, instr)) {
+            if(instr.mnem == MAKE_LIST || instr.mnem == MAKE_MAP) {
+                tainted.insert(pc);
+            } else if(instr.mnem == JMPC) {
+                work.push_back(instr.operand);
+            } else if(instr.mnem == JMP) {
+                work.push_back(instr.operand);
+                break;
+            } else if(instr.mnem == RET || instr.mnem == EXIT) {
+                break;
+            }
+
+            pc = instr.next;
+        }
+    }
+}
+
+// 参数逃逸的函数使传给它的值逃逸，这又可能使调用者自己的参数逃逸，用工作表传播到不动点
+void Nesc::resolve(void) {
+    std::unordered_map<size_t, std::vector<size_t>> callers;    // 入口 -> `calls`中的下标
+    for(size_t i = 0; i < calls.size(); i ++) {
+        callers[calls[i].callee].push_back(i);
+    }
+
+    std::vector<uint8_t> paramEscaped(functions.size(), 0);
+    std::vector<size_t> work;
+    for(size_t i = 0; i < functions.size(); i ++) {
+        Function& function = functions[i];
+        if(function.param >= 0 && (function.failed || escaped[find(function.param)] || mutated[find(function.param)])) {
+            paramEscaped[i] = 1;
+            work.push_back(i);
+        }
+    }
+
+    while(work.size()) {
+        Function& callee = functions[work.back()];
+        work.pop_back();
+        for(size_t i : callers[callee.entry]) {
+            int root = find(calls[i].node);
+            if(escaped[root]) {
+                continue;
+            }
+
+            escaped[root] = 1;
+            Function& caller = functions[calls[i].caller];
+            if(caller.param >= 0 && ! paramEscaped[calls[i].caller] && find(caller.param) == root) {
+                paramEscaped[calls[i].caller] = 1;
+                work.push_back(calls[i].caller);
+            }
+        }
+    }
+
+    // 同一位置可能在多个函数（或同一函数中多次）被分析，所有结果都不逃逸时才能从`Nregion`分配，其中任何一个被借用时整个位置记为借用
+    enum Result { frame, loan, heap };
+    std::unordered_map<size_t, Result> result;
+    for(auto& site : sites) {
+        int root = find(site.second);
+        Result current = (escaped[root] || tainted.count(site.first) ? heap : lent[root] ? loan : frame);
+        auto it = result.find(site.first);
+        if(it == result.end()) {
+            result[site.first] = current;
+        } else {
+            it -> second = std::max(it -> second, current);
+        }
+    }
+
+    localSites.assign((codeEnd - codeBegin + 63) / 64, 0);
+    borrowSites.assign(localSites.size(), 0);
+    for(auto& site : result) {
+        siteNum ++;
+        size_t i = site.first - codeBegin;
+        if(site.second == frame) {
+            localSites[i / 64] |= (uint64_t)1 << (i % 64);
+            localNum ++;
+        } else if(site.second == loan) {
+            borrowSites[i / 64] |= (uint64_t)1 << (i % 64);
+            borrowNum ++;
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,121 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 23:02:16
+ * @Description: 逃逸分析头文件
+ */
+#pragma once
+#include <deque>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "nlc_def.hpp"
+#include "mnem_def.hpp"
+
+/*
+ * `Nesc`用法（`Nprog`加载程序后执行一次）：
+ * Nesc esc(code, version, codeBegin, codeEnd, stringView);
+ * esc.local(offset)   // `offset`处的`MAKE_LIST`/`MAKE_MAP`创建的对象不会逃出创建它的栈帧，可以从`Nregion`分配
+ * esc.borrowed(offset)    // 只在外部函数借用`CALLE`的参数（见`nl.hpp`的`NL_EXPORT_BORROWS_ARGS`）时才不会逃出栈帧
+ *
+ * 以程序入口及所有`LOAD_ADDR`的目标为函数入口，沿控制流对每个函数做抽象解释：栈中的每个值及每个局部变量对应一个节点，
+ * 合并点、`STORE_LOCAL`处的值用并查集合并，之后任何一个值逃逸都视为同一集合中的所有对象逃逸
+ * 逃逸：`STORE_GLOBAL`、`RET`、存入`list`/`map`、`SEND`、作为`SPAWN`/`TASK`及并行的`list`操作的参数，
+ * 以及作为`CALL`的参数而被调用的函数的参数逃逸（或增长），目标不是`LOAD_ADDR`得到的常量时也视为逃逸
+ * `CALLE`的参数是否逃逸取决于运行时导入的共享库，分析时记为借用（`lent`）：只因此逃逸的对象记入`borrowSites`，由虚拟机决定是否从`Nregion`分配
+ * 借用的参数也可能被增长，所以函数把自己的参数传给外部函数时视为参数逃逸
+ * 合并点的栈深度不同、操作名不是常量、栈下溢、无法解码或分析量超出代码长度的若干倍时放弃：
+ * 该函数中的对象（整个程序超出分析量时为所有对象）都视为逃逸，不影响正确性
+ */
+class Nesc {
+public:
+    Nesc(const char* _code, uint32_t _version, size_t _codeBegin, size_t _codeEnd, std::function<std::string_view(size_t)> _string);
+
+    bool local(size_t offset) {
+        size_t i = offset - codeBegin;
+        return offset >= codeBegin && i / 64 < localSites.size() && (localSites[i / 64] >> (i % 64) & 1);
+    }
+
+    bool borrowed(size_t offset) {
+        size_t i = offset - codeBegin;
+        return offset >= codeBegin && i / 64 < borrowSites.size() && (borrowSites[i / 64] >> (i % 64) & 1);
+    }
+
+    std::vector<uint64_t> localSites;   // 按`偏移 - codeBegin`索引的位图
+    std::vector<uint64_t> borrowSites;  // 与`localSites`不相交，长度相同
+    size_t siteNum = 0;     // 分析到的`MAKE_LIST`/`MAKE_MAP`数量
+    size_t localNum = 0;
+    size_t borrowNum = 0;
+
+private:
+    const char* code;
+    uint32_t version;
+    size_t codeBegin;
+    size_t codeEnd;
+    std::function<std::string_view(size_t)> string;
+
+    static const size_t none = SIZE_MAX;
+
+    struct Instr {
+        int mnem;
+        size_t operand;     // 标签操作数已转换为文件偏移
+        size_t next;
+    };
+
+    bool decode(size_t pc, Instr& instr);
+
+    // 抽象值：`node`为并查集中的节点（不可能是本函数创建的对象时为`- 1`），`str`、`addr`为常量字符串编号及`LOAD_ADDR`的目标
+    struct Value {
+        int node = - 1;
+        size_t str = none;
+        size_t addr = none;
+    };
+
+    std::vector<int> parent;
+    std::vector<uint8_t> escaped;
+    std::vector<uint8_t> mutated;   // 可能被增长：`list`的`PUSH`、`map`的`ASSIGN`、作为`CALLE`的参数
+    std::vector<uint8_t> lent;  // 作为`CALLE`的参数
+    int newNode(void);
+    int find(int node);
+    void unite(int a, int b);
+    void escape(const Value& value);
+    void mutate(const Value& value);
+    void lend(const Value& value);
+
+    struct Function {
+        size_t entry;
+        int param = - 1;    // 基栈帧（程序入口）没有参数
+        bool failed = false;
+        std::unordered_map<size_t, int> locals;
+        std::unordered_map<size_t, std::vector<Value>> states;  // 各基本块入口的栈
+        std::vector<size_t> work;
+    };
+
+    struct Call {
+        int node;
+        size_t caller;  // 函数下标
+        size_t callee;  // 入口
+    };
+
+    std::deque<Function> functions;     // 分析中会添加新的函数，`deque`中已有元素的引用不会失效
+    std::unordered_map<size_t, size_t> functionIndex;   // 入口 -> 下标
+    std::vector<uint64_t> starts;   // 基本块起点（跳转目标及分析中到达的合并点）的位图，按`偏移 - codeBegin`索引
+    void start(size_t offset);
+    std::vector<std::pair<size_t, int>> sites;  // 偏移及其创建的对象的节点
+    std::unordered_set<size_t> tainted;     // 放弃分析的函数中的`MAKE_LIST`/`MAKE_MAP`
+    std::vector<Call> calls;
+    size_t budget;
+
+    void scan(void);
+    size_t function(size_t entry);
+    bool analyze(size_t index);     // 超出分析量时返回`false`
+    bool flow(Function& function, size_t target, const std::vector<Value>& stack);   // 栈深度不一致时返回`false`
+    void taint(size_t entry);
+    void resolve(void);
+};
\ No newline at end of file
@@ -6,12 +6,22 @@
  */
 #pragma once
 
-#include <vector>
 #include <map>
+#include <string>
+#include <vector>
+#include <memory>
+#include <string_view>
+#include <memory_resource>
 
 /*
- * 为了方便实现，`nl`没有多线程功能，唯一的线程由栈、外部函数表、全局变量表和`SP`指针组成
- * 栈由多个栈帧组成，栈帧由局部变量表、操作数栈（类JVM）组成
+ * 线程由栈、外部函数表、全局变量表和`SP`指针组成，栈由多个栈帧组成，栈帧由局部变量表、操作数栈（类JVM）组成
+ * `SPAWN`创建的线程对应一个系统线程，`TASK`创建的任务由固定数量的工作线程调度执行，
+ * 两者创建时都复制父线程的外部函数表和全局变量表，之后各自独立
+ * 程序镜像及常量只读，所有线程共用；作为参数传入或通过全局变量共享的`list`、`map`没有加锁，由程序自己保证不会同时修改
+ * 线程、任务之间应通过通道（`MAKE_CHANNEL`）传递值，`list`、`map`发送后归接收方所有
+ * 通过`thread`访问到的栈上的值可能是栈帧局部对象（见`Nesc`），外部函数可以读写、增长它们，但不能在返回后继续持有
+ * 参数`args`默认视为逃逸，从堆上分配；共享库写一次`NL_EXPORT_BORROWS_ARGS;`声明其外部函数只借用参数后，`args`也可能是栈帧局部对象，
+ * 此时同样不能持有`args`，也不能将`args`本身作为返回值，需要保留时应拷贝其中的元素
  */
 
 // 延续`Python VM`传统，将值的结构称为`xxObject`
@@ -34,17 +44,60 @@ struct StackFrame {
     std::vector<NlObject> opStack;  // 操作数栈，由多个值组成
 };
 
+class Nregion;  // 见`nmem.hpp`
+
 // 为了方便外部函数获取虚拟机整体信息及以后实现多线程，特定义线程类
 struct Nlthread {
     StackFrame* sp;    // 方便写代码而设定
     std::map<std::string, void*> externFNTable; // 外部函数表
     std::map<size_t, NlObject> globalVarTable;  // 全局变量表
     std::vector<StackFrame> stack;  // 函数栈
+    size_t ip = 0;  // 当前指令的起始位置，出错时用于定位
+    int waitFD = - 1;   // 外部函数通过`nlWait`挂起时设置，见下
+    int waitEvents = 0;
+    std::shared_ptr<Nregion> region;    // 栈帧局部对象所在的区域，第一次用到时由虚拟机创建
 };
 
 // 虚拟机中复杂数据类型实际类型的定义，为了区别于其他普通类型，统一命名为`xxxObject`
-using ListObject = std::vector<NlObject>;   // nl汇编中的`list`指的就是长度可以伸缩的数组，为了速度使用`vector`
-using MapObject = std::map<std::string, NlObject>;  // `map`的`key`为了实现简便只能为字符串，前端可以将多种类型的`key`化为字符串类型传入后端以实现多种类型的`key`
+// 使用`pmr`容器以便虚拟机统计及控制其内存分配，外部函数直接`new`时使用默认的分配器，用法与普通容器相同
+using ListObject = std::pmr::vector<NlObject>;   // nl汇编中的`list`指的就是长度可以伸缩的数组，为了速度使用`vector`
+// `map`的键也从`map`的内存资源分配，请求作用域结束时随`arena`一起释放（`std::string`的键从全局堆分配，释放`arena`时不会被析构而泄漏）
+// 比较时都转为`std::string_view`，可以直接用`std::string`、字符串常量查找
+struct NlKeyLess {
+    using is_transparent = void;
+    bool operator()(std::string_view a, std::string_view b) const { return a < b; }
+};
+
+using MapObject = std::pmr::map<std::pmr::string, NlObject, NlKeyLess>;  // `map`的`key`为了实现简便只能为字符串，前端可以将多种类型的`key`化为字符串类型传入后端以实现多种类型的`key`
+
+/*
+ * 外部函数库的二进制接口版本，`NlObject`、`ListObject`、`MapObject`等的布局改变时递增
+ * 用旧的`nl.hpp`编译的共享库按旧的布局访问`list`、`map`会破坏内存，所以共享库中要写一次`NL_EXPORT_ABI_VERSION;`，
+ * `IMPORT`时通过`dlsym`读取`nl_abi_version`，没有或与虚拟机不一致时拒绝导入，需要用当前的`nl.hpp`重新编译
+ * 1：`ListObject`、`MapObject`为`std`容器（没有`nl_abi_version`）  2：改为`pmr`容器  3：`MapObject`的键改为`std::pmr::string`
+ */
+#define NL_ABI_VERSION 3
+#define NL_EXPORT_ABI_VERSION extern "C" const int nl_abi_version = NL_ABI_VERSION
+
+// 声明共享库中的外部函数都不持有参数（见上），`IMPORT`时通过`dlsym`读取`nl_borrows_args`，没有时参数从堆上分配
+#define NL_EXPORT_BORROWS_ARGS extern "C" const int nl_borrows_args = 1
+
+/*
+ * 外部函数的挂起协议：外部函数发起的非阻塞操作尚未完成时`return nlWait(thread, fd, NL_READABLE);`，
+ * 虚拟机在`fd`就绪后以相同的参数重新调用该外部函数，外部函数应只在操作能够完成时才消耗输入、产生副作用
+ * 在任务（`TASK`）中调用时任务让出工作线程，由`epoll`等待`fd`，其他任务继续执行；其他线程中用`poll`阻塞等待
+ * 就绪只表示可以再试一次（`fd`出错或被关闭时也会唤醒），外部函数可以再次返回`nlWait`
+ */
+enum NlWaitEvent {
+    NL_READABLE = 0x001,    // 与`POLLIN`/`EPOLLIN`相同
+    NL_WRITABLE = 0x004,    // 与`POLLOUT`/`EPOLLOUT`相同
+};
+
+inline NlObject* nlWait(Nlthread* thread, int fd, int events) {
+    thread -> waitFD = fd;
+    thread -> waitEvents = events;
+    return nullptr;
+}
 
 // 为了不引起一些不必要的麻烦和节省内存空间，在传参和返回值时统一使用指针
 typedef std::vector<std::string>*(*NlEDTemplate)(void);    // NlExternDriverTemplate 外部驱动函数模板
@@ -4,6 +4,7 @@
  * @Description: nlc（nl语言字节码文件 NL Code）文件格式的定义
  */
 #pragma once
+#include <cstdint>
 
 namespace NlcFile {
     using Num = long double;    // `nlc`文件格式中的数字是`long double`
@@ -19,4 +20,153 @@ namespace NlcFile {
     /* 2. numbers */
     /* 3. strings(string: stringLength<int> + char*) */
     /* 4. code(instrs) */
+
+    /*
+     * 5. debug（可选，位于文件末尾）
+     *    labels(label: offset<size_t> + nameLength<int> + char*)
+     *    lines(line: offset<size_t> + line<size_t>，只在行号变化处记录)
+     *    DebugTrailer
+     *    虚拟机在启动时只读取文件末尾的`DebugTrailer`，再由`size`倒推出调试段及代码段的结束位置，调试段本身只在需要时才读取
+     */
+    const static int debugMagicNum = 0x20230307;
+    struct DebugTrailer {
+        size_t labelNum;
+        size_t lineNum;
+        size_t size;    // 调试段（不含`DebugTrailer`）的字节数
+        int magic = debugMagicNum;
+    };
+
+    /*
+     * v2：变长操作数编码
+     * v1的`FileHeader`中`magic`之后是未初始化的填充字节，不能用来区分版本，所以v2使用新的魔数，之后的版本再通过`version`区分
+     * FileHeaderV2 + Section[sectionNum] + 各段（每段按`align`对齐，段之间以`0`填充）
+     *    nums:    Num[]（16字节对齐，可以直接按数组访问）
+     *    strings: count<uint32_t> + offsets<uint32_t>[count + 1] + 所有字符串的字节，第`i`个字符串为`[offsets[i], offsets[i + 1])`
+     *    code:    指令，见下
+     *    debug:   与v1的调试段相同（含`DebugTrailer`），其中的偏移均为文件偏移
+     * 指令：操作码一字节，低6位为`Mnem`，高2位为操作数宽度（`0`、`1`、`2`分别为1、2、4字节，同一条指令的操作数宽度相同）
+     * 标签操作数（`JMP`、`JMPC`、`LOAD_ADDR`）为相对于该指令起始位置的32位有符号偏移，宽度总是4字节
+     * 虚拟机中的地址（`ip`、`LOAD_ADDR`得到的地址、返回地址）在两个版本中都是文件偏移
+     */
+    const static int magicNumV2 = 0x4e4c4332;    // "NLC2"
+    const static uint32_t version = 2;
+
+    struct FileHeaderV2 {
+        int magic = magicNumV2;
+        uint32_t version = NlcFile::version;
+        uint32_t sectionNum;
+        uint32_t reserved = 0;
+    };
+
+    enum SectionKind : uint32_t {
+        sec_nums = 1,
+        sec_strings,
+        sec_code,
+        sec_debug,
+    };
+
+    struct Section {
+        uint32_t kind;
+        uint32_t align;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    const static int mnemBits = 6;
+    const static int mnemMask = (1 << mnemBits) - 1;
+
+    /*
+     * 程序镜像缓存（`nl run --image-cache <dir>`）：虚拟机加载nlc文件后写出，运行同一程序的多个进程以`MAP_SHARED`只读映射同一份镜像
+     * 镜像中只有相对于镜像开头的偏移而没有指针，映射到任何地址都可以直接使用，各进程不需要再拷贝数字、扫描字符串
+     * ImageHeader + nums（16字节对齐） + strings（与v2的字符串段相同） + code（原样拷贝，编码方式为`version`） + locals（8字节对齐）
+     * locals为逃逸分析的结果（`Nprog::localSites`及`Nprog::borrowSites`，各`localWords`个字），加载镜像时直接使用，不需要每次都分析整个代码段
+     * 代码仍按原文件中的偏移寻址，调试段也仍从原文件中读取，所以记录原文件中代码段和调试段的位置
+     */
+    const static int imageMagicNum = 0x4e4c4933;    // "NLI3"，加入locals之前为"NLIM"，加入borrowSites之前为"NLI2"，旧的镜像会被重新生成
+
+    // 原文件的身份，任何一项不一致都说明原文件已改变，由`Nprog::stampSource`/`Nprog::matchesSource`写入和核对
+    struct SourceStamp {
+        uint64_t size;
+        uint64_t mtime;     // 纳秒
+        uint64_t ino;
+        uint64_t dev;
+    };
+
+    struct ImageHeader {
+        int magic = imageMagicNum;
+        uint32_t version;   // 原文件的nlc版本
+        SourceStamp source;     // 不一致时需要重新生成镜像
+
+        uint64_t numOffset;
+        uint64_t numNum;
+        uint64_t stringOffset;
+        uint64_t stringSize;
+        uint64_t codeOffset;
+        uint64_t codeBegin;     // 代码段在原文件中的偏移
+        uint64_t codeSize;
+        uint64_t debugBegin;    // 调试段在原文件中的偏移，`debugTrailer.magic`不为`debugMagicNum`时表示没有调试段
+        DebugTrailer debugTrailer;
+        uint64_t localOffset;   // 为`0`时生成镜像时没有做逃逸分析
+        uint64_t localWords;
+        uint64_t imageSize;     // 用于发现被截断的镜像
+    };
+
+    /*
+     * 堆快照（`nl run --snapshot-out <file>`执行到`SNAPSHOT`时写出，`--snapshot <file>`从中恢复后接着执行）：
+     * SnapshotHeader + ids + values + objects + nums（16字节对齐） + strings + externs
+     * 快照中没有指针，对象之间通过下标引用，恢复时先按`objects`一次分配出所有对象，再依次填入元素
+     *    ids:     uint64_t[globalNum + localNum]，全局变量及基栈帧局部变量的编号
+     *    values:  SnapshotValue[]，开头依次为全局变量、局部变量、基栈帧操作数栈中的值，之后为各对象的元素
+     *    objects: SnapshotObject[]
+     *    strings: offsets<uint64_t>[stringNum + 1] + 所有字符串的字节（`map`的键及外部函数返回的字符串）
+     *    externs: uint64_t[externNum * 2]，外部函数名及其共享库文件名在`strings`中的下标
+     * 快照依赖原文件中的变量编号、地址及常量编号，所以记录原文件的身份，不一致时拒绝恢复
+     */
+    const static int snapshotMagicNum = 0x4e4c534e;    // "NLSN"
+
+    enum SnapshotKind : uint32_t {
+        snap_num = 0,   // `index`为`nums`中的下标
+        snap_const,     // 常量字符串，`index`为常量编号
+        snap_string,    // `index`为`strings`中的下标
+        snap_list,      // 以下`index`为`objects`中的下标
+        snap_map,
+        snap_addr,
+    };
+
+    struct SnapshotValue {
+        uint32_t kind;
+        uint32_t reserved;
+        uint64_t index;
+    };
+
+    // `list`的元素为`values[begin, begin + size)`，`map`为`size`对键（`snap_string`）和值，地址对象的`begin`为地址
+    struct SnapshotObject {
+        uint32_t kind;
+        uint32_t reserved;
+        uint64_t begin;
+        uint64_t size;
+    };
+
+    struct SnapshotHeader {
+        int magic = snapshotMagicNum;
+        uint32_t reserved = 0;
+        SourceStamp source;     // 不一致时拒绝恢复
+
+        uint64_t resume;    // `SNAPSHOT`的下一条指令
+        uint64_t globalNum;
+        uint64_t localNum;
+        uint64_t stackNum;
+        uint64_t idOffset;
+        uint64_t valueOffset;
+        uint64_t valueNum;
+        uint64_t objectOffset;
+        uint64_t objectNum;
+        uint64_t numOffset;
+        uint64_t numNum;
+        uint64_t stringOffset;
+        uint64_t stringNum;
+        uint64_t externOffset;
+        uint64_t externNum;
+        uint64_t snapshotSize;
+    };
 };
\ No newline at end of file
@@ -0,0 +1,159 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 18:13:05
+ * @Description: 嵌入接口，加载一次程序后在多个上下文中反复执行，错误转为状态码
+ */
+#include "nlib.hpp"
+
+NlStatus Nlib::fail(NlStatus status, std::string _message) {
+    message = _message;
+    return status;
+}
+
+NlStatus Nlib::load(std::string fileName, NvmOption option) {
+    vm.reset();
+    entries.clear();
+
+    try {
+        vm.reset(new Nvm(fileName, option));
+    } catch(std::exception& e) {
+        return fail(nl_load_error, e.what());
+    }
+
+    return nl_ok;
+}
+
+NlStatus Nlib::share(Nlib& loaded, NvmOption option) {
+    if(! loaded.vm) {
+        return fail(nl_no_program, "no program loaded");
+    }
+
+    std::shared_ptr<Nprog> prog = loaded.vm -> program();
+    vm.reset();
+    entries.clear();
+
+    try {
+        vm.reset(new Nvm(prog, option));
+    } catch(std::exception& e) {
+        return fail(nl_load_error, e.what());
+    }
+
+    return nl_ok;
+}
+
+Nlthread* Nlib::newContext(void) {
+    if(! vm) {
+        return nullptr;
+    }
+
+    Nlthread* context = new Nlthread();
+    vm -> initThread(*context);
+    return context;
+}
+
+void Nlib::freeContext(Nlthread* context) {
+    delete context;
+}
+
+NlStatus Nlib::run(Nlthread* context) {
+    if(! vm) {
+        return fail(nl_no_program, "no program loaded");
+    }
+
+    bool arena = vm -> arenaMode();
+    if(arena) {
+        vm -> beginScope();
+    }
+
+    try {
+        vm -> start(*context);
+    } catch(std::exception& e) {
+        vm -> resetThread(*context);
+        if(arena) {
+            endArena(context);
+        }
+
+        return fail(nl_runtime_error, e.what());
+    }
+
+    if(arena) {
+        endArena(context);
+    }
+
+    return nl_ok;
+}
+
+NlStatus Nlib::call(Nlthread* context, std::string label, std::vector<NlObject> args, NlObject& result) {
+    if(! vm) {
+        return fail(nl_no_program, "no program loaded");
+    }
+
+    size_t addr;
+    auto entry = entries.find(label);
+    if(entry != entries.end()) {
+        addr = entry -> second;
+    } else if(vm -> find(label, addr)) {
+        entries[label] = addr;
+    } else {
+        return fail(nl_not_found, label + " label does not exist");
+    }
+
+    bool arena = vm -> arenaMode();
+    if(arena) {
+        vm -> beginScope();
+    }
+
+    try {
+        ListObject* list = vm -> newList();
+        list -> assign(args.begin(), args.end());
+        result = vm -> call(*context, addr, list);
+        if(arena) {
+            result = vm -> promote(result);
+        }
+    } catch(std::exception& e) {
+        vm -> resetThread(*context);
+        if(arena) {
+            endArena(context);
+        }
+
+        return fail(nl_runtime_error, e.what());
+    }
+
+    if(arena) {
+        endArena(context);
+    }
+
+    return nl_ok;
+}
+
+ListObject* Nlib::newList(void) {
+    return vm ? vm -> newList() : nullptr;
+}
+
+MapObject* Nlib::newMap(void) {
+    return vm ? vm -> newMap() : nullptr;
+}
+
+void Nlib::beginScope(Nlthread* context) {
+    if(! vm) {
+        return;
+    }
+
+    savedGlobals = context -> globalVarTable;
+    vm -> beginScope();
+}
+
+// 先恢复全局变量再释放`arena`，全局变量中就不会留下指向已释放内存的指针
+void Nlib::endScope(Nlthread* context) {
+    if(! vm) {
+        return;
+    }
+
+    context -> globalVarTable = savedGlobals;
+    vm -> endScope();
+}
+
+void Nlib::endArena(Nlthread* context) {
+    vm -> dropScoped(*context);
+    vm -> endScope();
+}
\ No newline at end of file
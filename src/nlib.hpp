@@ -0,0 +1,80 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 18:12:40
+ * @Description: 嵌入接口头文件
+ */
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include <memory>
+#include <exception>
+
+#include "nl.hpp"
+#include "nvm.hpp"
+#include "global.hpp"
+
+enum NlStatus {
+    nl_ok = 0,
+    nl_no_program,      // 还没有成功加载程序
+    nl_load_error,      // 文件不存在或格式错误
+    nl_not_found,       // 没有该标签（或程序没有调试段）
+    nl_runtime_error,   // 执行时出错，上下文的栈已恢复为只有基栈帧，全局变量及已导入的外部函数保留
+};
+
+/*
+ * `Nlib`用法（嵌入接口，链接`libnl`）：
+ * 所有接口都不会抛出异常或退出进程，出错时返回状态码，错误信息（与命令行中`Nl ERROR:`之后的内容相同）保存在`message`中
+ *
+ * Nlib lib;
+ * if(lib.load("handler.nlc") != nl_ok) { ... lib.message ... }    // 只加载一次，之后可以反复执行
+ * Nlthread* context = lib.newContext();   // 上下文拥有独立的全局变量表、外部函数表及栈，创建时只分配一个基栈帧
+ * lib.run(context);    // 从程序入口执行到`EXIT`，通常用于初始化全局变量及`IMPORT`外部函数
+ * NlObject result;
+ * lib.call(context, "handler", { arg }, result);    // 调用标签处的函数，参数按`CALL`指令的约定放在一个`list`中传入，得到其`RET`的值
+ * lib.freeContext(context);
+ *
+ * 处理请求时可以用`beginScope`/`endScope`包围，其间创建的`list`、`map`等在`endScope`时一次性释放，全局变量恢复为`beginScope`时的值
+ * 作用域中创建的对象（包括返回值）只在`endScope`之前有效
+ * 也可以在`load`时开启`NvmOption::arena`，不需要调用`beginScope`/`endScope`：每次`run`、`call`结束时都释放执行中创建的对象，
+ * `call`的返回值自动复制到堆上，全局变量只保留`PROMOTE`后存入的对象（见`nvm.hpp`）
+ *
+ * 以`NvmOption::snapshot`加载时`run`从堆快照恢复全局变量及外部函数，再从`SNAPSHOT`之后执行，不再执行初始化部分（见`nvm.hpp`）
+ *
+ * 调用标签需要调试段（`nl asm`时不加`--strip`）
+ * 参数中的字符串由宿主持有，返回值中的字符串及`list`、`map`由虚拟机持有，在`Nlib`析构前有效
+ * 同一个`Nlib`同时只能执行一个上下文，多线程时每个线程使用各自的`Nlib`
+ *
+ * 隔离区（每个`Nlib`为一个隔离区，见`Nprog`）：
+ * Nlib isolate;
+ * isolate.share(lib);     // 共用`lib`已加载的程序及已导入的共享库，不再读取文件，全局变量、堆、线程及任务调度器都是独立的
+ * 共用同一程序的多个`Nlib`可以在不同线程中同时执行，但一个`Nlib`的上下文及对象不能传给另一个`Nlib`
+ */
+class Nlib {
+public:
+    std::string message;    // 最近一次出错的错误信息
+
+    NlStatus load(std::string fileName, NvmOption option = NvmOption());
+    NlStatus share(Nlib& loaded, NvmOption option = NvmOption());  // `loaded`还没有成功加载程序时返回`nl_no_program`
+
+    Nlthread* newContext(void);
+    void freeContext(Nlthread* context);
+
+    NlStatus run(Nlthread* context);
+    NlStatus call(Nlthread* context, std::string label, std::vector<NlObject> args, NlObject& result);
+
+    // 宿主构造参数用，在作用域中调用时随作用域释放
+    ListObject* newList(void);
+    MapObject* newMap(void);
+
+    void beginScope(Nlthread* context);
+    void endScope(Nlthread* context);
+
+private:
+    std::unique_ptr<Nvm> vm;
+    std::map<std::string, size_t> entries;  // 已查找过的标签，避免每次调用都遍历标签表
+    std::map<size_t, NlObject> savedGlobals;    // `beginScope`时的全局变量
+
+    NlStatus fail(NlStatus status, std::string _message);
+    void endArena(Nlthread* context);   // 结束`option.arena`时每次执行的作用域
+};
\ No newline at end of file
@@ -0,0 +1,39 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 16:44:51
+ * @Description: 只读文件映射
+ */
+#include "nmap.hpp"
+
+Nmap::Nmap(std::string fileName, int advice, bool shared) {
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if(fd < 0) {
+        error(fileName + " open error");
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        close(fd);
+        error(fileName + " stat error");
+    }
+
+    length = st.st_size;
+    if(length > 0) {
+        void* p = mmap(NULL, length, PROT_READ, shared ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+        if(p == MAP_FAILED) {
+            close(fd);
+            error(fileName + " mmap error");
+        }
+
+        address = (const char*)p;
+        madvise(p, length, advice);
+    }
+
+    close(fd);  // 映射建立后不再需要文件描述符
+}
+
+Nmap::~Nmap() {
+    if(address) {
+        munmap((void*)address, length);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 16:42:18
+ * @Description: 只读文件映射头文件
+ */
+#pragma once
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "global.hpp"
+
+/*
+ * `Nmap`用法：
+ * 以只读方式`mmap`整个文件，析构时解除映射，省去读入`std::string`的拷贝，且只有实际访问到的页才会被读入
+ * `advice`传给`madvise`：汇编器读取源码等只需顺序读一遍的场景使用默认的`MADV_SEQUENTIAL`，虚拟机会随跳转来回访问代码段，使用`MADV_NORMAL`
+ * `shared`为`true`时使用`MAP_SHARED`，用于多个进程共用的程序镜像
+ * 空文件不做映射，`data`为`nullptr`、`size`为`0`
+ */
+class Nmap {
+public:
+    Nmap(std::string fileName, int advice = MADV_SEQUENTIAL, bool shared = false);
+    ~Nmap();
+
+    Nmap(const Nmap&) = delete;
+    Nmap& operator=(const Nmap&) = delete;
+
+    const char* data(void) { return address; }
+    size_t size(void) { return length; }
+    std::string_view view(void) { return std::string_view(address, length); }
+
+private:
+    const char* address = nullptr;
+    size_t length = 0;
+};
\ No newline at end of file
@@ -0,0 +1,303 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 12:06:21
+ * @Description: 虚拟机内存分配与按对象类别统计
+ */
+#include "nmem.hpp"
+
+const char* Nmem::kindName[Nmem::mem_kind_num] = {
+    "list", "map", "string", "addr", "frame", "extern", "thread", "task", "channel", "local",
+};
+
+volatile sig_atomic_t Nmem::reportRequested = 0;
+thread_local const size_t* Nmem::ip = nullptr;
+
+// 作用域中只有一个线程执行，不统计分配位置时先累加到普通变量中，结束作用域或输出统计时再一次性计入，省去每次分配的原子操作
+void* Nmem::Resource::do_allocate(size_t bytes, size_t alignment) {
+    void* p = upstream -> allocate(bytes, alignment);
+    if(! scoped) {
+        mem -> record(kind, bytes);
+    } else if(mem -> sitesEnabled) {
+        mem -> record(kind, bytes);
+        mem -> scopedBytes[kind] += bytes;
+    } else {
+        mem -> pendingAllocs[kind] ++;
+        mem -> pendingBytes[kind] += bytes;
+    }
+
+    return p;
+}
+
+// `arena`中释放的内存直到作用域结束才能重新使用，所以不从统计中减去
+void Nmem::Resource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    upstream -> deallocate(p, bytes, alignment);
+    if(! scoped) {
+        mem -> release(kind, bytes);
+    }
+}
+
+bool Nmem::Resource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+bool Nmem::Chunks::contains(const void* p) {
+    for(auto& range : ranges) {
+        if((const char*)p >= range.first && (const char*)p < range.first + range.second) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void* Nmem::Chunks::do_allocate(size_t bytes, size_t alignment) {
+    void* p = std::pmr::new_delete_resource() -> allocate(bytes, alignment);
+    ranges.push_back({ (const char*)p, bytes });
+    return p;
+}
+
+void Nmem::Chunks::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    ranges.erase(std::find(ranges.begin(), ranges.end(), std::pair<const char*, size_t>((const char*)p, bytes)));
+    std::pmr::new_delete_resource() -> deallocate(p, bytes, alignment);
+}
+
+bool Nmem::Chunks::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+Nmem::Nmem(void) : arena(std::pmr::new_delete_resource()) {
+    // `resources`创建后不能再扩容，否则已经交给容器的资源指针会失效
+    resources.reserve(mem_kind_num);
+    scopedResources.reserve(mem_kind_num);
+    objectResources.reserve(mem_kind_num);
+    for(int kind = 0; kind < mem_kind_num; kind ++) {
+        resources.push_back(Resource(this, (Kind)kind, std::pmr::new_delete_resource(), false));
+        scopedResources.push_back(Resource(this, (Kind)kind, &arena, true));
+        objectResources.push_back(Resource(this, (Kind)kind, &objects[kind].buffer, true));
+    }
+}
+
+void Nmem::beginScope(void) {
+    inScope = true;
+}
+
+void Nmem::flushScoped(void) {
+    for(int kind = 0; kind < mem_kind_num; kind ++) {
+        if(pendingAllocs[kind]) {
+            add(stats[kind], pendingBytes[kind], pendingAllocs[kind]);
+            add(total, pendingBytes[kind], pendingAllocs[kind]);
+            scopedBytes[kind] += pendingBytes[kind];
+            pendingAllocs[kind] = pendingBytes[kind] = 0;
+        }
+    }
+}
+
+void Nmem::endScope(void) {
+    flushScoped();
+    inScope = false;
+    for(int kind = 0; kind < mem_kind_num; kind ++) {
+        release((Kind)kind, scopedBytes[kind]);
+        scopedBytes[kind] = 0;
+    }
+
+    arena.release();
+    for(auto& object : objects) {
+        object.buffer.release();
+    }
+}
+
+// 作用域中对象本身与其元素分别从`objectResources`和`scopedResources`分配，统计时都计入同一类别
+ListObject* Nmem::newList(bool longLived) {
+    bool scoped = inScope && ! longLived;
+    std::pmr::memory_resource* resource = scoped ? &scopedResources[mem_list] : &resources[mem_list];
+    void* p = (scoped ? &objectResources[mem_list] : resource) -> allocate(sizeof(ListObject), alignof(ListObject));
+    return new(p) ListObject(resource);
+}
+
+MapObject* Nmem::newMap(bool longLived) {
+    bool scoped = inScope && ! longLived;
+    std::pmr::memory_resource* resource = scoped ? &scopedResources[mem_map] : &resources[mem_map];
+    void* p = (scoped ? &objectResources[mem_map] : resource) -> allocate(sizeof(MapObject), alignof(MapObject));
+    return new(p) MapObject(resource);
+}
+
+size_t* Nmem::newAddr(size_t addr, bool longLived) {
+    Resource& resource = (inScope && ! longLived ? objectResources[mem_addr] : resources[mem_addr]);
+    size_t* p = (size_t*)resource.allocate(sizeof(size_t), alignof(size_t));
+    *p = addr;
+    return p;
+}
+
+Nmem::Kind Nmem::owner(const void* p) {
+    for(Kind kind : { mem_list, mem_map, mem_addr }) {
+        if(objects[kind].chunks.contains(p)) {
+            return kind;
+        }
+    }
+
+    return mem_kind_num;
+}
+
+void Nmem::add(Stats& target, size_t bytes, size_t allocs) {
+    target.allocs.fetch_add(allocs, std::memory_order_relaxed);
+    target.totalBytes.fetch_add(bytes, std::memory_order_relaxed);
+    size_t live = target.liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    size_t peak = target.peakBytes.load(std::memory_order_relaxed);
+    while(live > peak && ! target.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+}
+
+void Nmem::record(Kind kind, size_t bytes) {
+    add(stats[kind], bytes);
+    add(total, bytes);
+
+    if(sitesEnabled && ip) {
+        std::lock_guard<std::mutex> lock(siteMutex);
+        Site& site = sites[{ kind, *ip }];
+        site.allocs ++;
+        site.bytes += bytes;
+    }
+}
+
+void Nmem::release(Kind kind, size_t bytes) {
+    stats[kind].liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+    total.liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+void Nmem::enableSites(void) {
+    sitesEnabled = true;
+}
+
+const size_t* Nmem::trackSites(const size_t* _ip) {
+    const size_t* previous = ip;
+    ip = _ip;
+    return previous;
+}
+
+void Nmem::installSignalHandler(void) {
+    struct sigaction action = {};
+    action.sa_handler = [](int) { reportRequested = 1; };
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGUSR1, &action, NULL);
+}
+
+void Nmem::report(std::ostream& output, std::function<std::string(size_t)> describe) {
+    flushScoped();
+
+    char buffer[160];
+    output << "Nl memory stats:\n";
+    snprintf(buffer, sizeof(buffer), "  %-8s %12s %14s %14s %14s\n", "kind", "allocs", "live bytes", "peak bytes", "total bytes");
+    output << buffer;
+
+    auto line = [&](const char* name, Stats& s) {
+        snprintf(buffer, sizeof(buffer), "  %-8s %12zu %14zu %14zu %14zu\n", name,
+                 s.allocs.load(), s.liveBytes.load(), s.peakBytes.load(), s.totalBytes.load());
+        output << buffer;
+    };
+
+    for(int kind = 0; kind < mem_kind_num; kind ++) {
+        line(kindName[kind], stats[kind]);
+    }
+
+    line("total", total);
+
+    if(! sitesEnabled) {
+        return;
+    }
+
+    // 只输出分配字节数最多的若干位置
+    std::vector<std::pair<std::pair<Kind, size_t>, Site>> sorted;
+    {
+        std::lock_guard<std::mutex> lock(siteMutex);
+        sorted.assign(sites.begin(), sites.end());
+    }
+
+    std::sort(sorted.begin(), sorted.end(),
+        [](const std::pair<std::pair<Kind, size_t>, Site>& x, const std::pair<std::pair<Kind, size_t>, Site>& y) {
+            return x.second.bytes > y.second.bytes;
+        });
+
+    output << "Nl allocation sites (top 20 by bytes):\n";
+    for(size_t i = 0; i < sorted.size() && i < 20; i ++) {
+        snprintf(buffer, sizeof(buffer), "  %-8s %12zu %14zu  ", kindName[sorted[i].first.first],
+                 sorted[i].second.allocs, sorted[i].second.bytes);
+        output << buffer << describe(sorted[i].first.second) << '\n';
+    }
+}
+
+Nregion::~Nregion() {
+    for(auto& chunk : chunks) {
+        std::pmr::new_delete_resource() -> deallocate(chunk.base, chunk.size, alignof(std::max_align_t));
+        mem -> release(Nmem::mem_local, chunk.size);
+    }
+}
+
+// 栈顶之上残留的记号属于已经不存在的栈帧（如出错后），先回退
+void Nregion::enter(size_t depth) {
+    if(marks.size() && marks.back().depth > depth) {
+        leave(depth + 1);
+    }
+
+    if(! marks.size() || marks.back().depth != depth) {
+        marks.push_back({ depth, current, used });
+    }
+}
+
+void Nregion::leave(size_t depth) {
+    if(! marks.size() || marks.back().depth < depth) {
+        return;
+    }
+
+    Mark mark = marks.back();
+    while(marks.size() && marks.back().depth >= depth) {
+        mark = marks.back();
+        marks.pop_back();
+    }
+
+    current = mark.chunk;
+    used = mark.used;
+}
+
+ListObject* Nregion::newList(size_t depth) {
+    enter(depth);
+    return new(allocate(sizeof(ListObject), alignof(ListObject))) ListObject(this);
+}
+
+MapObject* Nregion::newMap(size_t depth) {
+    enter(depth);
+    return new(allocate(sizeof(MapObject), alignof(MapObject))) MapObject(this);
+}
+
+// 当前块放不下时依次使用之后已有的块，都放不下时在末尾添加一个新块，块的大小倍增到`maxChunk`为止
+void* Nregion::do_allocate(size_t bytes, size_t alignment) {
+    while(true) {
+        if(current < chunks.size()) {
+            uintptr_t base = (uintptr_t)chunks[current].base;
+            size_t offset = ((base + used + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+            if(offset + bytes <= chunks[current].size) {
+                used = offset + bytes;
+                return chunks[current].base + offset;
+            }
+
+            if(current + 1 < chunks.size()) {
+                current ++;
+                used = 0;
+                continue;
+            }
+        }
+
+        size_t size = std::min(maxChunk, chunks.size() ? chunks.back().size * 2 : firstChunk);
+        size = std::max(size, bytes + alignment);
+        chunks.push_back({ (char*)std::pmr::new_delete_resource() -> allocate(size, alignof(std::max_align_t)), size });
+        mem -> record(Nmem::mem_local, size);
+        current = chunks.size() - 1;
+        used = 0;
+    }
+}
+
+// 单个对象的内存不单独回收，栈帧返回时整体回退
+void Nregion::do_deallocate(void*, size_t, size_t) {}
+
+bool Nregion::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
\ No newline at end of file
@@ -0,0 +1,195 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 12:05:48
+ * @Description: 虚拟机内存分配与统计头文件
+ */
+#pragma once
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <iostream>
+#include <functional>
+#include <memory_resource>
+
+#include <signal.h>
+
+#include "nl.hpp"
+#include "global.hpp"
+
+/*
+ * `Nmem`用法：
+ * 虚拟机中所有`list`、`map`、地址等对象都通过`Nmem`分配，`list`和`map`内部元素（包括`map`的键）所占的内存也通过其`pmr`分配器计入对应类别
+ * 常量字符串、栈帧及外部函数返回值等不由`Nmem`分配的对象通过`record`/`release`只做记录
+ * 每类对象统计分配次数、当前存活字节数、峰值字节数及累计字节数，开启`sites`时还按字节码偏移统计分配位置
+ * 请求作用域（`beginScope`/`endScope`）：作用域中新建的对象从`arena`分配，结束时一次性释放
+ * 作用域中的分配（不开启`sites`时）在作用域结束或输出统计时才一次性计入，其中释放的内存在作用域结束前仍计为存活
+ * `list`、`map`、地址对象本身各从单独的`arena`分配并记下其内存块的范围，`owner`据此判断指针是否指向作用域中的对象及其类别（供`PROMOTE`使用）
+ * `pmr`容器始终使用创建时的内存资源，所以作用域外创建的对象在作用域中增长时仍从原来的分配器分配，不会指向`arena`中的内存
+ * 但作用域中创建的对象不能存入作用域外创建的对象中，结束后即失效
+ * 逃逸分析（见`Nesc`）证明不会逃出栈帧的`list`、`map`由各线程的`Nregion`分配，只按内存块计入`local`
+ */
+class Nmem {
+public:
+    enum Kind {
+        mem_list = 0,
+        mem_map,
+        mem_string,
+        mem_addr,
+        mem_frame,
+        mem_extern,     // 外部函数返回值
+        mem_thread,     // `SPAWN`创建的线程
+        mem_task,       // `TASK`创建的任务
+        mem_channel,    // 通道及其缓冲区
+        mem_local,      // 栈帧局部对象所在的`Nregion`的内存块
+        mem_kind_num,
+    };
+
+    struct Stats {
+        std::atomic<size_t> allocs{0};
+        std::atomic<size_t> liveBytes{0};
+        std::atomic<size_t> peakBytes{0};
+        std::atomic<size_t> totalBytes{0};
+    };
+
+    // 统计后转发给上游的内存资源，每类对象一个
+    class Resource : public std::pmr::memory_resource {
+    public:
+        Resource(Nmem* _mem, Kind _kind, std::pmr::memory_resource* _upstream, bool _scoped)
+            : mem(_mem), kind(_kind), upstream(_upstream), scoped(_scoped) {}
+
+    private:
+        Nmem* mem;
+        Kind kind;
+        std::pmr::memory_resource* upstream;
+        bool scoped;    // 是否为请求作用域的资源
+
+        void* do_allocate(size_t bytes, size_t alignment);
+        void do_deallocate(void* p, size_t bytes, size_t alignment);
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept;
+    };
+
+    // 向上游申请内存块时记下其范围，块数随容量倍增，只有十几个
+    class Chunks : public std::pmr::memory_resource {
+    public:
+        bool contains(const void* p);
+
+    private:
+        std::vector<std::pair<const char*, size_t>> ranges;
+
+        void* do_allocate(size_t bytes, size_t alignment);
+        void do_deallocate(void* p, size_t bytes, size_t alignment);
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept;
+    };
+
+    Nmem(void);
+
+    // `longLived`为`true`时即使在作用域中也从堆分配，用于`PROMOTE`
+    ListObject* newList(bool longLived = false);
+    MapObject* newMap(bool longLived = false);
+    size_t* newAddr(size_t addr, bool longLived = false);
+    Kind owner(const void* p);  // 作用域中创建的`list`、`map`、地址返回其类别，其他指针返回`mem_kind_num`
+
+    void record(Kind kind, size_t bytes);
+    void release(Kind kind, size_t bytes);
+
+    void beginScope(void);
+    void endScope(void);
+
+    bool scoped(void) { return inScope; }
+
+    // 开启后按当前指令的偏移统计分配位置，执行字节码的每个系统线程通过`trackSites`设置各自的指令偏移
+    void enableSites(void);
+    static const size_t* trackSites(const size_t* _ip);    // 返回之前的设置
+
+    void report(std::ostream& output, std::function<std::string(size_t)> describe);
+
+    // 收到`SIGUSR1`时只设置标志，由虚拟机在指令之间检查并输出，避免在信号处理函数中做不安全的操作
+    static volatile sig_atomic_t reportRequested;
+    static void installSignalHandler(void);
+
+private:
+    static const char* kindName[mem_kind_num];
+
+    std::vector<Resource> resources;
+    std::pmr::monotonic_buffer_resource arena;     // 作用域中容器的元素
+    std::vector<Resource> scopedResources;
+
+    // 作用域中的`list`、`map`、地址对象本身，按类别分开以便`owner`判断（只用到这三类）
+    struct ObjectArena {
+        Chunks chunks;
+        std::pmr::monotonic_buffer_resource buffer{&chunks};
+    };
+
+    ObjectArena objects[mem_kind_num];
+    std::vector<Resource> objectResources;
+    bool inScope = false;
+    size_t scopedBytes[mem_kind_num] = {};  // 作用域中已计入统计的字节数，`arena`整体释放时从统计中减去
+    size_t pendingAllocs[mem_kind_num] = {};    // 作用域中尚未计入统计的分配
+    size_t pendingBytes[mem_kind_num] = {};
+    void flushScoped(void);
+    Stats stats[mem_kind_num];
+    Stats total;
+
+    struct Site {
+        size_t allocs = 0;
+        size_t bytes = 0;
+    };
+
+    bool sitesEnabled = false;
+    static thread_local const size_t* ip;
+    std::mutex siteMutex;
+    std::map<std::pair<Kind, size_t>, Site> sites;
+
+    void add(Stats& target, size_t bytes, size_t allocs = 1);
+};
+
+/*
+ * `Nregion`用法（每个`Nlthread`第一次创建栈帧局部对象时由虚拟机创建）：
+ * 按栈帧分段的线性分配器，`depth`为创建对象的栈帧在`stack`中的下标，每个栈帧第一次分配时记下当前位置，
+ * 该栈帧返回时（`leave`）回退到该位置，内存块保留给之后的栈帧使用，`Nlthread`析构时才释放
+ * 只有逃逸分析证明在创建它的栈帧返回前不会再被使用、且只在该栈帧位于栈顶时增长的对象才能从这里分配
+ */
+class Nregion : public std::pmr::memory_resource {
+public:
+    Nregion(Nmem* _mem) : mem(_mem) {}
+    ~Nregion();
+
+    Nregion(const Nregion&) = delete;
+    Nregion& operator=(const Nregion&) = delete;
+
+    ListObject* newList(size_t depth);
+    MapObject* newMap(size_t depth);
+    void leave(size_t depth);   // 下标不小于`depth`的栈帧都已返回
+
+private:
+    struct Chunk {
+        char* base;
+        size_t size;
+    };
+
+    struct Mark {
+        size_t depth;
+        size_t chunk;
+        size_t used;
+    };
+
+    static constexpr size_t firstChunk = 4096;
+    static constexpr size_t maxChunk = 1 << 20;
+
+    Nmem* mem;
+    std::vector<Chunk> chunks;
+    size_t current = 0;     // 正在使用的内存块
+    size_t used = 0;    // 其中已分配的字节数
+    std::vector<Mark> marks;    // 按`depth`递增
+    void enter(size_t depth);
+
+    void* do_allocate(size_t bytes, size_t alignment);
+    void do_deallocate(void* p, size_t bytes, size_t alignment);
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept;
+};
\ No newline at end of file
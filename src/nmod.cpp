@@ -0,0 +1,21 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 23:48:31
+ * @Description: 内置模块注册表
+ */
+#include "nmod.hpp"
+
+std::map<std::string, Nmod::Module>& Nmod::modules(void) {
+    static std::map<std::string, Module> registered;
+    return registered;
+}
+
+bool Nmod::add(std::string name, Module module) {
+    modules()[name] = module;
+    return true;
+}
+
+const Nmod::Module* Nmod::find(std::string name) {
+    auto found = modules().find(name);
+    return found == modules().end() ? nullptr : &found -> second;
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 23:48:05
+ * @Description: 内置模块注册表头文件
+ */
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "nl.hpp"
+
+/*
+ * `Nmod`用法：
+ * 编译进`nl`的标准模块在静态初始化时登记其外部函数，`IMPORT "io"`先在这里查找，找到时不访问文件系统、不`dlopen`，第三方模块仍从共享库导入
+ *
+ * static NlObject* print(Nlthread* thread, ListObject* args) { ... }
+ * NL_BUILTIN_MODULE(io, { { "print", (void*)print } });
+ *
+ * 静态库中没有被引用的目标文件不会被链接进来，所以内置模块编译为对象库`nlstd`（见`std/CMakeLists.txt`）直接链接到`nl`，嵌入`libnl`的宿主需要时也链接`nlstd`
+ * 只在`main`之前登记，之后只读，查找时不需要加锁
+ * 内置模块的外部函数都只借用参数（见`nl.hpp`的`NL_EXPORT_BORROWS_ARGS`）
+ */
+class Nmod {
+public:
+    typedef std::vector<std::pair<std::string, void*>> Module;  // 外部函数名及函数，与共享库的`driver`返回的顺序相同
+
+    static bool add(std::string name, Module module);   // 返回值只用于在静态初始化时调用
+    static const Module* find(std::string name);    // 不是内置模块时返回`nullptr`
+
+private:
+    static std::map<std::string, Module>& modules(void);    // 函数中的静态变量在第一次调用时构造，不受各文件静态初始化顺序的影响
+};
+
+#define NL_BUILTIN_MODULE(name, ...) static bool nlBuiltin_##name = Nmod::add(#name, __VA_ARGS__)
\ No newline at end of file
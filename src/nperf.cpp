@@ -0,0 +1,249 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 11:21:02
+ * @Description: 通过`perf_event_open`统计虚拟机执行期间的硬件性能计数器
+ */
+#include "nperf.hpp"
+
+const char* Nperf::opClassName[Nperf::op_class_num] = {
+    "dispatch", "load/store", "arith", "control", "collection", "extern", "other",
+};
+
+Nperf::OpClass Nperf::classOf(int mnem) {
+    switch(mnem) {
+        case LOAD_LOCAL: case LOAD_GLOBAL: case LOAD_NUM: case LOAD_STRING:
+        case LOAD_ADDR: case STORE_LOCAL: case STORE_GLOBAL: {
+            return op_load_store;
+        }
+
+        case ADD: case SUB: case MUL: case DIV: case MOD: case POW:
+        case NOT: case COMPARE: {
+            return op_arith;
+        }
+
+        case JMP: case JMPC: case CALL: case RET: case SPAWN: case JOIN:
+        case TASK: case AWAIT: case YIELD:
+        case SEND: case RECV: case TRY_RECV: case CLOSE: {
+            return op_control;
+        }
+
+        case MAKE_LIST: case ACTION_LIST: case MAKE_MAP: case ACTION_MAP: case MAKE_CHANNEL:
+        case PROMOTE: {
+            return op_collection;
+        }
+
+        case CALLE: case IMPORT: {
+            return op_extern;
+        }
+    }
+
+    return op_other;
+}
+
+Nperf::Nperf(bool _byClass) : byClass(_byClass) {
+    #define HW_CACHE(cache, op, result) \
+        (PERF_COUNT_HW_CACHE_##cache | (PERF_COUNT_HW_CACHE_OP_##op << 8) | (PERF_COUNT_HW_CACHE_RESULT_##result << 16))
+    counters = {
+        { "task-clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, - 1, 0 },
+        { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, - 1, 0 },
+        { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, - 1, 0 },
+        { "branches", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS, - 1, 0 },
+        { "branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, - 1, 0 },
+        { "L1-dcache-loads", PERF_TYPE_HW_CACHE, HW_CACHE(L1D, READ, ACCESS), - 1, 0 },
+        { "L1-dcache-load-misses", PERF_TYPE_HW_CACHE, HW_CACHE(L1D, READ, MISS), - 1, 0 },
+        { "LLC-references", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES, - 1, 0 },
+        { "LLC-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, - 1, 0 },
+    };
+    #undef HW_CACHE
+
+    // 每个计数器单独打开而不组成组，硬件计数器不够时由内核分时复用，最终按运行时间比例缩放
+    for(auto& counter : counters) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = counter.type;
+        attr.config = counter.config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;    // 普通用户在`perf_event_paranoid`为2时只能统计用户态
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        counter.fd = syscall(SYS_perf_event_open, &attr, 0, - 1, - 1, 0);
+    }
+
+    before.resize(counters.size());
+    decoded.resize(counters.size());
+    after.resize(counters.size());
+    overhead.resize(counters.size());
+    classTotals.resize(op_class_num, std::vector<uint64_t>(counters.size(), 0));
+    classSamples.resize(op_class_num, 0);
+}
+
+Nperf::~Nperf() {
+    for(auto& counter : counters) {
+        if(counter.fd >= 0) {
+            close(counter.fd);
+        }
+    }
+}
+
+void Nperf::start(void) {
+    for(auto& counter : counters) {
+        if(counter.fd >= 0) {
+            ioctl(counter.fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(counter.fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    if(byClass) {
+        calibrate();
+    }
+}
+
+void Nperf::stop(void) {
+    for(auto& counter : counters) {
+        if(counter.fd < 0) {
+            continue;
+        }
+
+        ioctl(counter.fd, PERF_EVENT_IOC_DISABLE, 0);
+
+        uint64_t data[3];   // value, time_enabled, time_running
+        if(read(counter.fd, data, sizeof(data)) != sizeof(data) || data[2] == 0) {
+            counter.value = 0;
+            continue;
+        }
+
+        counter.value = (uint64_t)((double)data[0] * data[1] / data[2]);
+    }
+}
+
+void Nperf::readAll(std::vector<uint64_t>& values) {
+    for(size_t i = 0; i < counters.size(); i ++) {
+        uint64_t data[3];
+        if(counters[i].fd >= 0 && read(counters[i].fd, data, sizeof(data)) == sizeof(data)) {
+            values[i] = data[0];
+        } else {
+            values[i] = 0;
+        }
+    }
+}
+
+// 读取计数器本身也会产生周期和指令，测出连续两次读取之间的最小差值作为每次采样需要扣除的开销
+void Nperf::calibrate(void) {
+    std::vector<uint64_t> first(counters.size()), second(counters.size());
+    for(size_t i = 0; i < counters.size(); i ++) {
+        overhead[i] = UINT64_MAX;
+    }
+
+    for(int round = 0; round < 64; round ++) {
+        readAll(first);
+        readAll(second);
+        for(size_t i = 0; i < counters.size(); i ++) {
+            overhead[i] = std::min(overhead[i], second[i] - first[i]);
+        }
+    }
+}
+
+void Nperf::accumulate(std::vector<uint64_t>& target, std::vector<uint64_t>& from, std::vector<uint64_t>& to) {
+    for(size_t i = 0; i < counters.size(); i ++) {
+        uint64_t delta = to[i] - from[i];
+        target[i] += (delta > overhead[i] ? delta - overhead[i] : 0);
+    }
+}
+
+void Nperf::sampleBegin(void) {
+    readAll(before);
+}
+
+void Nperf::sampleDecoded(void) {
+    readAll(decoded);
+}
+
+void Nperf::sampleEnd(int mnem) {
+    readAll(after);
+
+    OpClass opClass = classOf(mnem);
+    accumulate(classTotals[op_dispatch], before, decoded);
+    accumulate(classTotals[opClass], decoded, after);
+    classSamples[op_dispatch] ++;
+    classSamples[opClass] ++;
+}
+
+size_t Nperf::indexOf(const char* name) {
+    for(size_t i = 0; i < counters.size(); i ++) {
+        if(! strcmp(counters[i].name, name)) {
+            return i;
+        }
+    }
+
+    error(std::string("perf counter ") + name + " does not exist");
+    return 0;
+}
+
+uint64_t Nperf::find(const char* name) {
+    Counter& counter = counters[indexOf(name)];
+    return counter.fd >= 0 ? counter.value : 0;
+}
+
+void Nperf::report(std::ostream& output) {
+    char buffer[128];
+    output << "Nl perf stats:\n";
+    for(auto& counter : counters) {
+        if(counter.fd < 0) {
+            snprintf(buffer, sizeof(buffer), "  %-24s %20s\n", counter.name, "<not supported>");
+        } else {
+            snprintf(buffer, sizeof(buffer), "  %-24s %20llu\n", counter.name, (unsigned long long)counter.value);
+        }
+
+        output << buffer;
+    }
+
+    // 比值的分母为`0`（计数器不支持）时不输出
+    auto ratio = [&](const char* name, uint64_t numerator, uint64_t denominator, bool percent) {
+        if(denominator == 0) {
+            return;
+        }
+
+        double value = (double)numerator / denominator * (percent ? 100 : 1);
+        snprintf(buffer, sizeof(buffer), percent ? "  %-24s %19.2f%%\n" : "  %-24s %20.2f\n", name, value);
+        output << buffer;
+    };
+
+    ratio("IPC", find("instructions"), find("cycles"), false);
+    ratio("branch-miss rate", find("branch-misses"), find("branches"), true);
+    ratio("L1D miss rate", find("L1-dcache-load-misses"), find("L1-dcache-loads"), true);
+    ratio("LLC miss rate", find("LLC-misses"), find("LLC-references"), true);
+
+    if(! byClass) {
+        return;
+    }
+
+    // 各类别所占比例以周期计，没有硬件计数器时以`task-clock`计
+    size_t cycles = indexOf("cycles"), instructions = indexOf("instructions");
+    size_t branchMisses = indexOf("branch-misses"), llcMisses = indexOf("LLC-misses");
+    size_t base = (find("cycles") ? cycles : indexOf("task-clock"));
+    uint64_t total = 0;
+    for(int c = 0; c < op_class_num; c ++) {
+        total += classTotals[c][base];
+    }
+
+    snprintf(buffer, sizeof(buffer), "Nl perf stats by opcode class (1 in %zu instructions sampled, share of %s):\n",
+             samplePeriod, counters[base].name);
+    output << buffer;
+    snprintf(buffer, sizeof(buffer), "  %-12s %10s %8s %8s %14s %14s\n", "class", "samples", "share", "IPC", "br-miss/instr", "LLC-miss/instr");
+    output << buffer;
+    for(int c = 0; c < op_class_num; c ++) {
+        if(classSamples[c] == 0) {
+            continue;
+        }
+
+        std::vector<uint64_t>& totals = classTotals[c];
+        double share = total ? (double)totals[base] / total * 100 : 0;
+        double ipc = totals[cycles] ? (double)totals[instructions] / totals[cycles] : 0;
+        double branchMissRate = (double)totals[branchMisses] / classSamples[c];
+        double llcMissRate = (double)totals[llcMisses] / classSamples[c];
+        snprintf(buffer, sizeof(buffer), "  %-12s %10llu %7.2f%% %8.2f %14.4f %14.4f\n",
+                 opClassName[c], (unsigned long long)classSamples[c], share, ipc, branchMissRate, llcMissRate);
+        output << buffer;
+    }
+}
\ No newline at end of file
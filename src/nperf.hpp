@@ -0,0 +1,83 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 11:20:33
+ * @Description: 硬件性能计数器统计头文件
+ */
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <iostream>
+
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "global.hpp"
+#include "mnem_def.hpp"
+
+/*
+ * `Nperf`用法：
+ * 在`Nvm::execute`前后通过`perf_event_open`打开并读取周期、指令、分支未命中、L1/LLC未命中等计数器，结束时输出IPC及各未命中率
+ * 可选按指令类别统计：每隔`samplePeriod`条指令对一条指令在取指解码前、解码后、执行后各读一次计数器，
+ * 解码部分的差值计入`dispatch`，执行部分的差值计入该指令所属类别，从而判断程序的瓶颈在分派、访存还是外部函数
+ * 没有硬件计数器的环境（如部分虚拟机）中只统计软件计数器`task-clock`
+ */
+class Nperf {
+public:
+    static const size_t samplePeriod = 256;
+
+    Nperf(bool _byClass);
+    ~Nperf();
+
+    bool byClass;
+    void start(void);
+    void stop(void);
+
+    // 按指令类别统计时在每条被采样的指令的三个位置调用
+    void sampleBegin(void);
+    void sampleDecoded(void);
+    void sampleEnd(int mnem);
+
+    void report(std::ostream& output);
+
+private:
+    struct Counter {
+        const char* name;
+        uint32_t type;
+        uint64_t config;
+        int fd;
+        uint64_t value;     // 按复用时间比例缩放后的最终值
+    };
+
+    std::vector<Counter> counters;
+
+    // 指令类别，`dispatch`为取指及解码部分
+    enum OpClass {
+        op_dispatch = 0,
+        op_load_store,
+        op_arith,
+        op_control,
+        op_collection,
+        op_extern,
+        op_other,
+        op_class_num,
+    };
+
+    static const char* opClassName[op_class_num];
+    static OpClass classOf(int mnem);
+
+    std::vector<uint64_t> before, decoded, after, overhead;
+    std::vector<std::vector<uint64_t>> classTotals;    // classTotals[类别][计数器]
+    std::vector<uint64_t> classSamples;
+    void readAll(std::vector<uint64_t>& values);
+    void accumulate(std::vector<uint64_t>& target, std::vector<uint64_t>& from, std::vector<uint64_t>& to);
+    void calibrate(void);
+
+    size_t indexOf(const char* name);
+    uint64_t find(const char* name);    // 不支持时为`0`
+};
\ No newline at end of file
@@ -0,0 +1,111 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 21:59:40
+ * @Description: I/O事件循环，用`epoll`等待外部函数挂起的任务所等待的`fd`
+ */
+#include "npoll.hpp"
+
+Npoll::Npoll(std::function<void(Ntask*)> _ready) : ready(_ready) {
+    epollFD = epoll_create1(EPOLL_CLOEXEC);
+    if(epollFD < 0) {
+        error("epoll_create1: " + std::string(strerror(errno)));
+    }
+
+    wakeFD = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if(wakeFD < 0) {
+        close(epollFD);
+        error("eventfd: " + std::string(strerror(errno)));
+    }
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = wakeFD;
+    epoll_ctl(epollFD, EPOLL_CTL_ADD, wakeFD, &event);
+
+    os = std::thread([this]() { loop(); });
+}
+
+Npoll::~Npoll() {
+    uint64_t one = 1;
+    while(write(wakeFD, &one, sizeof(one)) < 0 && errno == EINTR) {}
+    os.join();
+    close(wakeFD);
+    close(epollFD);
+}
+
+void Npoll::wait(int fd, int events, Ntask* task) {
+    bool failed;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        Waiters& waiters = waiting[fd];
+        epoll_event event = {};
+        event.events = (waiters.events | events) | EPOLLONESHOT;
+        event.data.fd = fd;
+
+        // 已有等待者时合并事件并重新启用；`fd`关闭后被复用时旧的登记已自动删除，`MOD`失败后再`ADD`
+        int op = waiters.tasks.empty() ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+        failed = epoll_ctl(epollFD, op, fd, &event) != 0;
+        if(failed && op == EPOLL_CTL_ADD && errno == EEXIST) {
+            failed = epoll_ctl(epollFD, EPOLL_CTL_MOD, fd, &event) != 0;
+        } else if(failed && op == EPOLL_CTL_MOD && errno == ENOENT) {
+            failed = epoll_ctl(epollFD, EPOLL_CTL_ADD, fd, &event) != 0;
+        }
+
+        if(! failed) {
+            waiters.events |= events;
+            waiters.tasks.push_back(task);
+        } else if(waiters.tasks.empty()) {
+            waiting.erase(fd);
+        }
+    }
+
+    // 普通文件等不支持`epoll`（`EPERM`）时视为已就绪，外部函数重新调用时会得到结果或错误
+    if(failed) {
+        ready(task);
+    }
+}
+
+void Npoll::block(int fd, int events) {
+    pollfd target = {};
+    target.fd = fd;
+    target.events = events;
+    while(poll(&target, 1, - 1) < 0 && errno == EINTR) {}
+}
+
+void Npoll::loop(void) {
+    epoll_event events[64];
+    while(true) {
+        int n = epoll_wait(epollFD, events, 64, - 1);
+        if(n < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+
+            return;
+        }
+
+        for(int i = 0; i < n; i ++) {
+            int fd = events[i].data.fd;
+            if(fd == wakeFD) {
+                return;
+            }
+
+            std::vector<Ntask*> woken;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                auto waiters = waiting.find(fd);
+                if(waiters == waiting.end()) {
+                    continue;
+                }
+
+                woken.swap(waiters -> second.tasks);
+                waiting.erase(waiters);
+                epoll_ctl(epollFD, EPOLL_CTL_DEL, fd, nullptr);
+            }
+
+            for(auto task : woken) {
+                ready(task);
+            }
+        }
+    }
+}
\ No newline at end of file
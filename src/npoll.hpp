@@ -0,0 +1,55 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 21:58:12
+ * @Description: I/O事件循环头文件
+ */
+#pragma once
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "nl.hpp"
+#include "global.hpp"
+#include "nsched.hpp"
+
+/*
+ * `Npoll`用法（由`Nvm`在第一个任务因外部函数`nlWait`挂起时创建）：
+ * 一个系统线程在`epoll_wait`中等待所有挂起的任务所等待的`fd`，就绪后通过`ready`将等待该`fd`的任务全部交还调度器
+ * 每个`fd`以`EPOLLONESHOT`登记，唤醒后即删除，同一`fd`上的多个等待者合并登记的事件
+ * 不能用`epoll`等待的`fd`（如普通文件，总是就绪）直接交还调度器
+ */
+class Npoll {
+public:
+    Npoll(std::function<void(Ntask*)> _ready);
+    ~Npoll();   // 调用前所有任务都应已结束，不再有等待者
+
+    void wait(int fd, int events, Ntask* task);     // 登记后任务随时可能被唤醒，调用前必须保存好任务的状态
+    static void block(int fd, int events);  // 不是任务的线程用`poll`阻塞等待
+
+private:
+    struct Waiters {
+        int events = 0;
+        std::vector<Ntask*> tasks;
+    };
+
+    std::function<void(Ntask*)> ready;
+    int epollFD = - 1;
+    int wakeFD = - 1;   // 析构时写入以结束事件循环
+    std::thread os;
+
+    std::mutex lock;    // 保护`waiting`及对`epollFD`的修改
+    std::map<int, Waiters> waiting;
+
+    void loop(void);
+};
\ No newline at end of file
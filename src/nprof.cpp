@@ -0,0 +1,150 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 09:13:05
+ * @Description: nl采样分析器，基于`SIGPROF`低开销地统计虚拟机热点
+ */
+#include "nprof.hpp"
+
+Nprof::Sample Nprof::ring[Nprof::ringSize];
+std::atomic<size_t> Nprof::head(0), Nprof::tail(0);
+std::atomic<size_t> Nprof::dropped(0);
+Nprof::Cursor* Nprof::cursor = nullptr;
+
+Nprof::Nprof(Cursor* _cursor, int hz) {
+    if(cursor != nullptr) {
+        error("only one profiler can be running at the same time");
+    }
+
+    if(hz <= 0 || hz > 1000000) {
+        error("profile frequency must be between 1 and 1000000 Hz");
+    }
+
+    cursor = _cursor;
+    head = tail = dropped = 0;
+    stopCollector = false;
+
+    // 收集线程继承创建时的信号掩码，先屏蔽`SIGPROF`再创建线程，保证信号只会打断虚拟机所在线程
+    sigset_t set, oldSet;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPROF);
+    pthread_sigmask(SIG_BLOCK, &set, &oldSet);
+    collector = std::thread([this]() {
+        while(! stopCollector) {
+            drain();
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+    });
+    pthread_sigmask(SIG_SETMASK, &oldSet, NULL);
+    running = true;
+
+    // 设置失败时先停止收集线程，否则抛出异常后析构`std::thread`会直接终止进程
+    struct sigaction action = {};
+    action.sa_handler = handler;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if(sigaction(SIGPROF, &action, NULL) != 0) {
+        std::string reason = strerror(errno);
+        stop();
+        error("profiler sigaction error: " + reason);
+    }
+
+    // `tv_usec`必须小于`1000000`，`1Hz`时间隔为整一秒
+    struct itimerval timer = {};
+    timer.it_interval.tv_sec = 1 / hz;
+    timer.it_interval.tv_usec = 1000000 / hz % 1000000;
+    timer.it_value = timer.it_interval;
+    if(setitimer(ITIMER_PROF, &timer, NULL) != 0) {
+        std::string reason = strerror(errno);
+        stop();
+        error("profiler setitimer error: " + reason);
+    }
+}
+
+Nprof::~Nprof() {
+    stop();
+}
+
+// 信号处理函数中只能使用异步信号安全的操作，因此只做拷贝
+void Nprof::handler(int) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if(h - tail.load(std::memory_order_acquire) >= ringSize) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Sample& sample = ring[h & (ringSize - 1)];
+    sample.ip = cursor -> ip;
+    sample.depth = cursor -> depth;
+    if(sample.depth > maxDepth) {
+        sample.depth = maxDepth;
+    }
+
+    for(size_t i = 0; i < sample.depth; i ++) {
+        sample.chain[i] = cursor -> chain[i];
+    }
+
+    head.store(h + 1, std::memory_order_release);
+}
+
+void Nprof::drain(void) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t h = head.load(std::memory_order_acquire);
+    for(; t != h; t ++) {
+        Sample& sample = ring[t & (ringSize - 1)];
+        std::vector<size_t> stack(sample.chain, sample.chain + sample.depth);
+        stack.push_back(sample.ip);
+        counts[stack] ++;
+    }
+
+    tail.store(t, std::memory_order_release);
+}
+
+void Nprof::stop(void) {
+    if(! running) {
+        return;
+    }
+
+    struct itimerval timer = {};
+    setitimer(ITIMER_PROF, &timer, NULL);
+    signal(SIGPROF, SIG_IGN);
+
+    stopCollector = true;
+    collector.join();
+    drain();
+
+    cursor = nullptr;
+    running = false;
+}
+
+void Nprof::dump(std::string outputFileName, std::function<std::string(size_t)> symbolize) {
+    stop();
+
+    std::ofstream output(outputFileName, std::ios::out);
+    if(! output.is_open()) {
+        error(outputFileName + " open error");
+    }
+
+    // 不同偏移可能对应同一标签，所以先转为标签名再合并
+    // 返回地址指向`CALL`的下一条指令，减一后才落在调用者内部
+    std::map<std::string, size_t> folded;
+    for(auto count : counts) {
+        std::string line = "";
+        for(size_t i = 0; i < count.first.size(); i ++) {
+            bool isIP = (i == count.first.size() - 1);
+            line += symbolize(isIP ? count.first[i] : count.first[i] - 1);
+            if(! isIP) {
+                line += ';';
+            }
+        }
+
+        folded[line] += count.second;
+    }
+
+    for(auto line : folded) {
+        output << line.first << ' ' << line.second << '\n';
+    }
+
+    if(dropped) {
+        std::cerr << "Nl WARNING: profiler dropped " << dropped << " samples\n";
+    }
+}
\ No newline at end of file
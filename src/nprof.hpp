@@ -0,0 +1,68 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 09:12:40
+ * @Description: nl采样分析器头文件
+ */
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+
+#include <signal.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "global.hpp"
+
+/*
+ * `Nprof`用法：
+ * 通过`setitimer`定时发出`SIGPROF`信号，信号处理函数将虚拟机当前执行位置及调用链写入无锁环形缓冲区，
+ * 后台收集线程不断将缓冲区中的样本取出汇总，结束时将偏移转为标签名并以折叠栈格式（`flamegraph.pl`可直接读取）输出
+ * 信号处理函数中只能访问`Cursor`这样的简单数据，不能访问`Nlthread::stack`（`push_back`时`vector`可能正在扩容），所以调用链由虚拟机另外维护一份
+ */
+class Nprof {
+public:
+    static const size_t maxDepth = 64;  // 调用链超过该深度时只记录最外层的部分
+
+    // 虚拟机当前执行位置，由`Nvm`在执行时维护，信号处理函数只读不写
+    struct Cursor {
+        volatile size_t ip = 0;
+        volatile size_t depth = 0;
+        volatile size_t chain[maxDepth];    // 各栈帧的返回地址，虚拟机必须先写入`chain[depth]`再增加`depth`
+    };
+
+    Nprof(Cursor* cursor, int hz);
+    ~Nprof();
+
+    // 停止采样并将结果写入文件，`symbolize`用于将偏移转为标签名
+    void dump(std::string outputFileName, std::function<std::string(size_t)> symbolize);
+
+private:
+    struct Sample {
+        size_t ip;
+        size_t depth;
+        size_t chain[maxDepth];
+    };
+
+    // 单生产者（信号处理函数）单消费者（收集线程）环形缓冲区，容量必须为2的幂
+    static const size_t ringSize = 1024;
+    static Sample ring[ringSize];
+    static std::atomic<size_t> head, tail;
+    static std::atomic<size_t> dropped;     // 缓冲区满时丢弃的样本数
+    static Cursor* cursor;
+    static void handler(int signal);
+
+    bool running = false;
+    std::atomic<bool> stopCollector;
+    std::thread collector;
+    std::map<std::vector<size_t>, size_t> counts;  // 原始调用链（偏移）到样本数的映射，输出时再转为标签名
+    void drain(void);
+    void stop(void);
+};
\ No newline at end of file
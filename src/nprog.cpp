@@ -0,0 +1,503 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 21:25:02
+ * @Description: 已加载程序，读取nlc文件（或程序镜像）并由多个隔离区共用
+ */
+#include "nprog.hpp"
+
+Nprog::Nprog(std::string inputFileName, std::string _imageCache, bool _escapeAnalysis) : imageCache(_imageCache), escapeAnalysis(_escapeAnalysis) {
+    loadFile(inputFileName);
+
+    // `calloc`较大的内存时直接得到未访问过的零页，不会因为常量池很大而增加启动时间和内存
+    // 全零即为空指针，`std::atomic<std::string*>`与`std::string*`布局相同
+    stringCache = (std::atomic<std::string*>*)calloc(stringNum, sizeof(std::atomic<std::string*>));
+    if(! stringCache && stringNum) {
+        error("out of memory");
+    }
+}
+
+Nprog::~Nprog() {
+    free(stringCache);
+}
+
+// 操作名等常量字符串不存在时当作空字符串，执行到时再报错
+void Nprog::analyze(void) {
+    if(! escapeAnalysis) {
+        return;
+    }
+
+    Nesc esc(code, version, codeBegin, codeEnd, [this](size_t id) {
+        return id < stringNum ? stringView(id) : std::string_view();
+    });
+
+    localSites = std::move(esc.localSites);
+    borrowSites = std::move(esc.borrowSites);
+}
+
+void Nprog::loadFile(std::string inputFileName) {
+    // 镜像及快照都通过原文件的身份判断是否过期
+    if(stat(inputFileName.c_str(), &source) != 0) {
+        error(inputFileName + " open error");
+    }
+
+    std::string imageFileName = "";
+    if(imageCache != "") {
+        imageFileName = imagePath(inputFileName);
+        if(loadImage(imageFileName, inputFileName)) {
+            return;
+        }
+    }
+
+    // 只映射不读取，启动时只会访问文件头、段表等少数几页，常量池和代码段在执行到时才被读入
+    file.reset(new Nmap(inputFileName, MADV_NORMAL));
+    image = file -> view();
+    code = image.data();
+
+    // 两个版本的魔数都位于文件开头
+    int magic = 0;
+    if(image.size() >= sizeof(magic)) {
+        memcpy(&magic, image.data(), sizeof(magic));
+    }
+
+    if(magic == NlcFile::magicNum) {
+        version = 1;
+        loadV1(inputFileName);
+    } else if(magic == NlcFile::magicNumV2) {
+        loadV2(inputFileName);
+    } else {
+        error("file corruption");
+    }
+
+    analyze();
+    if(imageFileName != "") {
+        saveImage(imageFileName);
+    }
+}
+
+void Nprog::loadV1(std::string inputFileName) {
+    /* 1. file header */
+    NlcFile::FileHeader fileHeader;
+    if(image.size() < sizeof(fileHeader)) {
+        error("file corruption");
+    }
+
+    memcpy(&fileHeader, image.data(), sizeof(fileHeader));
+    size_t position = sizeof(fileHeader);
+
+    /* 2. numbers */
+    if(fileHeader.numNum > (image.size() - position) / sizeof(NlcFile::Num)) {
+        error("file corruption");
+    }
+
+    // v1的数字紧跟在24字节的文件头之后，不满足`long double`的16字节对齐，只能拷贝出来
+    numCopy.resize(fileHeader.numNum);
+    memcpy(numCopy.data(), &image[position], fileHeader.numNum * sizeof(NlcFile::Num));
+    numTable = numCopy.data();
+    numNum = fileHeader.numNum;
+    position += fileHeader.numNum * sizeof(NlcFile::Num);
+
+    /* strings */
+    // v1的字符串以长度为前缀依次排列，只能扫描一遍记下各字符串的位置，但不拷贝内容
+    for(size_t i = 0; i < fileHeader.strNum; i ++) {
+        int stringLength;
+        if(image.size() - position < sizeof(stringLength)) {
+            error("file corruption");
+        }
+
+        memcpy(&stringLength, &image[position], sizeof(stringLength));
+        position += sizeof(stringLength);
+        if(stringLength < 0 || (size_t)stringLength > image.size() - position) {
+            error("file corruption");
+        }
+
+        stringViews.push_back(image.substr(position, stringLength));
+        position += stringLength;
+    }
+
+    stringNum = fileHeader.strNum;
+
+    /* 5. debug */
+    // 通过文件末尾的`DebugTrailer`判断是否有调试段，有则代码段在调试段之前结束
+    codeBegin = position;
+    codeEnd = image.size();
+
+    NlcFile::DebugTrailer trailer;
+    if(codeEnd - codeBegin >= sizeof(trailer)) {
+        memcpy(&trailer, &image[codeEnd - sizeof(trailer)], sizeof(trailer));
+        if(trailer.magic == NlcFile::debugMagicNum && trailer.size + sizeof(trailer) <= codeEnd - codeBegin) {
+            codeEnd -= sizeof(trailer) + trailer.size;
+            debugBegin = codeEnd;
+            debugTrailer = trailer;
+            debug = Ndbg(inputFileName, debugBegin, debugTrailer);
+        }
+    }
+}
+
+void Nprog::loadV2(std::string inputFileName) {
+    NlcFile::FileHeaderV2 fileHeader;
+    if(image.size() < sizeof(fileHeader)) {
+        error("file corruption");
+    }
+
+    memcpy(&fileHeader, image.data(), sizeof(fileHeader));
+    version = fileHeader.version;
+    if(version != 2) {
+        error("unsupported nlc version " + std::to_string(version));
+    }
+
+    if(fileHeader.sectionNum > (image.size() - sizeof(fileHeader)) / sizeof(NlcFile::Section)) {
+        error("file corruption");
+    }
+
+    // 按种类取出各段，未知种类的段直接跳过以便之后添加新的段
+    NlcFile::Section sections[NlcFile::sec_debug + 1] = {};
+    for(uint32_t i = 0; i < fileHeader.sectionNum; i ++) {
+        NlcFile::Section section;
+        memcpy(&section, &image[sizeof(fileHeader) + i * sizeof(section)], sizeof(section));
+        if(section.offset > image.size() || section.size > image.size() - section.offset) {
+            error("file corruption");
+        }
+
+        if(section.kind <= NlcFile::sec_debug) {
+            sections[section.kind] = section;
+        }
+    }
+
+    /* numbers */
+    // 映射按页对齐，段按16字节对齐，数字可以直接在映射中按数组访问
+    NlcFile::Section& nums = sections[NlcFile::sec_nums];
+    numNum = nums.size / sizeof(NlcFile::Num);
+    if(nums.offset % alignof(NlcFile::Num) == 0) {
+        numTable = (const NlcFile::Num*)&image[nums.offset];
+    } else {
+        numCopy.resize(numNum);
+        memcpy(numCopy.data(), &image[nums.offset], numNum * sizeof(NlcFile::Num));
+        numTable = numCopy.data();
+    }
+
+    /* strings */
+    loadStrings(sections[NlcFile::sec_strings].offset, sections[NlcFile::sec_strings].size);
+
+    /* code */
+    codeBegin = sections[NlcFile::sec_code].offset;
+    codeEnd = codeBegin + sections[NlcFile::sec_code].size;
+
+    /* debug */
+    NlcFile::Section& debugSection = sections[NlcFile::sec_debug];
+    NlcFile::DebugTrailer trailer;
+    if(debugSection.size >= sizeof(trailer)) {
+        memcpy(&trailer, &image[debugSection.offset + debugSection.size - sizeof(trailer)], sizeof(trailer));
+        if(trailer.magic == NlcFile::debugMagicNum && trailer.size + sizeof(trailer) == debugSection.size) {
+            debugBegin = debugSection.offset;
+            debugTrailer = trailer;
+            debug = Ndbg(inputFileName, debugBegin, debugTrailer);
+        }
+    }
+}
+
+// 只记下偏移表和字符串内容的位置，每个字符串的范围在用到时才从偏移表中读出并检查
+void Nprog::loadStrings(size_t offset, size_t size) {
+    if(! size) {
+        return;
+    }
+
+    uint32_t count;
+    if(size < sizeof(count)) {
+        error("file corruption");
+    }
+
+    memcpy(&count, &image[offset], sizeof(count));
+    if(count >= (size - sizeof(count)) / sizeof(uint32_t)) {
+        error("file corruption");
+    }
+
+    stringNum = count;
+    stringOffsets = offset + sizeof(count);
+    size_t bytesBegin = stringOffsets + (count + 1) * sizeof(uint32_t);
+    stringBytes = image.substr(bytesBegin, offset + size - bytesBegin);
+}
+
+void Nprog::stampSource(NlcFile::SourceStamp& stamp) {
+    stamp.size = source.st_size;
+    stamp.mtime = (uint64_t)source.st_mtim.tv_sec * 1000000000 + source.st_mtim.tv_nsec;
+    stamp.ino = source.st_ino;
+    stamp.dev = source.st_dev;
+}
+
+bool Nprog::matchesSource(const NlcFile::SourceStamp& stamp) {
+    NlcFile::SourceStamp current;
+    stampSource(current);
+    return current.size == stamp.size && current.mtime == stamp.mtime && current.ino == stamp.ino && current.dev == stamp.dev;
+}
+
+// 镜像文件名由原文件的文件名及其绝对路径的哈希组成，不同目录下的同名程序不会共用镜像
+std::string Nprog::imagePath(std::string inputFileName) {
+    char* real = realpath(inputFileName.c_str(), NULL);
+    std::string absolute = real ? real : inputFileName;
+    free(real);
+
+    size_t slash = absolute.find_last_of('/');
+    std::string name = (slash == std::string::npos ? absolute : absolute.substr(slash + 1));
+
+    char hash[32];
+    snprintf(hash, sizeof(hash), "%016zx", std::hash<std::string>()(absolute));
+    return imageCache + "/" + name + "." + hash + ".nlimg";
+}
+
+bool Nprog::loadImage(std::string imageFileName, std::string inputFileName) {
+    struct stat st;
+    if(stat(imageFileName.c_str(), &st) != 0 || (size_t)st.st_size < sizeof(NlcFile::ImageHeader)) {
+        return false;
+    }
+
+    std::unique_ptr<Nmap> mapped(new Nmap(imageFileName, MADV_NORMAL, true));
+    NlcFile::ImageHeader header;
+    memcpy(&header, mapped -> data(), sizeof(header));
+    if(header.magic != NlcFile::imageMagicNum || header.imageSize != mapped -> size() || ! matchesSource(header.source)) {
+        return false;
+    }
+
+    // 镜像由虚拟机自己生成，这里只检查各部分没有超出镜像，防止读到映射之外
+    size_t size = mapped -> size();
+    if((header.version != 1 && header.version != 2)
+    || header.numOffset % alignof(NlcFile::Num) || header.numOffset > size
+    || header.numNum > (size - header.numOffset) / sizeof(NlcFile::Num)
+    || header.stringOffset > size || header.stringSize > size - header.stringOffset
+    || header.codeOffset > size || header.codeSize > size - header.codeOffset
+    || header.localOffset % sizeof(uint64_t) || header.localOffset > size
+    || header.localWords > (size - header.localOffset) / sizeof(uint64_t) / 2) {
+        error(imageFileName + " image corruption");
+    }
+
+    file = std::move(mapped);
+    image = file -> view();
+    version = header.version;
+    numTable = (const NlcFile::Num*)&image[header.numOffset];
+    numNum = header.numNum;
+    loadStrings(header.stringOffset, header.stringSize);
+
+    // 代码仍按原文件中的偏移寻址，所以取指的基址要减去代码段在原文件中的偏移
+    codeBegin = header.codeBegin;
+    codeEnd = codeBegin + header.codeSize;
+    code = image.data() + header.codeOffset - header.codeBegin;
+
+    if(header.debugTrailer.magic == NlcFile::debugMagicNum) {
+        debugBegin = header.debugBegin;
+        debugTrailer = header.debugTrailer;
+        debug = Ndbg(inputFileName, debugBegin, debugTrailer);
+    }
+
+    // 生成镜像时没有做逃逸分析（`--no-escape-analysis`）则现在分析，镜像不会因此重新生成
+    if(! escapeAnalysis) {
+        return true;
+    }
+
+    if(header.localOffset) {
+        const uint64_t* words = (const uint64_t*)&image[header.localOffset];
+        localSites.assign(words, words + header.localWords);
+        borrowSites.assign(words + header.localWords, words + header.localWords * 2);
+    } else {
+        analyze();
+    }
+
+    return true;
+}
+
+// 先写入临时文件再改名，同时启动的多个进程不会读到写了一半的镜像；缓存目录不可写时只是不生成镜像
+void Nprog::saveImage(std::string imageFileName) {
+    NlcFile::ImageHeader header = {};
+    header.version = version;
+    stampSource(header.source);
+
+    std::string out((char*)&header, sizeof(header));
+    auto align = [&](size_t alignment) {
+        out.append((alignment - out.size() % alignment) % alignment, '\0');
+    };
+
+    /* numbers */
+    align(alignof(NlcFile::Num));
+    header.numOffset = out.size();
+    header.numNum = numNum;
+    out.append((const char*)numTable, numNum * sizeof(NlcFile::Num));
+
+    /* strings */
+    align(sizeof(uint32_t));
+    header.stringOffset = out.size();
+    uint32_t count = stringNum, offset = 0;
+    out.append((char*)&count, sizeof(count));
+    for(size_t i = 0; i < stringNum; i ++) {
+        out.append((char*)&offset, sizeof(offset));
+        offset += stringView(i).length();
+    }
+
+    out.append((char*)&offset, sizeof(offset));
+    for(size_t i = 0; i < stringNum; i ++) {
+        std::string_view view = stringView(i);
+        out.append(view.data(), view.length());
+    }
+
+    header.stringSize = out.size() - header.stringOffset;
+
+    /* code */
+    align(16);
+    header.codeOffset = out.size();
+    header.codeBegin = codeBegin;
+    header.codeSize = codeEnd - codeBegin;
+    out.append(code + codeBegin, codeEnd - codeBegin);
+
+    /* locals */
+    if(escapeAnalysis) {
+        align(sizeof(uint64_t));
+        header.localOffset = out.size();
+        header.localWords = localSites.size();
+        out.append((const char*)localSites.data(), localSites.size() * sizeof(uint64_t));
+        out.append((const char*)borrowSites.data(), borrowSites.size() * sizeof(uint64_t));
+    }
+
+    header.debugBegin = debugBegin;
+    header.debugTrailer = debugTrailer;
+    header.imageSize = out.size();
+    memcpy(&out[0], &header, sizeof(header));
+
+    std::string temporary = imageFileName + "." + std::to_string(getpid()) + ".tmp";
+    std::ofstream output(temporary, std::ios::binary | std::ios::out);
+    if(! output.is_open()) {
+        return;
+    }
+
+    output.write(out.data(), out.size());
+    output.close();
+    if(! output || rename(temporary.c_str(), imageFileName.c_str()) != 0) {
+        unlink(temporary.c_str());
+    }
+}
+
+std::string_view Nprog::stringView(size_t id) {
+    if(id >= stringNum) {
+        error("string constant " + std::to_string(id) + " does not exist");
+    }
+
+    if(! stringViews.empty()) {
+        return stringViews[id];
+    }
+
+    uint32_t range[2];
+    memcpy(range, &image[stringOffsets + id * sizeof(uint32_t)], sizeof(range));
+    if(range[0] > range[1] || range[1] > stringBytes.size()) {
+        error("file corruption");
+    }
+
+    return stringBytes.substr(range[0], range[1] - range[0]);
+}
+
+// `NlObject`和外部函数通过`std::string*`访问字符串，所以常量字符串在第一次被加载到栈上时才拷贝出来，之后都使用同一份
+// 已拷贝过的常量只需一次`acquire`读取，第一次拷贝时加锁并再检查一次，避免两个线程各拷贝一份
+std::string* Nprog::string(size_t id, Nmem& mem) {
+    if(id < stringNum) {
+        std::string* cached = stringCache[id].load(std::memory_order_acquire);
+        if(cached) {
+            return cached;
+        }
+    }
+
+    std::string_view view = stringView(id);
+    std::lock_guard<std::mutex> lock(stringMutex);
+    std::string* cached = stringCache[id].load(std::memory_order_relaxed);
+    if(cached) {
+        return cached;
+    }
+
+    materialized.emplace_back(view);
+    mem.record(Nmem::mem_string, sizeof(std::string) + materialized.back().capacity());
+    stringCache[id].store(&materialized.back(), std::memory_order_release);
+    return &materialized.back();
+}
+
+bool Nprog::find(std::string label, size_t& addr) {
+    std::lock_guard<std::mutex> lock(debugMutex);
+    return debug.find(label, addr);
+}
+
+std::string Nprog::describe(size_t offset) {
+    std::lock_guard<std::mutex> lock(debugMutex);
+    return debug.describe(offset);
+}
+
+std::string Nprog::symbolize(size_t offset) {
+    std::lock_guard<std::mutex> lock(debugMutex);
+    return debug.symbolize(offset);
+}
+
+// 在已导入的共享库中按函数名及地址查找，用于快照记录外部函数的来源
+std::string Nprog::moduleOf(std::string name, void* externFN) {
+    std::lock_guard<std::mutex> lock(moduleMutex);
+    for(auto& module : modules) {
+        for(auto& entry : module.second) {
+            if(entry.first == name && entry.second == externFN) {
+                return module.first;
+            }
+        }
+    }
+
+    return "";
+}
+
+// 首先获取`driver`函数，通过调用其返回的列表得到外部共享库提供的所有外部函数名，再一一通过函数名找到对应函数
+// 出错时不记录，之后再`IMPORT`该文件时重新尝试
+const Nprog::Module& Nprog::import(std::string soFileName) {
+    std::lock_guard<std::mutex> lock(moduleMutex);
+    auto loaded = modules.find(soFileName);
+    if(loaded != modules.end()) {
+        return loaded -> second;
+    }
+
+    const Module* builtin = Nmod::find(soFileName);
+    if(builtin) {
+        borrowing.insert(soFileName);
+        return modules[soFileName] = *builtin;
+    }
+
+    Module module;
+    #if(defined __linux__)
+        void* handler = dlopen(soFileName.c_str(), RTLD_LAZY);  // 需要时再加载
+        if(! handler) {
+            error("IMPORT: " + std::string(dlerror()));  // 使用`dlerror`获取详细报错信息
+        }
+
+        // 布局不同的`list`、`map`一经使用就会破坏内存，所以在调用任何外部函数之前检查
+        const int* abiVersion = (const int*)dlsym(handler, "nl_abi_version");
+        if(abiVersion == NULL || *abiVersion != NL_ABI_VERSION) {
+            error("IMPORT: " + soFileName + " was built against an incompatible nl.hpp (nl ABI version "
+                  + (abiVersion ? std::to_string(*abiVersion) : std::string("1")) + ", expected "
+                  + std::to_string(NL_ABI_VERSION) + "), rebuild it with NL_EXPORT_ABI_VERSION");
+        }
+
+        const int* borrowsArgs = (const int*)dlsym(handler, "nl_borrows_args");
+        if(borrowsArgs && *borrowsArgs) {
+            borrowing.insert(soFileName);
+        }
+
+        void* driver = dlsym(handler, "driver");
+        if(driver == NULL) {
+            error("IMPORT: driver: " + std::string(dlerror()));
+        }
+
+        std::vector<std::string> externFNNameTable = *(((NlEDTemplate)driver)());
+        for(auto externFNName : externFNNameTable) {
+            void* externFN = dlsym(handler, externFNName.c_str());
+            if(externFN == NULL) {
+                error("IMPORT: " + std::string(dlerror()));
+            }
+
+            module.push_back({ externFNName, externFN });
+        }
+    #elif(defined _WIN32 || defined _WIN64)
+    #endif
+
+    return modules[soFileName] = module;
+}
+
+bool Nprog::borrows(std::string soFileName) {
+    std::lock_guard<std::mutex> lock(moduleMutex);
+    return borrowing.count(soFileName);
+}
\ No newline at end of file
@@ -0,0 +1,123 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 21:24:37
+ * @Description: 已加载程序头文件
+ */
+#pragma once
+#include <map>
+#include <set>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+
+#include "nl.hpp"
+#include "sdt.hpp"
+#include "ndbg.hpp"
+#include "nmap.hpp"
+#include "nmem.hpp"
+#include "nmod.hpp"
+#include "nesc.hpp"
+#include "global.hpp"
+#include "nlc_def.hpp"
+
+// 不同平台访问共享文件的`API`不同（现仅支持`Windows`和`Linux`两个系统）
+#if(defined __linux__)
+    #include <dlfcn.h>
+    #include <sys/stat.h>
+#elif(defined _WIN32 || defined _WIN64)
+#endif
+
+/*
+ * `Nprog`用法：
+ * 加载后只读的程序（文件映射或程序镜像、数字及字符串常量、代码段、调试段）以及已导入的共享库，由多个`Nvm`（隔离区）通过`std::shared_ptr`共用
+ * 每个隔离区有各自的全局变量、`Nmem`、`SPAWN`的线程及`TASK`的调度器，可以在不同的系统线程中同时执行
+ *
+ * std::shared_ptr<Nprog> prog(new Nprog("handler.nlc"));
+ * Nvm a(prog), b(prog);   // 只加载一次
+ *
+ * 常量字符串第一次加载时才拷贝出来，之后所有隔离区都使用同一份，拷贝所占的内存计入第一次加载它的隔离区的`Nmem`
+ * 共享库每个程序只`dlopen`并解析一次，之后`IMPORT`同一个文件时直接取得外部函数表，内置模块（见`Nmod`）不需要`dlopen`
+ * 加载时对整个代码段做一次逃逸分析（见`Nesc`），需要读取整个代码段；使用程序镜像缓存时结果保存在镜像中，只在生成镜像时分析
+ */
+class Nprog {
+public:
+    Nprog(std::string inputFileName, std::string imageCache = "", bool escapeAnalysis = true);   // 见`NvmOption`，出错时抛出`NlError`
+    ~Nprog();
+
+    Nprog(const Nprog&) = delete;
+    Nprog& operator=(const Nprog&) = delete;
+
+    // 加载后不再改变，`Nvm`构造时拷贝一份以免执行时多一次间接访问
+    const char* code;   // 取指的基址，`code[pc]`为文件偏移`pc`处的字节，使用镜像时与映射的起始位置不同
+    uint32_t version;   // nlc格式版本，决定操作数的编码方式
+    const NlcFile::Num* numTable = nullptr;    // v2中直接指向映射中的数字段
+    size_t numNum = 0;
+    size_t stringNum = 0;
+    std::atomic<std::string*>* stringCache = nullptr;    // 已拷贝出的字符串，按编号索引，多个线程可能同时加载同一个常量
+    size_t codeBegin;
+    size_t codeEnd;     // 代码段结束位置，其后可能为调试段
+    std::vector<uint64_t> localSites;   // 逃逸分析的结果，见`Nesc::localSites`，不分析时为空
+    std::vector<uint64_t> borrowSites;  // 见`Nesc::borrowSites`，与`localSites`等长
+    struct stat source;     // 原文件的身份（大小、修改时间等）
+
+    // 程序镜像及堆快照都依赖原文件，生成时记录原文件的身份，使用前核对
+    void stampSource(NlcFile::SourceStamp& stamp);
+    bool matchesSource(const NlcFile::SourceStamp& stamp);
+
+    std::string_view stringView(size_t id);
+    std::string* string(size_t id, Nmem& mem);     // `stringCache`中没有时拷贝出来并计入`mem`
+
+    bool find(std::string label, size_t& addr);     // 通过调试段查找标签
+    std::string describe(size_t offset);
+    std::string symbolize(size_t offset);
+
+    // 共享库提供的外部函数，按`driver`返回的顺序排列
+    typedef Nmod::Module Module;
+    const Module& import(std::string soFileName);   // 先查找同名的内置模块
+    bool borrows(std::string soFileName);   // 已导入的模块是否声明了`NL_EXPORT_BORROWS_ARGS`，内置模块都借用参数
+    std::string moduleOf(std::string name, void* externFN);    // 导入该外部函数的共享库文件名，不是从共享库导入的返回空字符串
+
+private:
+    std::string imageCache;
+    bool escapeAnalysis;
+    void analyze(void);     // 逃逸分析，结果存入`localSites`
+
+    /************ Load File（加载文件）部分 ************/
+    std::unique_ptr<Nmap> file;
+    std::string_view image;     // 整个文件（或程序镜像）的只读映射
+    std::vector<NlcFile::Num> numCopy;  // 数字段未对齐（v1）时的拷贝
+
+    // 常量字符串：直接加载v1文件时记录各字符串在映射中的位置，其余情况在用到时才查偏移表
+    std::vector<std::string_view> stringViews;
+    size_t stringOffsets = 0;   // 偏移表在映射中的偏移
+    std::string_view stringBytes;   // 所有字符串的内容
+    void loadStrings(size_t offset, size_t size);   // 读取v2格式的字符串段
+    std::mutex stringMutex;     // 保护`materialized`
+    std::deque<std::string> materialized;   // `deque`扩容时不移动已有元素，指针不会失效
+
+    Ndbg debug;     // 只记录调试段位置，需要时才读取
+    std::mutex debugMutex;  // `Ndbg`第一次使用时才读取调试段，多个线程可能同时报错
+    size_t debugBegin = 0;
+    NlcFile::DebugTrailer debugTrailer = { .labelNum = 0, .lineNum = 0, .size = 0, .magic = 0 };    // 没有调试段时`magic`为`0`
+    void loadFile(std::string inputFileName);
+    void loadV1(std::string inputFileName);
+    void loadV2(std::string inputFileName);
+
+    // 程序镜像缓存
+    std::string imagePath(std::string inputFileName);
+    bool loadImage(std::string imageFileName, std::string inputFileName);   // 镜像不存在或已过期时返回`false`
+    void saveImage(std::string imageFileName);
+
+    std::mutex moduleMutex;
+    std::map<std::string, Module> modules;  // 共享库文件名 -> 外部函数
+    std::set<std::string> borrowing;    // 其中借用参数的模块
+};
\ No newline at end of file
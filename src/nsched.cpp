@@ -0,0 +1,290 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 20:06:18
+ * @Description: 任务调度器，工作线程各有一个Chase-Lev双端队列，空闲时从其他工作线程窃取任务
+ */
+#include "nsched.hpp"
+
+thread_local Ntask* Nsched::current = nullptr;
+thread_local Nsched::Worker* Nsched::self = nullptr;
+
+Nsched::Deque::Deque(void) {
+    arrays.emplace_back(new Array(64));
+    array.store(arrays.back().get(), std::memory_order_relaxed);
+}
+
+void Nsched::Deque::push(Ntask* task) {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    Array* a = array.load(std::memory_order_relaxed);
+    if(b - t > a -> capacity - 1) {
+        Array* grown = new Array(a -> capacity * 2);
+        for(int64_t i = t; i < b; i ++) {
+            grown -> put(i, a -> get(i));
+        }
+
+        arrays.emplace_back(grown);
+        array.store(grown, std::memory_order_release);
+        a = grown;
+    }
+
+    a -> put(b, task);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+Ntask* Nsched::Deque::pop(void) {
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    Array* a = array.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if(t > b) {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Ntask* task = a -> get(b);
+    if(t == b) {
+        // 只剩最后一个时与窃取者竞争
+        if(! top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            task = nullptr;
+        }
+
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    return task;
+}
+
+Ntask* Nsched::Deque::steal(void) {
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    if(t >= b) {
+        return nullptr;
+    }
+
+    Array* a = array.load(std::memory_order_acquire);
+    Ntask* task = a -> get(t);
+    if(! top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;
+    }
+
+    return task;
+}
+
+bool Nsched::Deque::empty(void) {
+    return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+}
+
+Nsched::Nsched(size_t workerNum, std::function<bool(Ntask*)> _resume) : resume(_resume) {
+    if(workerNum == 0) {
+        workerNum = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // 先建好所有队列再启动线程，窃取时遍历`workers`不需要加锁
+    for(size_t i = 0; i < workerNum; i ++) {
+        workers.emplace_back(new Worker());
+        workers.back() -> owner = this;
+    }
+
+    for(size_t i = 0; i < workerNum; i ++) {
+        workers[i] -> os = std::thread([this, i]() { loop(i); });
+    }
+}
+
+Nsched::~Nsched() {
+    {
+        std::unique_lock<std::mutex> lock(idleMutex);
+        drained.wait(lock, [this]() { return live.load() == 0 || blocked(); });
+        stopping.store(true);
+        idle.notify_all();
+    }
+
+    for(auto& worker : workers) {
+        worker -> os.join();
+    }
+}
+
+void Nsched::spawn(Ntask* task) {
+    live.fetch_add(1);
+    submit(task);
+}
+
+// 不是工作线程提交时（如`Npoll`的事件循环），任务可能在`wake`返回前就已结束，先计入`live`，析构不会在返回前开始
+void Nsched::submit(Ntask* task) {
+    if(self && self -> owner == this) {
+        self -> deque.push(task);
+        wake();
+        return;
+    }
+
+    live.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(injectMutex);
+        injected.push_back(task);
+    }
+
+    wake();
+    leave();
+}
+
+void Nsched::waitExternal(void) {
+    external.fetch_add(1);
+}
+
+// 先提交再减少计数，`blocked`不会在两者之间误认为没有任务可以再被唤醒；工作线程可能已在减少前睡眠，所以减为`0`时通知析构
+void Nsched::submitExternal(Ntask* task) {
+    submit(task);
+    if(external.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        drained.notify_all();
+    }
+}
+
+void Nsched::yield(Ntask* task) {
+    {
+        std::lock_guard<std::mutex> lock(injectMutex);
+        injected.push_back(task);
+    }
+
+    wake();
+}
+
+// 与`loop`中登记睡眠后的屏障配对：要么这里看到`sleeping`，要么睡眠前的`hasWork`看到刚提交的任务
+void Nsched::wake(void) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(sleeping.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        idle.notify_one();
+    }
+}
+
+// 先取自己的队列，再取注入队列，最后从随机的工作线程开始依次窃取
+Ntask* Nsched::take(size_t index, uint64_t& seed) {
+    Ntask* task = workers[index] -> deque.pop();
+    if(task) {
+        return task;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(injectMutex);
+        if(! injected.empty()) {
+            task = injected.front();
+            injected.pop_front();
+            return task;
+        }
+    }
+
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    size_t start = seed % workers.size();
+    for(size_t i = 0; i < workers.size(); i ++) {
+        size_t victim = (start + i) % workers.size();
+        if(victim != index && (task = workers[victim] -> deque.steal())) {
+            return task;
+        }
+    }
+
+    return nullptr;
+}
+
+bool Nsched::hasWork(void) {
+    {
+        std::lock_guard<std::mutex> lock(injectMutex);
+        if(! injected.empty()) {
+            return true;
+        }
+    }
+
+    for(auto& worker : workers) {
+        if(! worker -> deque.empty()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// 所有工作线程都在睡眠（没有任务在执行）、没有待执行的任务且没有任务在等待外部事件时，剩下的任务都在等待通道或其他任务，
+// 唤醒它们的只能是其他任务，所以再也不会被唤醒
+bool Nsched::blocked(void) {
+    return sleeping.load() == workers.size() && external.load() == 0 && ! hasWork();
+}
+
+void Nsched::loop(size_t index) {
+    self = workers[index].get();
+    uint64_t seed = index * 0x9e3779b97f4a7c15 + 1;
+    size_t idleRounds = 0;
+    while(true) {
+        Ntask* task = take(index, seed);
+        if(task) {
+            idleRounds = 0;
+            current = task;
+            bool finished = resume(task);
+            current = nullptr;
+            if(finished) {
+                finish(task);
+            }
+
+            continue;
+        }
+
+        if(stopping.load()) {
+            return;
+        }
+
+        if(++ idleRounds < spinRounds) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // 登记为睡眠后再检查一次，之后提交的任务必然看到登记，`wake`要取得锁才能通知，所以不会在开始等待之前通知
+        std::unique_lock<std::mutex> lock(idleMutex);
+        sleeping.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(! stopping.load() && ! hasWork()) {
+            if(sleeping.load() == workers.size()) {
+                drained.notify_all();   // 析构时检查是否所有任务都已阻塞
+            }
+
+            idle.wait(lock);
+        }
+
+        sleeping.fetch_sub(1);
+        idleRounds = 0;
+    }
+}
+
+// 必须在持有锁时通知并读出所需的成员，`AWAIT`的线程被唤醒后会立即释放任务
+void Nsched::finish(Ntask* task) {
+    Ntask* waiter;
+    bool detached;
+    {
+        std::lock_guard<std::mutex> lock(task -> lock);
+        task -> done = true;
+        waiter = task -> waiter;
+        detached = task -> detached;
+        task -> finished.notify_all();
+    }
+
+    if(waiter) {
+        submit(waiter);
+    }
+
+    if(detached) {
+        delete task;
+    }
+
+    leave();
+}
+
+void Nsched::leave(void) {
+    if(live.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        drained.notify_all();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,118 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 20:05:42
+ * @Description: 任务调度器头文件
+ */
+#pragma once
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+#include "nl.hpp"
+#include "global.hpp"
+
+// `TASK`创建的任务，由`Nsched`调度到工作线程上执行，挂起后从`pc`继续
+struct Ntask {
+    Nlthread thread;
+    size_t pc = 0;  // 下次从这里继续执行
+    NlObject result;
+    std::string err = "";   // 不为空时任务因出错结束
+    const Nlthread* awaitedBy = nullptr;    // 正在`AWAIT`该任务的线程，一个任务只能被`AWAIT`一次
+
+    std::mutex lock;    // 保护以下成员
+    std::condition_variable finished;   // 不是任务的线程`AWAIT`时在此等待
+    bool done = false;
+    Ntask* waiter = nullptr;    // 挂起等待该任务结束的任务，结束时重新提交
+
+    std::function<void(Ntask*)> body = nullptr;     // 不为空时执行它而不是字节码，不会挂起
+    bool detached = false;  // 不会被`AWAIT`，结束后由`Nsched`释放
+};
+
+/*
+ * `Nsched`用法（M:N调度，由`Nvm`在第一次执行`TASK`时创建）：
+ * 固定数量的工作线程各有一个Chase-Lev双端队列，新任务及被唤醒的任务压入当前工作线程的队列底部，工作线程从底部取任务（后进先出，缓存友好），
+ * 自己的队列为空时先取注入队列，再从其他工作线程队列的顶部窃取
+ * 不是工作线程的线程（主线程、`SPAWN`的线程）提交的任务及`YIELD`的任务放入注入队列（先进先出），使其他任务先执行
+ * `resume`执行任务直到结束（返回`true`）或挂起（返回`false`），挂起前任务已保存`pc`并登记到等待的任务、通道或注入队列中，
+ * 返回`false`后可能已经在其他工作线程上继续执行，所以不能再访问该任务
+ */
+class Nsched {
+public:
+    Nsched(size_t workerNum, std::function<bool(Ntask*)> _resume);
+    ~Nsched();  // 等待所有任务结束或阻塞（见`blocked`）后停止工作线程，阻塞的任务不会再执行
+
+    // 任务等待调度器之外的事件（`Npoll`）时先调用`waitExternal`，事件发生后用`submitExternal`重新提交
+    void waitExternal(void);
+    void submitExternal(Ntask* task);
+
+    void spawn(Ntask* task);    // 提交新任务
+    void submit(Ntask* task);   // 提交被唤醒的任务
+    void yield(Ntask* task);
+    size_t size(void) { return workers.size(); }
+
+    static thread_local Ntask* current;     // 当前工作线程正在执行的任务，不是工作线程时为空
+
+private:
+    // Chase-Lev双端队列（按Lê等人的C11版本），只有所属的工作线程调用`push`/`pop`，其他线程调用`steal`
+    class Deque {
+    public:
+        Deque(void);
+        void push(Ntask* task);
+        Ntask* pop(void);
+        Ntask* steal(void);
+        bool empty(void);
+
+    private:
+        struct Array {
+            int64_t capacity;
+            std::unique_ptr<std::atomic<Ntask*>[]> slots;
+
+            Array(int64_t _capacity) : capacity(_capacity), slots(new std::atomic<Ntask*>[_capacity]) {}
+            Ntask* get(int64_t i) { return slots[i & (capacity - 1)].load(std::memory_order_relaxed); }
+            void put(int64_t i, Ntask* task) { slots[i & (capacity - 1)].store(task, std::memory_order_relaxed); }
+        };
+
+        std::atomic<int64_t> top{0};
+        std::atomic<int64_t> bottom{0};
+        std::atomic<Array*> array;
+        std::vector<std::unique_ptr<Array>> arrays;     // 扩容后旧数组可能仍在被窃取，全部保留到析构
+    };
+
+    struct Worker {
+        Nsched* owner;
+        Deque deque;
+        std::thread os;
+    };
+
+    static const size_t spinRounds = 64;    // 找不到任务时先让出若干次再睡眠
+
+    std::function<bool(Ntask*)> resume;
+    std::vector<std::unique_ptr<Worker>> workers;
+    static thread_local Worker* self;
+
+    std::mutex injectMutex;
+    std::deque<Ntask*> injected;
+
+    std::atomic<size_t> live{0};    // 已提交尚未结束的任务数，加上其他线程中正在执行的`submit`数
+    std::atomic<bool> stopping{false};
+    std::mutex idleMutex;
+    std::condition_variable idle;
+    std::condition_variable drained;
+    std::atomic<size_t> sleeping{0};
+    std::atomic<size_t> external{0};    // 等待外部事件的任务数
+
+    void loop(size_t index);
+    Ntask* take(size_t index, uint64_t& seed);
+    bool hasWork(void);
+    bool blocked(void);     // 需持有`idleMutex`
+    void finish(Ntask* task);
+    void leave(void);   // `live`减一，为`0`时通知析构
+    void wake(void);
+};
\ No newline at end of file
@@ -0,0 +1,490 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 19:21:37
+ * @Description: 预先fork的工作进程服务器，通过Unix域套接字接收调用请求
+ */
+#include "nsrv.hpp"
+
+static void skipSpace(std::string_view& input) {
+    while(input.size() && (input[0] == ' ' || input[0] == '\t' || input[0] == '\r')) {
+        input.remove_prefix(1);
+    }
+}
+
+static bool sendAll(int fd, std::string data) {
+    size_t sent = 0;
+    while(sent < data.size()) {
+        ssize_t length = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if(length < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if(length <= 0) {
+            return false;
+        }
+
+        sent += length;
+    }
+
+    return true;
+}
+
+static sockaddr_un socketAddress(std::string socketPath) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if(socketPath.length() >= sizeof(address.sun_path)) {
+        error(socketPath + " socket path is too long");
+    }
+
+    strcpy(address.sun_path, socketPath.c_str());
+    return address;
+}
+
+Nsrv::Nsrv(std::string inputFileName, NsrvOption _option) : option(_option) {
+    if(option.workers < 1) {
+        error("the number of workers must be at least 1");
+    }
+
+    // 加载及初始化只在主进程中做一次，工作进程fork后直接共用（包括已`dlopen`的外部函数库）
+    if(lib.load(inputFileName, option.vm) != nl_ok) {
+        error(lib.message);
+    }
+
+    context = lib.newContext();
+    if(lib.run(context) != nl_ok) {
+        error(lib.message);
+    }
+
+    sockaddr_un address = socketAddress(option.socketPath);
+    listenFD = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(listenFD < 0) {
+        error("socket error");
+    }
+
+    fcntl(listenFD, F_SETFL, fcntl(listenFD, F_GETFL) | O_NONBLOCK);
+    unlink(option.socketPath.c_str());  // 上次异常退出时可能留下了套接字文件
+    if(bind(listenFD, (sockaddr*)&address, sizeof(address)) != 0 || listen(listenFD, SOMAXCONN) != 0) {
+        error(option.socketPath + " listen error: " + strerror(errno));
+    }
+
+    // 主进程阻塞这几个信号并用`sigwaitinfo`同步等待，不需要信号处理函数，也不会在检查标志与等待之间漏掉信号
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &signals, &oldMask);
+
+    for(int id = 0; id < option.workers; id ++) {
+        spawn(id);
+    }
+
+    std::cerr << "nl serve: " << option.workers << " workers listening on " << option.socketPath << '\n';
+
+    while(true) {
+        siginfo_t info;
+        if(sigwaitinfo(&signals, &info) < 0) {
+            continue;
+        }
+
+        if(info.si_signo != SIGCHLD) {
+            break;
+        }
+
+        // 多个`SIGCHLD`可能合并为一个，所以回收所有已退出的工作进程
+        int status;
+        pid_t pid;
+        while((pid = waitpid(- 1, &status, WNOHANG)) > 0) {
+            auto worker = workers.find(pid);
+            if(worker == workers.end()) {
+                continue;
+            }
+
+            int id = worker -> second;
+            workers.erase(worker);
+            std::cerr << "nl serve: worker " << id << " exited, restarting\n";
+            spawn(id);
+        }
+    }
+
+    for(auto& worker : workers) {
+        kill(worker.first, SIGTERM);
+    }
+
+    for(auto& worker : workers) {
+        waitpid(worker.first, NULL, 0);
+    }
+
+    close(listenFD);
+    unlink(option.socketPath.c_str());
+    lib.freeContext(context);
+    sigprocmask(SIG_SETMASK, &oldMask, NULL);
+}
+
+void Nsrv::spawn(int id) {
+    pid_t pid = fork();
+    if(pid < 0) {
+        error("fork error");
+    }
+
+    if(pid == 0) {
+        sigprocmask(SIG_SETMASK, &oldMask, NULL);
+        worker();
+    }
+
+    workers[pid] = id;
+}
+
+void Nsrv::worker(void) {
+    // 工作进程中的异常不能传回主进程的流程
+    try {
+        // 一个工作进程用`poll`同时服务多个连接，空闲的长连接不会占住工作进程
+        // 监听套接字为非阻塞的：多个工作进程同时被唤醒时，没抢到连接的`accept`返回`EAGAIN`
+        std::vector<pollfd> fds = {{listenFD, POLLIN, 0}};
+        std::vector<Connection> connections(1);     // 与`fds`一一对应
+        while(true) {
+            if(poll(fds.data(), fds.size(), - 1) < 0) {
+                if(errno == EINTR) {
+                    continue;
+                }
+
+                error(std::string("poll error: ") + strerror(errno));
+            }
+
+            for(size_t i = fds.size() - 1; i > 0; i --) {
+                if(! fds[i].revents) {
+                    continue;
+                }
+
+                Connection& connection = connections[i];
+                bool alive = true;
+                if(fds[i].revents & (POLLIN | POLLHUP | POLLERR) && ! connection.closing) {
+                    alive = serve(fds[i].fd, connection);
+                }
+
+                if(alive && connection.output.size()) {
+                    alive = flush(fds[i].fd, connection.output);
+                }
+
+                if(! alive || (connection.closing && connection.output.empty())) {
+                    close(fds[i].fd);
+                    fds[i] = fds.back();
+                    fds.pop_back();
+                    connections[i] = std::move(connections.back());
+                    connections.pop_back();
+                    continue;
+                }
+
+                fds[i].events = (connection.output.size() ? POLLOUT : 0)
+                              | (connection.closing || connection.output.size() > maxLine ? 0 : POLLIN);
+            }
+
+            if(fds[0].revents & POLLIN) {
+                int fd = accept(listenFD, NULL, NULL);
+                if(fd >= 0) {
+                    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                    fds.push_back({fd, POLLIN, 0});
+                    connections.emplace_back();
+                } else if(errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNABORTED) {
+                    error(std::string("accept error: ") + strerror(errno));
+                }
+            }
+        }
+    } catch(NlError& e) {
+        std::cerr << "Nl ERROR: " << e.what() << '\n';
+    }
+
+    _exit(1);
+}
+
+// 一次读到的多个请求（客户端可以连续发送）处理完后一起写回，写不完的部分留在`output`中
+bool Nsrv::serve(int fd, Connection& connection) {
+    char chunk[65536];
+    ssize_t length = read(fd, chunk, sizeof(chunk));
+    if(length < 0) {
+        return errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+
+    if(length == 0) {
+        connection.closing = true;
+        return true;
+    }
+
+    std::string& buffer = connection.input;
+    buffer.append(chunk, length);
+    size_t begin = 0, end;
+    while((end = buffer.find('\n', begin)) != std::string::npos) {
+        connection.output += handle(std::string_view(buffer).substr(begin, end - begin));
+        begin = end + 1;
+    }
+
+    buffer.erase(0, begin);
+    if(buffer.size() > maxLine) {
+        connection.output += "error request line is longer than " + std::to_string(maxLine) + " bytes\n";
+        connection.closing = true;
+    }
+
+    return true;
+}
+
+bool Nsrv::flush(int fd, std::string& output) {
+    size_t sent = 0;
+    while(sent < output.size()) {
+        ssize_t length = send(fd, output.data() + sent, output.size() - sent, MSG_NOSIGNAL);
+        if(length < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if(length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+
+        if(length <= 0) {
+            return false;
+        }
+
+        sent += length;
+    }
+
+    output.erase(0, sent);
+    return true;
+}
+
+std::string Nsrv::handle(std::string_view line) {
+    skipSpace(line);
+    size_t length = 0;
+    while(length < line.size() && line[length] != ' ' && line[length] != '\t' && line[length] != '\r') {
+        length ++;
+    }
+
+    if(! length) {
+        return "error empty request\n";
+    }
+
+    std::string label(line.substr(0, length));
+    line.remove_prefix(length);
+
+    lib.beginScope(context);
+
+    std::vector<NlObject> args;
+    std::string err = "", response;
+    for(skipSpace(line); line.size() && err == ""; skipSpace(line)) {
+        NlObject arg;
+        if(parseValue(line, arg, err)) {
+            args.push_back(arg);
+        }
+    }
+
+    NlObject result;
+    if(err != "") {
+        response = "error " + err;
+    } else if(lib.call(context, label, args, result) != nl_ok) {
+        response = "error " + lib.message;
+    } else {
+        // 返回值可能在请求作用域中，必须在`endScope`之前转为文本
+        bool ok;
+        std::string text = formatValue(result, ok);
+        response = ok ? "ok " + text : "error the result of " + label + " is not a number or a string";
+    }
+
+    lib.endScope(context);
+    requestStrings.clear();
+
+    std::replace(response.begin(), response.end(), '\n', ' ');  // 错误信息中可能有换行，结果中的换行已转义
+    return response + '\n';
+}
+
+bool Nsrv::parseValue(std::string_view& input, NlObject& value, std::string& err) {
+    skipSpace(input);
+    if(input.empty()) {
+        err = "missing value";
+        return false;
+    }
+
+    if(input[0] == '"') {
+        std::string string;
+        size_t i = 1;
+        for(; i < input.size() && input[i] != '"'; i ++) {
+            if(input[i] == '\\' && i + 1 < input.size()) {
+                i ++;
+                string += (input[i] == 'n' ? '\n' : input[i] == 't' ? '\t' : input[i]);
+            } else {
+                string += input[i];
+            }
+        }
+
+        if(i >= input.size()) {
+            err = "unterminated string";
+            return false;
+        }
+
+        input.remove_prefix(i + 1);
+        requestStrings.push_back(string);
+        value.type = STRING;
+        value.string = &requestStrings.back();
+        return true;
+    }
+
+    if(input[0] == '[') {
+        input.remove_prefix(1);
+        ListObject* list = lib.newList();
+        for(skipSpace(input); input.size() && input[0] != ']'; skipSpace(input)) {
+            NlObject element;
+            if(! parseValue(input, element, err)) {
+                return false;
+            }
+
+            list -> push_back(element);
+        }
+
+        if(input.empty()) {
+            err = "unterminated list";
+            return false;
+        }
+
+        input.remove_prefix(1);
+        value.type = POINTER;
+        value.pointer = list;
+        return true;
+    }
+
+    if(input[0] == '{') {
+        input.remove_prefix(1);
+        MapObject* map = lib.newMap();
+        for(skipSpace(input); input.size() && input[0] != '}'; skipSpace(input)) {
+            NlObject key, element;
+            if(! parseValue(input, key, err) || ! parseValue(input, element, err)) {
+                return false;
+            }
+
+            if(key.type != STRING) {
+                err = "map keys must be strings";
+                return false;
+            }
+
+            auto found = map -> find(*key.string);
+            if(found != map -> end()) {
+                found -> second = element;
+            } else {
+                map -> emplace(*key.string, element);
+            }
+        }
+
+        if(input.empty()) {
+            err = "unterminated map";
+            return false;
+        }
+
+        input.remove_prefix(1);
+        value.type = POINTER;
+        value.pointer = map;
+        return true;
+    }
+
+    size_t length = 0;
+    while(length < input.size() && ! strchr(" \t\r]}", input[length])) {
+        length ++;
+    }
+
+    std::string token(input.substr(0, length));
+    char* end;
+    value.type = NUM;
+    value.num = strtold(token.c_str(), &end);
+    if(token.empty() || *end) {
+        err = token + " is not a value";
+        return false;
+    }
+
+    input.remove_prefix(length);
+    return true;
+}
+
+std::string Nsrv::formatValue(NlObject value, bool& ok) {
+    ok = true;
+    if(value.type == NUM) {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "%.*Lg", LDBL_DIG, value.num);
+        return buffer;
+    }
+
+    if(value.type == STRING) {
+        std::string text = "\"";
+        if(value.string) {
+            for(char c : *value.string) {
+                if(c == '\n') {
+                    text += "\\n";
+                } else if(c == '\t') {
+                    text += "\\t";
+                } else {
+                    if(c == '"' || c == '\\') {
+                        text += '\\';
+                    }
+
+                    text += c;
+                }
+            }
+        }
+
+        return text + "\"";
+    }
+
+    ok = false;
+    return "";
+}
+
+int Nsrv::call(std::string socketPath, std::string request, size_t repeat) {
+    sockaddr_un address = socketAddress(socketPath);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0 || connect(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+        error(socketPath + " connect error: " + strerror(errno));
+    }
+
+    timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    // 每批最多发送`batch`个请求再读回结果，避免双方的缓冲区都被填满而互相等待
+    const size_t batch = 64;
+    std::string buffer, last;
+    char chunk[65536];
+    for(size_t done = 0; done < repeat; ) {
+        size_t count = std::min(batch, repeat - done);
+        std::string requests;
+        for(size_t i = 0; i < count; i ++) {
+            requests += request + '\n';
+        }
+
+        if(! sendAll(fd, requests)) {
+            error("send error: " + std::string(strerror(errno)));
+        }
+
+        for(size_t received = 0; received < count; ) {
+            size_t position = buffer.find('\n');
+            if(position != std::string::npos) {
+                last = buffer.substr(0, position);
+                buffer.erase(0, position + 1);
+                received ++;
+                continue;
+            }
+
+            ssize_t length = read(fd, chunk, sizeof(chunk));
+            if(length <= 0) {
+                error("connection closed by the server");
+            }
+
+            buffer.append(chunk, length);
+        }
+
+        done += count;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    close(fd);
+
+    std::cout << last << '\n';
+    if(repeat > 1) {
+        double seconds = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+        fprintf(stderr, "nl call: %zu requests in %.3f s (%.0f requests/s)\n", repeat, seconds, repeat / seconds);
+    }
+
+    return last.compare(0, 3, "ok ") == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,88 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 19:20:14
+ * @Description: 预先fork的工作进程服务器头文件
+ */
+#pragma once
+#include <map>
+#include <deque>
+#include <string>
+#include <vector>
+#include <cfloat>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <iostream>
+#include <string_view>
+
+#include <time.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+
+#include "nl.hpp"
+#include "nlib.hpp"
+#include "global.hpp"
+
+struct NsrvOption {
+    std::string socketPath = "nl.sock";
+    int workers = 4;
+    NvmOption vm;
+};
+
+/*
+ * `Nsrv`用法（`nl serve`）：
+ * 主进程加载程序并从入口执行到`EXIT`（初始化全局变量、`IMPORT`外部函数），再在Unix域套接字上监听并fork出`workers`个工作进程
+ * 工作进程共用监听套接字，各自`accept`连接并用`poll`同时服务多个连接，连接中每行为一个请求，每个请求返回一行结果；工作进程意外退出时主进程重新fork一个
+ * 一行请求最长`maxLine`字节，超过时返回错误并关闭连接
+ * 连接为非阻塞的，对方没有读走的结果留在连接中等`POLLOUT`再发送，不会卡住工作进程中的其他连接；积压超过`maxLine`字节时暂停读取该连接的请求
+ * 主进程收到`SIGINT`或`SIGTERM`时结束所有工作进程并删除套接字文件
+ * 每个请求在`Nlib`的请求作用域中执行，请求中创建的对象在返回结果后一次性释放，全局变量恢复为初始化后的值
+ *
+ * 协议（UTF-8文本，一行一个请求或结果）：
+ * 请求：<标签> <参数>...           参数按`CALL`的约定放在一个`list`中传给标签处的函数
+ * 结果：ok <返回值> 或 error <错误信息>
+ * 值：  数字（如`-1.5e3`）  字符串（`"..."`，其中`\n`、`\t`为换行和制表符，其余`\x`为`x`本身）
+ *       list（`[值 ...]`，只用于参数）  map（`{"键" 值 ...}`，只用于参数）
+ * 返回值只能为数字或字符串，虚拟机中`list`、`map`与其他指针无法区分，需要返回复杂数据时由脚本自行转为字符串
+ *
+ * `Nsrv::call`（`nl call`）为对应的客户端：发送一个请求（可重复`repeat`次），输出最后一个结果
+ */
+class Nsrv {
+public:
+    Nsrv(std::string inputFileName, NsrvOption option);     // 一直运行到收到`SIGINT`或`SIGTERM`
+    static int call(std::string socketPath, std::string request, size_t repeat = 1);   // 返回值为进程退出码
+
+private:
+    NsrvOption option;
+    Nlib lib;
+    Nlthread* context = nullptr;
+    int listenFD = - 1;
+    std::map<pid_t, int> workers;   // pid -> 工作进程编号
+    sigset_t oldMask;   // 主进程阻塞信号前的信号掩码，工作进程中恢复
+
+    void spawn(int id);
+    void worker(void);      // 不会返回
+    static const size_t maxLine = 1 << 20;
+
+    struct Connection {
+        std::string input;  // 未读完的请求行
+        std::string output;     // 未发送完的结果
+        bool closing = false;   // 对方已关闭或请求行过长，结果发送完后关闭连接
+    };
+
+    bool serve(int fd, Connection& connection);     // 处理连接上一次可读的数据，出错时返回`false`
+    static bool flush(int fd, std::string& output);     // 发送到套接字写满为止，出错时返回`false`
+    std::string handle(std::string_view line);
+
+    // 协议中值的读写，出错时返回`false`并设置`err`
+    std::deque<std::string> requestStrings;    // 参数中的字符串，由宿主持有直到请求结束
+    bool parseValue(std::string_view& input, NlObject& value, std::string& err);
+    static std::string formatValue(NlObject value, bool& ok);
+};
\ No newline at end of file
@@ -5,45 +5,960 @@
  */
 #include "nvm.hpp"
 
-Nvm::Nvm(std::string inputFileName) {
-    input.open(inputFileName, std::ios::binary | std::ios::in);
-    if(! input.is_open()) {
-        error(inputFileName + " open error");
+Nvm::Nvm(std::string inputFileName, NvmOption _option)
+    : Nvm(std::shared_ptr<Nprog>(new Nprog(inputFileName, _option.imageCache, _option.escapeAnalysis && _option.snapshotOut == "")), _option) {}
+
+Nvm::Nvm(std::shared_ptr<Nprog> _prog, NvmOption _option) : option(_option), prog(_prog) {
+    code = prog -> code;
+    version = prog -> version;
+    numTable = prog -> numTable;
+    numNum = prog -> numNum;
+    stringNum = prog -> stringNum;
+    stringCache = prog -> stringCache;
+    codeBegin = prog -> codeBegin;
+    codeEnd = prog -> codeEnd;
+    // 写出快照时所有对象都要在作用域中分配，`owner`才能判断其类别
+    if(option.escapeAnalysis && option.snapshotOut == "") {
+        localSites = prog -> localSites.data();
+        borrowSites = prog -> borrowSites.data();
+        localWords = prog -> localSites.size();
+    }
+}
+
+void Nvm::run(void) {
+    std::unique_ptr<Nprof> profiler;
+    if(option.profileFileName != "") {
+        profiler.reset(new Nprof(&cursor, option.profileHz));
+    }
+
+    if(option.memStats) {
+        Nmem::installSignalHandler();
+        if(option.memSites) {
+            mem.enableSites();
+        }
+    }
+
+    std::unique_ptr<Nperf> perfStats;
+    if(option.perfStats) {
+        perfStats.reset(new Nperf(option.perfByClass));
+        perf = perfStats.get();
+        perf -> start();
+    }
+
+    Nlthread thread;
+    initThread(thread);
+    mainThread = &thread;
+    bool scoped = option.arena || option.snapshotOut != "";
+    if(scoped) {
+        mem.beginScope();
+    }
+
+    start(thread);
+    if(scoped) {
+        mem.endScope();
+    }
+
+    if(option.snapshotOut != "" && ! snapshotSaved) {
+        error("the program ended without executing SNAPSHOT");
+    }
+
+    mainThread = nullptr;
+
+    if(perf) {
+        perf -> stop();
+        perf -> report(std::cerr);
+        perf = nullptr;
+    }
+
+    if(option.instrCount) {
+        std::cerr << "Nl instructions: " << executed << '\n';
+    }
+
+    if(option.memStats) {
+        mem.report(std::cerr, [this](size_t offset) { return describe(offset); });
+    }
+
+    if(profiler) {
+        profiler -> dump(option.profileFileName, [this](size_t offset) { return symbolize(offset); });
+    }
+}
+
+void Nvm::initThread(Nlthread& thread) {
+    StackFrame baseStackFrame;
+    thread.stack.push_back(baseStackFrame);
+    mem.record(Nmem::mem_frame, sizeof(StackFrame));
+    thread.sp = &thread.stack[thread.stack.size() - 1];
+}
+
+bool Nvm::start(Nlthread& thread) {
+    size_t entry = codeBegin;
+    if(option.snapshot != "") {
+        entry = loadSnapshot(thread);
+    }
+
+    return execute(thread, entry);
+}
+
+// 出错后栈中可能残留任意多个栈帧，只保留基栈帧（全局变量及已导入的外部函数不变）
+void Nvm::resetThread(Nlthread& thread) {
+    while(thread.stack.size() > 1) {
+        thread.stack.pop_back();
+        mem.release(Nmem::mem_frame, sizeof(StackFrame));
+    }
+
+    thread.sp = &thread.stack[0];
+    thread.sp -> opStack.clear();
+    if(thread.region) {
+        thread.region -> leave(1);
+    }
+}
+
+// 此前按借用分配在`Nregion`中、仍在栈帧中的对象可能被传给该共享库的外部函数，无法补救，所以报错
+void Nvm::imported(std::string soFileName) {
+    if(! localWords || ! lending.load() || prog -> borrows(soFileName)) {
+        return;
+    }
+
+    lending.store(false);
+    if(lent.load()) {
+        error("IMPORT: " + soFileName + " does not declare NL_EXPORT_BORROWS_ARGS and is imported after extern function arguments "
+              "were allocated in stack frames, import it earlier or run with --no-escape-analysis");
+    }
+}
+
+Nregion* Nvm::region(Nlthread& thread) {
+    if(! thread.region) {
+        thread.region = std::make_shared<Nregion>(&mem);
+    }
+
+    return thread.region.get();
+}
+
+// 与`CALL`指令相同地建立新栈帧，但返回地址为`codeEnd`，被调用的函数`RET`后执行循环在取下一条指令时自然结束
+NlObject Nvm::call(Nlthread& thread, size_t addr, ListObject* args) {
+    size_t depth = thread.stack.size();
+    enter(thread, args);
+    execute(thread, addr);
+
+    // 被调用的函数中执行了`EXIT`或没有`RET`就执行到了代码末尾
+    if(thread.stack.size() != depth || ! thread.sp -> opStack.size()) {
+        error("the called function did not return");
+    }
+
+    NlObject result = thread.sp -> opStack[thread.sp -> opStack.size() - 1];
+    thread.sp -> opStack.pop_back();
+    return result;
+}
+
+void Nvm::enter(Nlthread& thread, ListObject* args) {
+    NlObject object;
+    object.type = POINTER;
+    object.pointer = args;
+
+    StackFrame stackFrame;
+    thread.stack.push_back(stackFrame);
+    thread.sp = &thread.stack[thread.stack.size() - 1];
+    thread.sp -> returnAddress = codeEnd;
+    thread.sp -> opStack.push_back(object);
+    mem.record(Nmem::mem_frame, sizeof(StackFrame));
+}
+
+// `SPAWN`的线程复制父线程的全局变量表及外部函数表，在新的系统线程中与`call`相同地调用`addr`处的函数
+Nvm::Spawned* Nvm::spawn(Nlthread& parent, size_t addr, ListObject* args) {
+    // 作用域中的对象从`arena`分配，`arena`不是线程安全的，且`endScope`时线程可能仍在使用其中的对象
+    if(mem.scoped()) {
+        error("SPAWN cannot be used in a request scope");
     }
 
-    loadFile();
-    execute();
-    input.close();
+    Spawned* handle = new Spawned();
+    mem.record(Nmem::mem_thread, sizeof(*handle));
+    handle -> thread.externFNTable = parent.externFNTable;
+    handle -> thread.globalVarTable = parent.globalVarTable;
+    initThread(handle -> thread);
+
+    {
+        std::lock_guard<std::mutex> lock(spawnedMutex);
+        spawned.insert(handle);
+    }
+
+    handle -> os = std::thread([this, handle, addr, args]() {
+        try {
+            handle -> result = call(handle -> thread, addr, args);
+        } catch(std::exception& e) {
+            handle -> err = e.what();
+        }
+
+        // 线程结束后只保留返回值，栈帧全部释放
+        resetThread(handle -> thread);
+        handle -> thread.stack.clear();
+        mem.release(Nmem::mem_frame, sizeof(StackFrame));
+    });
+
+    return handle;
+}
+
+NlObject Nvm::join(Spawned* handle) {
+    {
+        std::lock_guard<std::mutex> lock(spawnedMutex);
+        if(! spawned.erase(handle)) {
+            error("the JOIN instruction requires a thread that has not been joined");
+        }
+    }
+
+    handle -> os.join();
+    NlObject result = handle -> result;
+    std::string err = handle -> err;
+    delete handle;
+    mem.release(Nmem::mem_thread, sizeof(*handle));
+
+    if(err != "") {
+        error("JOIN: " + err);
+    }
+
+    return result;
+}
+
+Npoll* Nvm::poller(void) {
+    Npoll* current = poll.load(std::memory_order_acquire);
+    if(current) {
+        return current;
+    }
+
+    std::lock_guard<std::mutex> lock(schedMutex);
+    if(! poll.load(std::memory_order_relaxed)) {
+        poll.store(new Npoll([this](Ntask* task) { scheduler() -> submitExternal(task); }), std::memory_order_release);
+    }
+
+    return poll.load(std::memory_order_relaxed);
 }
 
-void Nvm::loadFile(void) {
-    /* 1. file header */
-    NlcFile::FileHeader fileHeader;
-    input.read((char*)&fileHeader, sizeof(NlcFile::FileHeader));
-    
-    // check magic
-    if(fileHeader.magic != NlcFile::magicNum) {
-        error("file corruption");
+Nsched* Nvm::scheduler(void) {
+    Nsched* current = sched.load(std::memory_order_acquire);
+    if(current) {
+        return current;
     }
 
-    /* 2. numbers */
-    for(size_t i = 0; i < fileHeader.numNum; i ++) {
-        NlcFile::Num num;
-        input.read((char*)&num, sizeof(num));
-        numTable.push_back(num);
+    std::lock_guard<std::mutex> lock(schedMutex);
+    if(! sched.load(std::memory_order_relaxed)) {
+        sched.store(new Nsched(option.taskWorkers, [this](Ntask* task) { return runTask(task); }), std::memory_order_release);
     }
 
-    /* strings */
-    for(size_t i = 0; i < fileHeader.strNum; i ++) {
-        int stringLength;
-        input.read((char*)&stringLength, sizeof(stringLength));
+    return sched.load(std::memory_order_relaxed);
+}
+
+// 与`SPAWN`相同地复制父线程的全局变量表及外部函数表，但只建立栈帧，由工作线程从`addr`开始执行
+Ntask* Nvm::newTask(Nlthread& parent, size_t addr, ListObject* args) {
+    if(mem.scoped()) {
+        error("TASK cannot be used in a request scope");
+    }
 
-        // `char*`字符串必须以`\0`结尾
-        char* string = (char*)malloc(stringLength + 1);
-        string[stringLength] = '\0';
-        input.read(string, stringLength);
-        stringTable.push_back(std::string(string));
+    Ntask* task = new Ntask();
+    mem.record(Nmem::mem_task, sizeof(*task));
+    task -> thread.externFNTable = parent.externFNTable;
+    task -> thread.globalVarTable = parent.globalVarTable;
+    initThread(task -> thread);
+    enter(task -> thread, args);
+    task -> pc = addr;
+
+    {
+        std::lock_guard<std::mutex> lock(tasksMutex);
+        tasks.insert(task);
+    }
+
+    scheduler() -> spawn(task);
+    return task;
+}
+
+// 由工作线程调用，挂起时返回`false`且不能再访问`task`
+bool Nvm::runTask(Ntask* task) {
+    try {
+        if(task -> body) {
+            Nsched::current = nullptr;  // 不是从字节码开始执行的任务不能挂起，其中的`AWAIT`阻塞等待
+            task -> body(task);
+        } else if(! execute(task -> thread, task -> pc)) {
+            return false;
+        } else {
+            // 任务中执行了`EXIT`或没有`RET`就执行到了代码末尾
+            if(task -> thread.stack.size() != 1 || ! task -> thread.sp -> opStack.size()) {
+                error("the task did not return");
+            }
+
+            task -> result = task -> thread.sp -> opStack[task -> thread.sp -> opStack.size() - 1];
+        }
+    } catch(std::exception& e) {
+        task -> err = e.what();
     }
+
+    // 任务结束后只保留返回值，栈帧全部释放
+    resetThread(task -> thread);
+    task -> thread.stack.clear();
+    mem.release(Nmem::mem_frame, sizeof(StackFrame));
+    return true;
+}
+
+// 调用线程也领取块，所以即使没有空闲的工作线程也不会一直等待；辅助任务开始时块可能已被领完，此时直接结束
+std::string Nvm::parallel(Nlthread& thread, size_t chunkNum, std::function<void(Nlthread&, size_t)> chunk) {
+    if(mem.scoped()) {
+        error("parallel list actions cannot be used in a request scope");
+    }
+
+    std::shared_ptr<ParallelJob> job(new ParallelJob());
+    job -> chunkNum = chunkNum;
+    job -> chunk = chunk;
+
+    auto work = [this, job](Nlthread& worker) {
+        size_t c;
+        while((c = job -> next.fetch_add(1)) < job -> chunkNum) {
+            std::string err = "";
+            size_t depth = worker.stack.size();
+            size_t ip = worker.ip;
+            if(! job -> failed.load()) {
+                try {
+                    job -> chunk(worker, c);
+                } catch(std::exception& e) {
+                    err = e.what();
+                }
+            }
+
+            // 出错时栈中可能残留被调用函数的栈帧，恢复到领取前的状态
+            while(worker.stack.size() > depth) {
+                worker.stack.pop_back();
+                mem.release(Nmem::mem_frame, sizeof(StackFrame));
+            }
+
+            worker.sp = &worker.stack[worker.stack.size() - 1];
+            worker.ip = ip;
+
+            std::lock_guard<std::mutex> lock(job -> lock);
+            if(err != "" && job -> err == "") {
+                job -> err = err;
+                job -> failed.store(true);
+            }
+
+            if(++ job -> done == job -> chunkNum) {
+                job -> finished.notify_all();
+            }
+        }
+    };
+
+    Nsched* pool = scheduler();
+    Ntask* self = Nsched::current;
+    size_t helpers = chunkNum ? std::min(chunkNum - 1, pool -> size() - (self ? 1 : 0)) : 0;
+    for(size_t i = 0; i < helpers; i ++) {
+        Ntask* task = new Ntask();
+        task -> thread.externFNTable = thread.externFNTable;
+        task -> thread.globalVarTable = thread.globalVarTable;
+        initThread(task -> thread);
+        task -> detached = true;
+        task -> body = [work](Ntask* task) { work(task -> thread); };
+        pool -> spawn(task);
+    }
+
+    Nsched::current = nullptr;
+    work(thread);
+    Nsched::current = self;
+
+    std::unique_lock<std::mutex> lock(job -> lock);
+    job -> finished.wait(lock, [&job]() { return job -> done == job -> chunkNum; });
+    return job -> err;
+}
+
+// 按`CALL`的约定调用函数，结束后恢复`ip`，使当前指令之后报错时仍指向自己
+NlObject Nvm::apply(Nlthread& thread, size_t addr, std::vector<NlObject> args) {
+    ListObject* list = mem.newList();
+    list -> assign(args.begin(), args.end());
+
+    size_t ip = thread.ip;
+    NlObject result = call(thread, addr, list);
+    thread.ip = ip;
+    return result;
+}
+
+ListObject* Nvm::parallelMap(Nlthread& thread, ListObject* list, size_t addr) {
+    NlObject zero;
+    zero.type = NUM;
+    zero.num = 0;
+
+    size_t n = list -> size();
+    ListObject* result = mem.newList();
+    result -> resize(n, zero);
+
+    size_t chunkNum = std::min(n, scheduler() -> size() * chunksPerWorker);
+    std::string err = parallel(thread, chunkNum, [&](Nlthread& worker, size_t c) {
+        for(size_t i = n * c / chunkNum; i < n * (c + 1) / chunkNum; i ++) {
+            (*result)[i] = apply(worker, addr, { (*list)[i] });
+        }
+    });
+
+    if(err != "") {
+        error("ACTION_LIST(PARALLEL_MAP ACTION): " + err);
+    }
+
+    return result;
+}
+
+NlObject Nvm::parallelReduce(Nlthread& thread, ListObject* list, size_t addr, NlObject init) {
+    size_t n = list -> size();
+    size_t chunkNum = std::min(n, scheduler() -> size() * chunksPerWorker);
+    std::vector<NlObject> partial(chunkNum);
+    std::string err = parallel(thread, chunkNum, [&](Nlthread& worker, size_t c) {
+        size_t begin = n * c / chunkNum, end = n * (c + 1) / chunkNum;
+        NlObject acc = (*list)[begin];
+        for(size_t i = begin + 1; i < end; i ++) {
+            acc = apply(worker, addr, { acc, (*list)[i] });
+        }
+
+        partial[c] = acc;
+    });
+
+    if(err != "") {
+        error("ACTION_LIST(PARALLEL_REDUCE ACTION): " + err);
+    }
+
+    NlObject acc = init;
+    for(auto& value : partial) {
+        acc = apply(thread, addr, { acc, value });
+    }
+
+    return acc;
+}
+
+bool Nvm::find(std::string label, size_t& addr) {
+    return prog -> find(label, addr);
+}
+
+std::string Nvm::describe(size_t offset) {
+    return prog -> describe(offset);
+}
+
+std::string Nvm::symbolize(size_t offset) {
+    return prog -> symbolize(offset);
+}
+
+std::string_view Nvm::stringView(size_t id) {
+    return prog -> stringView(id);
+}
+
+// 已拷贝过的常量只需一次`acquire`读取，不需要访问`prog`
+std::string* Nvm::string(size_t id) {
+    if(id < stringNum) {
+        std::string* cached = stringCache[id].load(std::memory_order_acquire);
+        if(cached) {
+            return cached;
+        }
+    }
+
+    return prog -> string(id, mem);
+}
+
+ListObject* Nvm::newList(void) {
+    return mem.newList();
+}
+
+MapObject* Nvm::newMap(void) {
+    return mem.newMap();
+}
+
+void Nvm::beginScope(void) {
+    mem.beginScope();
+}
+
+void Nvm::endScope(void) {
+    mem.endScope();
+}
+
+void Nvm::dropScoped(Nlthread& thread) {
+    for(auto var = thread.globalVarTable.begin(); var != thread.globalVarTable.end(); ) {
+        if(var -> second.type == POINTER && mem.owner(var -> second.pointer) != Nmem::mem_kind_num) {
+            var = thread.globalVarTable.erase(var);
+        } else {
+            var ++;
+        }
+    }
+}
+
+NlObject Nvm::promote(NlObject value) {
+    if(value.type != POINTER || ! mem.scoped()) {
+        return value;
+    }
+
+    std::unordered_map<const void*, void*> copied;
+    return promote(value, copied);
+}
+
+// 不在`arena`中的指针（堆上的对象、通道、任务等句柄）原样返回，其中即使存有作用域中的对象也不会被发现
+NlObject Nvm::promote(NlObject value, std::unordered_map<const void*, void*>& copied) {
+    if(value.type != POINTER) {
+        return value;
+    }
+
+    Nmem::Kind kind = mem.owner(value.pointer);
+    if(kind == Nmem::mem_kind_num) {
+        return value;
+    }
+
+    auto found = copied.find(value.pointer);
+    if(found != copied.end()) {
+        value.pointer = found -> second;
+        return value;
+    }
+
+    switch(kind) {
+        case Nmem::mem_list: {
+            ListObject* from = (ListObject*)value.pointer;
+            ListObject* to = mem.newList(true);
+            copied[from] = to;
+            to -> reserve(from -> size());
+            for(auto& element : *from) {
+                to -> push_back(promote(element, copied));
+            }
+
+            value.pointer = to;
+            break;
+        }
+
+        case Nmem::mem_map: {
+            MapObject* from = (MapObject*)value.pointer;
+            MapObject* to = mem.newMap(true);
+            copied[from] = to;
+            for(auto& entry : *from) {
+                to -> emplace(entry.first, promote(entry.second, copied));
+            }
+
+            value.pointer = to;
+            break;
+        }
+
+        default: {
+            size_t* addr = mem.newAddr(*(size_t*)value.pointer, true);
+            copied[value.pointer] = addr;
+            value.pointer = addr;
+            break;
+        }
+    }
+
+    return value;
+}
+
+
+Nvm::~Nvm() {
+    // 没有`JOIN`的线程可能仍在使用常量及程序镜像，`prog`在此之后才可能释放
+    for(auto handle : spawned) {
+        handle -> os.join();
+        delete handle;
+    }
+
+    // 等待所有任务结束或剩下的任务都不会再被唤醒后停止工作线程，等待`fd`的任务需要`poll`唤醒，所以最后才停止事件循环
+    // 没有结束的任务（如等待一个不会再有人发送的通道）直接释放
+    delete sched.load();
+    delete poll.load();
+    for(auto task : tasks) {
+        delete task;
+    }
+}
+
+// 按发现的顺序给对象编号，写完根（全局变量等）的值后依次写出各对象的元素，共享及循环引用的对象只写一次
+// 常量字符串只记编号，恢复时与程序中的常量是同一份
+void Nvm::saveSnapshot(Nlthread& thread, size_t resume) {
+    if(! mem.scoped()) {
+        error("SNAPSHOT: the initialization must run in a request scope (nl run --snapshot-out)");
+    }
+
+    if(thread.stack.size() != 1) {
+        error("SNAPSHOT must be executed in the base stack frame");
+    }
+
+    std::unordered_map<const std::string*, size_t> constants;
+    for(size_t id = 0; id < stringNum; id ++) {
+        std::string* cached = stringCache[id].load(std::memory_order_acquire);
+        if(cached) {
+            constants[cached] = id;
+        }
+    }
+
+    std::vector<uint64_t> ids;
+    std::vector<NlcFile::SnapshotValue> values;
+    std::vector<NlcFile::SnapshotObject> objects;
+    std::vector<const void*> pointers;  // 与`objects`对应
+    std::unordered_map<const void*, size_t> indexes;
+    std::vector<NlcFile::Num> nums;
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, uint64_t> stringIndexes;    // 相同的键只写一次
+
+    auto addString = [&](const std::string& string) {
+        auto found = stringIndexes.find(string);
+        if(found == stringIndexes.end()) {
+            found = stringIndexes.emplace(string, strings.size()).first;
+            strings.push_back(string);
+        }
+
+        return found -> second;
+    };
+
+    auto convert = [&](const NlObject& object) {
+        NlcFile::SnapshotValue value = { NlcFile::snap_num, 0, 0 };
+        switch(object.type) {
+            case NUM: {
+                value.index = nums.size();
+                nums.push_back(object.num);
+                break;
+            }
+
+            case STRING: {
+                auto constant = constants.find(object.string);
+                if(constant != constants.end()) {
+                    value.kind = NlcFile::snap_const;
+                    value.index = constant -> second;
+                } else {
+                    value.kind = NlcFile::snap_string;
+                    value.index = addString(*object.string);
+                }
+
+                break;
+            }
+
+            case POINTER: {
+                auto found = indexes.find(object.pointer);
+                if(found == indexes.end()) {
+                    NlcFile::SnapshotObject added = { NlcFile::snap_list, 0, 0, 0 };
+                    switch(mem.owner(object.pointer)) {
+                        case Nmem::mem_list: {
+                            break;
+                        }
+
+                        case Nmem::mem_map: {
+                            added.kind = NlcFile::snap_map;
+                            break;
+                        }
+
+                        case Nmem::mem_addr: {
+                            added.kind = NlcFile::snap_addr;
+                            break;
+                        }
+
+                        default: {
+                            error("SNAPSHOT: only lists, maps and addresses created during the initialization can be saved");
+                        }
+                    }
+
+                    found = indexes.emplace(object.pointer, objects.size()).first;
+                    objects.push_back(added);
+                    pointers.push_back(object.pointer);
+                }
+
+                value.kind = objects[found -> second].kind;
+                value.index = found -> second;
+                break;
+            }
+        }
+
+        return value;
+    };
+
+    NlcFile::SnapshotHeader header = {};
+    prog -> stampSource(header.source);
+    header.resume = resume;
+
+    /* roots */
+    for(auto& var : thread.globalVarTable) {
+        ids.push_back(var.first);
+        values.push_back(convert(var.second));
+    }
+
+    for(auto& var : thread.sp -> localVarTable) {
+        ids.push_back(var.first);
+        values.push_back(convert(var.second));
+    }
+
+    for(auto& object : thread.sp -> opStack) {
+        values.push_back(convert(object));
+    }
+
+    header.globalNum = thread.globalVarTable.size();
+    header.localNum = thread.sp -> localVarTable.size();
+    header.stackNum = thread.sp -> opStack.size();
+
+    /* objects */
+    // 写出元素时可能发现新的对象，`objects`会扩容，所以只通过下标访问
+    for(size_t i = 0; i < objects.size(); i ++) {
+        size_t begin = values.size(), size = 0;
+        if(objects[i].kind == NlcFile::snap_list) {
+            for(auto& element : *(ListObject*)pointers[i]) {
+                values.push_back(convert(element));
+            }
+
+            size = ((ListObject*)pointers[i]) -> size();
+        } else if(objects[i].kind == NlcFile::snap_map) {
+            for(auto& entry : *(MapObject*)pointers[i]) {
+                values.push_back({ NlcFile::snap_string, 0, addString(std::string(entry.first)) });
+                values.push_back(convert(entry.second));
+            }
+
+            size = ((MapObject*)pointers[i]) -> size();
+        } else {
+            begin = *(size_t*)pointers[i];
+        }
+
+        objects[i].begin = begin;
+        objects[i].size = size;
+    }
+
+    /* externs */
+    std::vector<uint64_t> externs;
+    for(auto& externFN : thread.externFNTable) {
+        std::string soFileName = prog -> moduleOf(externFN.first, externFN.second);
+        if(soFileName == "") {
+            error("SNAPSHOT: extern function " + externFN.first + " was not imported from a shared library");
+        }
+
+        externs.push_back(addString(externFN.first));
+        externs.push_back(addString(soFileName));
+    }
+
+    std::string out((char*)&header, sizeof(header));
+    auto append = [&](const void* data, size_t size, size_t alignment) {
+        out.append((alignment - out.size() % alignment) % alignment, '\0');
+        size_t offset = out.size();
+        out.append((const char*)data, size);
+        return (uint64_t)offset;
+    };
+
+    header.idOffset = append(ids.data(), ids.size() * sizeof(uint64_t), sizeof(uint64_t));
+    header.valueOffset = append(values.data(), values.size() * sizeof(NlcFile::SnapshotValue), sizeof(uint64_t));
+    header.valueNum = values.size();
+    header.objectOffset = append(objects.data(), objects.size() * sizeof(NlcFile::SnapshotObject), sizeof(uint64_t));
+    header.objectNum = objects.size();
+    header.numOffset = append(nums.data(), nums.size() * sizeof(NlcFile::Num), alignof(NlcFile::Num));
+    header.numNum = nums.size();
+
+    std::vector<uint64_t> offsets = { 0 };
+    for(auto& string : strings) {
+        offsets.push_back(offsets.back() + string.length());
+    }
+
+    header.stringOffset = append(offsets.data(), offsets.size() * sizeof(uint64_t), sizeof(uint64_t));
+    header.stringNum = strings.size();
+    for(auto& string : strings) {
+        out.append(string);
+    }
+
+    header.externOffset = append(externs.data(), externs.size() * sizeof(uint64_t), sizeof(uint64_t));
+    header.externNum = externs.size() / 2;
+    header.snapshotSize = out.size();
+    memcpy(&out[0], &header, sizeof(header));
+
+    std::ofstream output(option.snapshotOut, std::ios::binary | std::ios::out);
+    if(! output.is_open()) {
+        error(option.snapshotOut + " open error");
+    }
+
+    output.write(out.data(), out.size());
+    output.close();
+    if(! output) {
+        error(option.snapshotOut + " write error");
+    }
+
+    snapshotSaved = true;
+}
+
+// 与`Nprog::loadImage`相同，只检查各部分没有超出文件、下标没有越界
+// 先一次分配出所有对象（`list`预留好容量），再填入元素，对象之间的引用只需按下标取得指针
+size_t Nvm::loadSnapshot(Nlthread& thread) {
+    std::string fileName = option.snapshot;
+    Nmap file(fileName);
+    const char* data = file.data();
+    size_t size = file.size();
+
+    NlcFile::SnapshotHeader header;
+    if(size < sizeof(header)) {
+        error(fileName + " snapshot corruption");
+    }
+
+    memcpy(&header, data, sizeof(header));
+    if(header.magic != NlcFile::snapshotMagicNum || header.snapshotSize != size) {
+        error(fileName + " snapshot corruption");
+    }
+
+    if(! prog -> matchesSource(header.source)) {
+        error(fileName + " snapshot was not created from this program");
+    }
+
+    auto fits = [&](uint64_t offset, uint64_t num, size_t width, size_t alignment) {
+        return offset % alignment == 0 && offset <= size && num <= (size - offset) / width;
+    };
+
+    if(thread.stack.size() != 1
+    || header.resume < codeBegin || header.resume > codeEnd
+    || header.globalNum > header.valueNum || header.localNum > header.valueNum - header.globalNum
+    || header.stackNum > header.valueNum - header.globalNum - header.localNum
+    || ! fits(header.idOffset, header.globalNum + header.localNum, sizeof(uint64_t), sizeof(uint64_t))
+    || ! fits(header.valueOffset, header.valueNum, sizeof(NlcFile::SnapshotValue), sizeof(uint64_t))
+    || ! fits(header.objectOffset, header.objectNum, sizeof(NlcFile::SnapshotObject), sizeof(uint64_t))
+    || ! fits(header.numOffset, header.numNum, sizeof(NlcFile::Num), alignof(NlcFile::Num))
+    || header.stringNum >= size || ! fits(header.stringOffset, header.stringNum + 1, sizeof(uint64_t), sizeof(uint64_t))
+    || header.externNum >= size || ! fits(header.externOffset, header.externNum * 2, sizeof(uint64_t), sizeof(uint64_t))) {
+        error(fileName + " snapshot corruption");
+    }
+
+    const uint64_t* ids = (const uint64_t*)(data + header.idOffset);
+    const NlcFile::SnapshotValue* values = (const NlcFile::SnapshotValue*)(data + header.valueOffset);
+    const NlcFile::SnapshotObject* objects = (const NlcFile::SnapshotObject*)(data + header.objectOffset);
+    const NlcFile::Num* nums = (const NlcFile::Num*)(data + header.numOffset);
+    const uint64_t* offsets = (const uint64_t*)(data + header.stringOffset);
+    const uint64_t* externs = (const uint64_t*)(data + header.externOffset);
+    size_t bytesBegin = header.stringOffset + (header.stringNum + 1) * sizeof(uint64_t);
+
+    auto stringAt = [&](uint64_t index) {
+        if(index >= header.stringNum || offsets[index] > offsets[index + 1] || offsets[index + 1] > size - bytesBegin) {
+            error(fileName + " snapshot corruption");
+        }
+
+        return std::string_view(data + bytesBegin + offsets[index], offsets[index + 1] - offsets[index]);
+    };
+
+    // 恢复的对象与快照一样长期存在，即使在作用域中也从堆分配
+    std::vector<void*> pointers(header.objectNum);
+    for(size_t i = 0; i < header.objectNum; i ++) {
+        const NlcFile::SnapshotObject& object = objects[i];
+        uint64_t width = (object.kind == NlcFile::snap_map ? 2 : 1);
+        if(object.kind != NlcFile::snap_addr
+        && (object.begin > header.valueNum || object.size > (header.valueNum - object.begin) / width)) {
+            error(fileName + " snapshot corruption");
+        }
+
+        if(object.kind == NlcFile::snap_list) {
+            ListObject* list = mem.newList(true);
+            list -> reserve(object.size);
+            pointers[i] = list;
+        } else if(object.kind == NlcFile::snap_map) {
+            pointers[i] = mem.newMap(true);
+        } else if(object.kind == NlcFile::snap_addr) {
+            pointers[i] = mem.newAddr(object.begin, true);
+        } else {
+            error(fileName + " snapshot corruption");
+        }
+    }
+
+    std::vector<std::string*> strings(header.stringNum, nullptr);
+    auto convert = [&](const NlcFile::SnapshotValue& value) {
+        NlObject object;
+        if(value.kind == NlcFile::snap_num && value.index < header.numNum) {
+            object.type = NUM;
+            object.num = nums[value.index];
+        } else if(value.kind == NlcFile::snap_const && value.index < stringNum) {
+            object.type = STRING;
+            object.string = string(value.index);
+        } else if(value.kind == NlcFile::snap_string) {
+            std::string_view view = stringAt(value.index);
+            if(! strings[value.index]) {
+                snapshotStrings.emplace_back(view);
+                mem.record(Nmem::mem_string, sizeof(std::string) + snapshotStrings.back().capacity());
+                strings[value.index] = &snapshotStrings.back();
+            }
+
+            object.type = STRING;
+            object.string = strings[value.index];
+        } else if(value.index < header.objectNum && value.kind == objects[value.index].kind) {
+            object.type = POINTER;
+            object.pointer = pointers[value.index];
+        } else {
+            error(fileName + " snapshot corruption");
+        }
+
+        return object;
+    };
+
+    // `map`的键按写出时的顺序（即`map`的顺序）排列，每次都插入到末尾
+    for(size_t i = 0; i < header.objectNum; i ++) {
+        const NlcFile::SnapshotObject& object = objects[i];
+        if(object.kind == NlcFile::snap_list) {
+            ListObject* list = (ListObject*)pointers[i];
+            for(size_t j = 0; j < object.size; j ++) {
+                list -> push_back(convert(values[object.begin + j]));
+            }
+        } else if(object.kind == NlcFile::snap_map) {
+            MapObject* map = (MapObject*)pointers[i];
+            for(size_t j = 0; j < object.size; j ++) {
+                const NlcFile::SnapshotValue& key = values[object.begin + j * 2];
+                if(key.kind != NlcFile::snap_string) {
+                    error(fileName + " snapshot corruption");
+                }
+
+                map -> emplace_hint(map -> end(), stringAt(key.index), convert(values[object.begin + j * 2 + 1]));
+            }
+        }
+    }
+
+    size_t next = 0;
+    for(size_t i = 0; i < header.globalNum; i ++) {
+        thread.globalVarTable[ids[i]] = convert(values[next ++]);
+    }
+
+    for(size_t i = 0; i < header.localNum; i ++) {
+        thread.sp -> localVarTable[ids[header.globalNum + i]] = convert(values[next ++]);
+    }
+
+    for(size_t i = 0; i < header.stackNum; i ++) {
+        thread.sp -> opStack.push_back(convert(values[next ++]));
+    }
+
+    for(size_t i = 0; i < header.externNum; i ++) {
+        std::string name(stringAt(externs[i * 2]));
+        std::string soFileName(stringAt(externs[i * 2 + 1]));
+        for(auto& externFN : prog -> import(soFileName)) {
+            if(externFN.first == name) {
+                thread.externFNTable[name] = externFN.second;
+            }
+        }
+
+        imported(soFileName);
+    }
+
+    return header.resume;
+}
+
+// 操作数宽度只有四种，越界时报错而不是读到代码段之外
+size_t Nvm::operand(size_t& pc, int width) {
+    size_t bytes = (size_t)1 << width;
+    if(codeEnd - pc < bytes) {
+        error("unexpected end of code");
+    }
+
+    size_t value;
+    switch(width) {
+        case 0: {
+            value = (uint8_t)code[pc];
+            break;
+        }
+
+        case 1: {
+            uint16_t v;
+            memcpy(&v, &code[pc], sizeof(v));
+            value = v;
+            break;
+        }
+
+        case 2: {
+            uint32_t v;
+            memcpy(&v, &code[pc], sizeof(v));
+            value = v;
+            break;
+        }
+
+        default: {
+            memcpy(&value, &code[pc], sizeof(value));
+            break;
+        }
+    }
+
+    pc += bytes;
+    return value;
+}
+
+// v1中为文件偏移，v2中为相对于指令起始位置的32位有符号偏移
+size_t Nvm::target(size_t& pc, int width, size_t ip) {
+    size_t value = operand(pc, width);
+    return version == 1 ? value : ip + (int32_t)(uint32_t)value;
 }
 
 bool Nvm::objectToBool(NlObject object) {
@@ -70,24 +985,74 @@ bool Nvm::objectToBool(NlObject object) {
     return false;   // 虽然`Nlobject`只可能有上示三种类型，但是编译器报`warn`，只得写这一行冗余代码保证编译完美通过
 }
 
-void Nvm::execute(void) {
-    Nlthread thread;
-    StackFrame baseStackFrame;
-    thread.stack.push_back(baseStackFrame);
-    thread.sp = &thread.stack[thread.stack.size() - 1];
-    
-    // Note: 使用`input.eof()`会出现问题
-    while(input.peek() != EOF) {
-        char mnem;
-        input.read(&mnem, sizeof(mnem));
+bool Nvm::execute(Nlthread& thread, size_t entry) {
+    // 报错时附上当前执行位置，只有真正报错时才会读取调试段
+    // 无论正常结束还是报错都要恢复为进入时的值（`PARALLEL_MAP`等在执行中嵌套调用时不为空），否则之后其他模块的报错会附上已经无效的执行位置
+    // 执行的指令条数先在局部变量中累加，结束时再加到`executed`中，避免每条指令都做原子操作
+    struct ContextGuard {
+        Nvm* vm;
+        std::function<std::string(void)> previous;
+        const size_t* previousSites;
+        size_t count = 0;
+        ~ContextGuard() {
+            errorContext = std::move(previous);
+            Nmem::trackSites(previousSites);
+            vm -> executed.fetch_add(count, std::memory_order_relaxed);
+        }
+    } contextGuard = { this, errorContext, Nmem::trackSites(&thread.ip) };
+
+    size_t& ip = thread.ip;
+    errorContext = [this, &ip]() { return "at " + describe(ip); };
+
+    // 文件末尾可能为调试段，所以通过`codeEnd`判断代码是否结束
+    size_t pc = entry;
+    int width = 3;
+    bool isMain = (&thread == mainThread.load(std::memory_order_relaxed));
+    bool profiling = (option.profileFileName != "" && isMain);
+    Nperf* perf = (isMain ? this -> perf : nullptr);
+    while(true) {
+        // 按类别统计时随机间隔采样，固定间隔可能总是落在循环中的同一条指令上
+        bool perfSample = false;
+        if(perf && perf -> byClass && -- perfCountdown == 0) {
+            perfCountdown = Nperf::samplePeriod / 2 + rand() % Nperf::samplePeriod;
+            perfSample = true;
+            perf -> sampleBegin();
+        }
+
+        if(Nmem::reportRequested) {
+            Nmem::reportRequested = 0;
+            mem.report(std::cerr, [this](size_t offset) { return describe(offset); });
+        }
+
+        ip = pc;
+        if(ip >= codeEnd) {
+            return true;
+        }
+
+        if(profiling) {
+            cursor.ip = ip;
+        }
+
+        contextGuard.count ++;
+
+        // v2的操作码高2位为操作数宽度
+        int mnem = (uint8_t)code[pc ++];
+        if(version != 1) {
+            width = mnem >> NlcFile::mnemBits;
+            mnem &= NlcFile::mnemMask;
+        }
+
+        if(perfSample) {
+            perf -> sampleDecoded();
+        }
+
         switch(mnem) {
             case LOAD_LOCAL: {
                 // 预热
-                size_t id;
-                input.read((char*)&id, sizeof(id));
+                size_t id = operand(pc, width);
 
                 if(! thread.sp -> localVarTable.count(id)) {
-                    error(stringTable[id] + " variable does not exist in the local variable table");
+                    error(std::string(stringView(id)) + " variable does not exist in the local variable table");
                 }
 
                 // 将变量对应的值加载到栈上
@@ -97,11 +1062,10 @@ void Nvm::execute(void) {
 
             case LOAD_GLOBAL: {
                 // 预热
-                size_t id;
-                input.read((char*)&id, sizeof(id));
+                size_t id = operand(pc, width);
 
                 if(! thread.globalVarTable.count(id)) {
-                    error(stringTable[id] + " variable does not exist in the global variable table");
+                    error(std::string(stringView(id)) + " variable does not exist in the global variable table");
                 }
 
                 // 将变量对应的值加载到栈上
@@ -110,8 +1074,10 @@ void Nvm::execute(void) {
             }
 
             case LOAD_NUM: {
-                size_t numId;
-                input.read((char*)&numId, sizeof(numId));
+                size_t numId = operand(pc, width);
+                if(numId >= numNum) {
+                    error("number constant " + std::to_string(numId) + " does not exist");
+                }
 
                 NlObject object;
                 object.type = NUM;
@@ -121,21 +1087,19 @@ void Nvm::execute(void) {
             }
 
             case LOAD_STRING: {
-                size_t strId;
-                input.read((char*)&strId, sizeof(strId));
+                size_t strId = operand(pc, width);
 
                 NlObject object;
                 object.type = STRING;
-                object.string = &stringTable[strId];
+                object.string = string(strId);
 
                 thread.sp -> opStack.push_back(object);
                 break;
             }
 
             case LOAD_ADDR: {
-                // 必须使用`malloc`在堆上分配空间，否则数据默认放在栈上，从`opStack`取出时就可能会因为不在同一个栈而出错
-                size_t* addr = (size_t*)malloc(sizeof(size_t));
-                input.read((char*)addr, sizeof(addr));
+                // 必须在堆上分配空间，否则数据默认放在栈上，从`opStack`取出时就可能会因为不在同一个栈而出错
+                size_t* addr = mem.newAddr(target(pc, width, ip));
 
                 NlObject object;
                 object.type = POINTER;
@@ -146,8 +1110,7 @@ void Nvm::execute(void) {
 
             case STORE_LOCAL: {
                 // 预热
-                size_t id;
-                input.read((char*)&id, sizeof(id));
+                size_t id = operand(pc, width);
 
                 if(! thread.sp -> opStack.size()) {
                     error("the STORE_LOCAL instruction requires one operand");
@@ -162,8 +1125,7 @@ void Nvm::execute(void) {
 
             case STORE_GLOBAL: {
                 // 预热
-                size_t id;
-                input.read((char*)&id, sizeof(id));
+                size_t id = operand(pc, width);
                 if(! thread.sp -> opStack.size()) {
                     error("the STORE_GLOBAL instruction requires one operand");
                 }
@@ -428,9 +1390,7 @@ void Nvm::execute(void) {
             }
 
             case JMP: {
-                size_t offset;
-                input.read((char*)&offset, sizeof(offset));
-                input.seekg(offset, std::ios::beg);
+                pc = target(pc, width, ip);
                 break;
             }
 
@@ -440,10 +1400,10 @@ void Nvm::execute(void) {
                     error("the JMPC instruction requires an operand");
                 }
 
+                // 无论是否跳转都必须读出参数，否则参数会被当作下一条指令执行
+                size_t offset = target(pc, width, ip);
                 if(objectToBool(thread.sp -> opStack[thread.sp -> opStack.size() - 1])) {
-                    size_t offset;
-                    input.read((char*)&offset, sizeof(offset));
-                    input.seekg(offset, std::ios::beg);
+                    pc = offset;
                 }
                 
                 break;
@@ -461,13 +1421,27 @@ void Nvm::execute(void) {
 
                 NlObject object = thread.sp -> opStack[thread.sp -> opStack.size() - 2];
                 size_t addr = *(size_t*)thread.sp -> opStack[thread.sp -> opStack.size() - 1].pointer;
-                input.seekg(addr, std::ios::beg);
+                thread.sp -> opStack.pop_back();
+                thread.sp -> opStack.pop_back();
+                size_t returnAddress = pc;   // 必须在跳转前记录，否则返回地址就成了被调用函数的起始地址
+                pc = addr;
 
                 StackFrame stackFrame;
                 thread.stack.push_back(stackFrame); // 创建新栈帧
                 thread.sp = &thread.stack[thread.stack.size() - 1]; // 修改`sp`指向最新帧
-                thread.sp -> returnAddress = input.tellg();
+                thread.sp -> returnAddress = returnAddress;
                 thread.sp -> opStack.push_back(object);
+                mem.record(Nmem::mem_frame, sizeof(StackFrame));
+                STAP_PROBE2(nl, call_entry, addr, thread.stack.size() - 1);
+
+                if(profiling) {
+                    size_t depth = cursor.depth;
+                    if(depth < Nprof::maxDepth) {
+                        cursor.chain[depth] = returnAddress;
+                    }
+
+                    cursor.depth = depth + 1;
+                }
 
                 break;
             }
@@ -488,7 +1462,38 @@ void Nvm::execute(void) {
 
                 ListObject* args = (ListObject*)thread.sp -> opStack[thread.sp -> opStack.size() - 2].pointer;
                 NlEFNTemplate externFN = (NlEFNTemplate)(thread.externFNTable[externFNName]);
-                NlObject returnValue = *(externFN(&thread, args));
+                STAP_PROBE1(nl, extern_entry, externFNName.c_str());
+                NlObject* returned = externFN(&thread, args);
+                STAP_PROBE1(nl, extern_return, externFNName.c_str());
+
+                // 外部函数通过`nlWait`挂起，`fd`就绪后重新执行这条`CALLE`，栈保持不变
+                if(thread.waitFD >= 0) {
+                    int fd = thread.waitFD, events = thread.waitEvents;
+                    thread.waitFD = - 1;
+                    STAP_PROBE2(nl, io_wait, fd, events);
+
+                    Ntask* self = Nsched::current;
+                    contextGuard.count --;  // 重新执行时再计数
+                    if(self && &self -> thread == &thread) {
+                        self -> pc = ip;
+                        scheduler() -> waitExternal();
+                        poller() -> wait(fd, events, self);
+                        return false;
+                    }
+
+                    Npoll::block(fd, events);
+                    pc = ip;
+                    break;
+                }
+
+                NlObject returnValue = *returned;
+
+                // 外部函数的返回值（及其返回的字符串）由外部函数在堆上分配且不会被释放，全部计入`extern`
+                // `new NlObject()`得到的空返回值类型为`STRING`但指针为空
+                mem.record(Nmem::mem_extern, sizeof(NlObject));
+                if(returnValue.type == STRING && returnValue.string) {
+                    mem.record(Nmem::mem_extern, sizeof(std::string) + returnValue.string -> capacity());
+                }
 
                 thread.sp -> opStack.pop_back();
                 thread.sp -> opStack[thread.sp -> opStack.size() - 1] = returnValue;
@@ -508,10 +1513,21 @@ void Nvm::execute(void) {
                 }
 
                 NlObject object = thread.sp -> opStack[thread.sp -> opStack.size() - 1];
-                input.seekg(thread.sp -> returnAddress, std::ios::beg);
+                size_t returnAddress = thread.sp -> returnAddress;
+                pc = returnAddress;
                 thread.stack.pop_back();
+                mem.release(Nmem::mem_frame, sizeof(StackFrame));
+                if(thread.region) {
+                    thread.region -> leave(thread.stack.size());
+                }
+
                 thread.sp = &thread.stack[thread.stack.size() - 1];
                 thread.sp -> opStack.push_back(object);
+                STAP_PROBE2(nl, call_return, returnAddress, thread.stack.size() - 1);
+
+                if(profiling) {
+                    cursor.depth = cursor.depth - 1;
+                }
 
                 break;
             }
@@ -519,7 +1535,8 @@ void Nvm::execute(void) {
             case MAKE_LIST: {
                 NlObject object;
                 object.type = POINTER;
-                object.pointer = new ListObject();
+                object.pointer = (frameLocal(ip) ? region(thread) -> newList(thread.stack.size() - 1) : mem.newList());
+                STAP_PROBE1(nl, list_alloc, object.pointer);
 
                 thread.sp -> opStack.push_back(object);
                 break;
@@ -613,6 +1630,34 @@ void Nvm::execute(void) {
                     object.type = NUM;
                     object.num = (*list).size();
                     thread.sp -> opStack.push_back(object);
+                } else if(actionName == "PARALLEL_MAP") {
+                    // PARALLEL_MAP [List] [Address]，以每个元素为参数并行调用函数，结果按原顺序组成新的`list`替换函数地址
+                    if(thread.sp -> opStack.size() < 2
+                    || thread.sp -> opStack[thread.sp -> opStack.size() - 1].type != POINTER
+                    || thread.sp -> opStack[thread.sp -> opStack.size() - 2].type != POINTER) {
+                        error("the ACTION_LIST(PARALLEL_MAP ACTION) command parameter is incorrect");
+                    }
+
+                    ListObject* list = (ListObject*)thread.sp -> opStack[thread.sp -> opStack.size() - 2].pointer;
+                    size_t addr = *(size_t*)thread.sp -> opStack[thread.sp -> opStack.size() - 1].pointer;
+                    NlObject object;
+                    object.type = POINTER;
+                    object.pointer = parallelMap(thread, list, addr);
+                    thread.sp -> opStack[thread.sp -> opStack.size() - 1] = object;
+                } else if(actionName == "PARALLEL_REDUCE") {
+                    // PARALLEL_REDUCE [List] [Address] [Init]，以`[累积值, 元素]`为参数调用函数，结果替换函数地址及初始值
+                    if(thread.sp -> opStack.size() < 3
+                    || thread.sp -> opStack[thread.sp -> opStack.size() - 2].type != POINTER
+                    || thread.sp -> opStack[thread.sp -> opStack.size() - 3].type != POINTER) {
+                        error("the ACTION_LIST(PARALLEL_REDUCE ACTION) command parameter is incorrect");
+                    }
+
+                    ListObject* list = (ListObject*)thread.sp -> opStack[thread.sp -> opStack.size() - 3].pointer;
+                    size_t addr = *(size_t*)thread.sp -> opStack[thread.sp -> opStack.size() - 2].pointer;
+                    NlObject init = thread.sp -> opStack[thread.sp -> opStack.size() - 1];
+                    NlObject result = parallelReduce(thread, list, addr, init);
+                    thread.sp -> opStack.pop_back();
+                    thread.sp -> opStack[thread.sp -> opStack.size() - 1] = result;
                 } else {
                     error("there is no " + actionName + " operation in the ACTION_LIST instruction");
                 }
@@ -623,7 +1668,8 @@ void Nvm::execute(void) {
             case MAKE_MAP: {
                 NlObject object;
                 object.type = POINTER;
-                object.pointer = new MapObject();
+                object.pointer = (frameLocal(ip) ? region(thread) -> newMap(thread.stack.size() - 1) : mem.newMap());
+                STAP_PROBE1(nl, map_alloc, object.pointer);
 
                 thread.sp -> opStack.push_back(object);
                 break;
@@ -651,7 +1697,14 @@ void Nvm::execute(void) {
                     MapObject* map = (MapObject*)thread.sp -> opStack[thread.sp -> opStack.size() - 3].pointer;
                     std::string keyName = *(thread.sp -> opStack[thread.sp -> opStack.size() - 2].string);
 
-                    (*map)[keyName] = thread.sp -> opStack[thread.sp -> opStack.size() - 1];
+                    // 键为`std::pmr::string`，新键在`map`的内存资源中构造
+                    auto found = map -> find(keyName);
+                    if(found != map -> end()) {
+                        found -> second = thread.sp -> opStack[thread.sp -> opStack.size() - 1];
+                    } else {
+                        map -> emplace(keyName, thread.sp -> opStack[thread.sp -> opStack.size() - 1]);
+                    }
+
                     thread.sp -> opStack.pop_back();
                     thread.sp -> opStack.pop_back();
                 } else if(actionName == "DEL") {
@@ -663,11 +1716,12 @@ void Nvm::execute(void) {
 
                     MapObject* map = (MapObject*)thread.sp -> opStack[thread.sp -> opStack.size() - 2].pointer;
                     std::string keyName = *(thread.sp -> opStack[thread.sp -> opStack.size() - 1].string);
-                    if(! map -> count(keyName)) {
+                    auto found = map -> find(keyName);
+                    if(found == map -> end()) {
                         error("ACTION_MAP(DEL ACTION): " + keyName + " key does not exist in the map");
                     }
 
-                    map -> erase(keyName);
+                    map -> erase(found);
                     thread.sp -> opStack.pop_back();
                 } else if(actionName == "GET") {
                     if(thread.sp -> opStack.size() < 2
@@ -696,19 +1750,19 @@ void Nvm::execute(void) {
                             }
 
                             // `__proto__`属性必须为`map`
-                            if((*map)["__proto__"].type != POINTER) {
+                            if(map -> find("__proto__") -> second.type != POINTER) {
                                 error("ACTION_MAP(GET ACTION): __ proto__ property must be map");
                             }
 
                             // 在原型中找到目标`key`就停止
-                            map = (MapObject*)((*map)["__proto__"].pointer);
+                            map = (MapObject*)(map -> find("__proto__") -> second.pointer);
                             if(map -> count(keyName)) {
                                 break;
                             }
                         }
                     }
 
-                    thread.sp -> opStack[thread.sp -> opStack.size() - 1] = (*map)[keyName];
+                    thread.sp -> opStack[thread.sp -> opStack.size() - 1] = map -> find(keyName) -> second;
                 } else if(actionName == "LEN") {
                     if(thread.sp -> opStack.size() < 1
                     || thread.sp -> opStack[thread.sp -> opStack.size() - 1].type != POINTER) {
@@ -742,48 +1796,266 @@ void Nvm::execute(void) {
                     error("the IMPORT instruction requires an operand");
                 }
 
-                // 不同平台处理方式也不同
-                // 首先获取`driver`函数，通过调用其返回的列表得到外部共享库提供的所有外部函数名，再一一通过函数名找到对应函数将其存储至外部函数表以供`CALLE`调用外部函数使用
-                #if(defined __linux__)
-                    std::string soFileName = *(thread.sp -> opStack[thread.sp -> opStack.size() - 1].string);
-                    void* handler = dlopen(soFileName.c_str(), RTLD_LAZY);  // 需要时再加载
-                    if(! handler) {
-                        error("IMPORT: " + std::string(dlerror()));  // 使用`dlerror`获取详细报错信息
+                // 共享库由`prog`加载并解析，同一程序的所有隔离区及线程共用，这里只将外部函数存储至外部函数表以供`CALLE`调用外部函数使用
+                std::string soFileName = *(thread.sp -> opStack[thread.sp -> opStack.size() - 1].string);
+                const Nprog::Module& module = prog -> import(soFileName);
+                imported(soFileName);
+                for(auto& externFN : module) {
+                    // 出现重名现象立即报错，以防止多个链接库重名难以排查的问题
+                    if(thread.externFNTable.count(externFN.first)) {
+                        error("IMPORT: " + soFileName + ": " + "External function " + externFN.first + " already exists");
                     }
 
-                    void* driver = dlsym(handler, "driver");
-                    if(driver == NULL) {
-                        error("IMPORT: driver: " + std::string(dlerror()));
+                    thread.externFNTable[externFN.first] = externFN.second;
+                }
+
+                STAP_PROBE2(nl, import, soFileName.c_str(), module.size());
+
+                thread.sp -> opStack.pop_back();
+                break;
+            }
+
+            // 结束执行而不直接`exit`，以便执行结束后的收尾工作（如输出采样结果）
+            case EXIT: {
+                return true;
+            }
+
+            case NOP: {
+                break;
+            }
+
+            case SNAPSHOT: {
+                // 写出快照后与`EXIT`相同地结束执行，`pc`已指向下一条指令
+                if(option.snapshotOut != "") {
+                    saveSnapshot(thread, pc);
+                    return true;
+                }
+
+                break;
+            }
+
+            case SPAWN: {
+                // SPAWN [Args(List)] [Address]，参数与`CALL`相同，压入线程句柄
+                if(thread.sp -> opStack.size() < 2
+                || thread.sp -> opStack[thread.sp -> opStack.size() - 1].type != POINTER
+                || thread.sp -> opStack[thread.sp -> opStack.size() - 2].type != POINTER) {
+                    error("the SPAWN command parameter is incorrect");
+                }
+
+                ListObject* args = (ListObject*)thread.sp -> opStack[thread.sp -> opStack.size() - 2].pointer;
+                size_t addr = *(size_t*)thread.sp -> opStack[thread.sp -> opStack.size() - 1].pointer;
+                thread.sp -> opStack.pop_back();
+
+                NlObject object;
+                object.type = POINTER;
+                object.pointer = spawn(thread, addr, args);
+                thread.sp -> opStack[thread.sp -> opStack.size() - 1] = object;
+                STAP_PROBE2(nl, thread_spawn, addr, object.pointer);
+                break;
+            }
+
+            case JOIN: {
+                // JOIN [Thread] 等待线程结束，将线程句柄替换为其返回值，线程出错时在此报错
+                if(thread.sp -> opStack.size() < 1
+                || thread.sp -> opStack[thread.sp -> opStack.size() - 1].type != POINTER) {
+                    error("the JOIN instruction requires an operand");
+                }
+
+                Spawned* handle = (Spawned*)thread.sp -> opStack[thread.sp -> opStack.size() - 1].pointer;
+                thread.sp -> opStack[thread.sp -> opStack.size() - 1] = join(handle);
+                STAP_PROBE1(nl, thread_join, handle);
+                break;
+            }
+
+            case TASK: {
+                // TASK [Args(List)] [Address]，参数与`CALL`相同，压入任务句柄
+                if(thread.sp -> opStack.size() < 2
+                || thread.sp -> opStack[thread.sp -> opStack.size() - 1].type != POINTER
+                || thread.sp -> opStack[thread.sp -> opStack.size() - 2].type != POINTER) {
+                    error("the TASK command parameter is incorrect");
+                }
+
+                ListObject* args = (ListObject*)thread.sp -> opStack[thread.sp -> opStack.size() - 2].pointer;
+                size_t addr = *(size_t*)thread.sp -> opStack[thread.sp -> opStack.size() - 1].pointer;
+                thread.sp -> opStack.pop_back();
+
+                NlObject object;
+                object.type = POINTER;
+                object.pointer = newTask(thread, addr, args);
+                thread.sp -> opStack[thread.sp -> opStack.size() - 1] = object;
+                STAP_PROBE2(nl, task_spawn, addr, object.pointer);
+                break;
+            }
+
+            case AWAIT: {
+                // AWAIT [Task] 将任务句柄替换为其返回值，任务出错时在此报错
+                if(thread.sp -> opStack.size() < 1
+                || thread.sp -> opStack[thread.sp -> opStack.size() - 1].type != POINTER) {
+                    error("the AWAIT instruction requires an operand");
+                }
+
+                Ntask* task = (Ntask*)thread.sp -> opStack[thread.sp -> opStack.size() - 1].pointer;
+                {
+                    std::lock_guard<std::mutex> lock(tasksMutex);
+                    if(! tasks.count(task) || (task -> awaitedBy && task -> awaitedBy != &thread)) {
+                        error("the AWAIT instruction requires a task that has not been awaited");
                     }
 
-                    std::vector<std::string> externFNNameTable = *(((NlEDTemplate)driver)());
-                    for(auto externFNName : externFNNameTable) {
-                        // 出现重名现象立即报错，以防止多个链接库重名难以排查的问题
-                        if(thread.externFNTable.count(externFNName)) {
-                            error("IMPORT: " + soFileName + ": " + "External function " + externFNName + " already exists");
-                        }
+                    task -> awaitedBy = &thread;
+                }
 
-                        void* externFN = dlsym(handler, externFNName.c_str());
-                        if(externFN == NULL) {
-                            error("IMPORT: " + std::string(dlerror()));
-                        }
+                std::unique_lock<std::mutex> lock(task -> lock);
+                if(! task -> done) {
+                    Ntask* self = Nsched::current;
+                    if(self && &self -> thread == &thread) {
+                        // 挂起，等待的任务结束后从这条`AWAIT`重新执行，登记后任务随时可能被唤醒，必须先保存`pc`
+                        self -> pc = ip;
+                        task -> waiter = self;
+                        contextGuard.count --;  // 唤醒后重新执行时再计数
+                        return false;
+                    }
+
+                    task -> finished.wait(lock, [task]() { return task -> done; });
+                }
 
-                        thread.externFNTable[externFNName] = externFN;
+                lock.unlock();
+                {
+                    std::lock_guard<std::mutex> registry(tasksMutex);
+                    tasks.erase(task);
+                }
+
+                NlObject result = task -> result;
+                std::string err = task -> err;
+                delete task;
+                mem.release(Nmem::mem_task, sizeof(*task));
+                STAP_PROBE1(nl, task_await, task);
+
+                if(err != "") {
+                    error("AWAIT: " + err);
+                }
+
+                thread.sp -> opStack[thread.sp -> opStack.size() - 1] = result;
+                break;
+            }
+
+            case MAKE_CHANNEL: {
+                if(thread.sp -> opStack.size() < 1
+                || thread.sp -> opStack[thread.sp -> opStack.size() - 1].type != NUM
+                || thread.sp -> opStack[thread.sp -> opStack.size() - 1].num < 0) {
+                    error("the MAKE_CHANNEL instruction requires a capacity");
+                }
+
+                Nchan* chan = new Nchan(thread.sp -> opStack[thread.sp -> opStack.size() - 1].num);
+                mem.record(Nmem::mem_channel, chan -> bytes());
+
+                NlObject object;
+                object.type = POINTER;
+                object.pointer = chan;
+                thread.sp -> opStack[thread.sp -> opStack.size() - 1] = object;
+                break;
+            }
+
+            case SEND: {
+                if(thread.sp -> opStack.size() < 2
+                || thread.sp -> opStack[thread.sp -> opStack.size() - 2].type != POINTER) {
+                    error("the SEND command parameter is incorrect");
+                }
+
+                Nchan* chan = (Nchan*)thread.sp -> opStack[thread.sp -> opStack.size() - 2].pointer;
+                NlObject value = thread.sp -> opStack[thread.sp -> opStack.size() - 1];
+                Ntask* self = Nsched::current;
+                Nchan::Result result;
+                if(self && &self -> thread == &thread) {
+                    // 不阻塞工作线程，登记到通道上挂起，通道变化后重新执行这条`SEND`，登记后任务随时可能被唤醒，必须先保存`pc`
+                    self -> pc = ip;
+                    result = chan -> parkSend(value, self, scheduler());
+                    if(result == Nchan::chan_again) {
+                        contextGuard.count --;
+                        return false;
                     }
-                #elif(defined _WIN32 || defined _WIN64)
-                #endif
-                
+                } else {
+                    result = chan -> send(value);
+                }
+
+                if(result == Nchan::chan_closed) {
+                    error("SEND: the channel is closed");
+                }
+
                 thread.sp -> opStack.pop_back();
                 break;
             }
 
-            case EXIT: {
-                exit(0);
+            case RECV: case TRY_RECV: {
+                if(thread.sp -> opStack.size() < 1
+                || thread.sp -> opStack[thread.sp -> opStack.size() - 1].type != POINTER) {
+                    error("the " + std::string(mnem == RECV ? "RECV" : "TRY_RECV") + " instruction requires a channel");
+                }
+
+                Nchan* chan = (Nchan*)thread.sp -> opStack[thread.sp -> opStack.size() - 1].pointer;
+                NlObject value;
+                value.type = NUM;
+                value.num = 0;
+
+                Ntask* self = Nsched::current;
+                Nchan::Result result;
+                if(mnem == TRY_RECV) {
+                    result = chan -> tryRecv(value);
+                } else if(self && &self -> thread == &thread) {
+                    self -> pc = ip;
+                    result = chan -> parkRecv(value, self, scheduler());
+                    if(result == Nchan::chan_again) {
+                        contextGuard.count --;
+                        return false;
+                    }
+                } else {
+                    result = chan -> recv(value);
+                }
+
+                NlObject status;
+                status.type = NUM;
+                status.num = (result == Nchan::chan_ok ? 1 : (result == Nchan::chan_again || mnem == RECV ? 0 : - 1));
+                thread.sp -> opStack.push_back(value);
+                thread.sp -> opStack.push_back(status);
+                break;
             }
 
-            case NOP: {
+            case CLOSE: {
+                if(thread.sp -> opStack.size() < 1
+                || thread.sp -> opStack[thread.sp -> opStack.size() - 1].type != POINTER) {
+                    error("the CLOSE instruction requires a channel");
+                }
+
+                ((Nchan*)thread.sp -> opStack[thread.sp -> opStack.size() - 1].pointer) -> close();
+                break;
+            }
+
+            case PROMOTE: {
+                // PROMOTE [Value]
+                if(thread.sp -> opStack.size() < 1) {
+                    error("the PROMOTE instruction requires an operand");
+                }
+
+                NlObject& top = thread.sp -> opStack[thread.sp -> opStack.size() - 1];
+                top = promote(top);
                 break;
             }
+
+            case YIELD: {
+                // 任务让出工作线程，放到注入队列末尾，其他线程中只让出时间片
+                Ntask* self = Nsched::current;
+                if(self && &self -> thread == &thread) {
+                    self -> pc = pc;
+                    scheduler() -> yield(self);
+                    return false;
+                }
+
+                std::this_thread::yield();
+                break;
+            }
+        }
+
+        if(perfSample) {
+            perf -> sampleEnd(mnem);
         }
     }
 }
\ No newline at end of file
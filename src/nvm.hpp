@@ -11,30 +11,239 @@
 #include <iostream>
 #include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <memory>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <string_view>
+#include <unordered_set>
+#include <unordered_map>
 
 #include "nl.hpp"
+#include "sdt.hpp"
+#include "ndbg.hpp"
+#include "nprof.hpp"
+#include "nperf.hpp"
+#include "nmem.hpp"
+#include "nmap.hpp"
+#include "nsched.hpp"
+#include "nchan.hpp"
+#include "nprog.hpp"
+#include "npoll.hpp"
 #include "global.hpp"
 #include "nlc_def.hpp"
 #include "mnem_def.hpp"
 
-// 不同平台访问共享文件的`API`不同（现仅支持`Windows`和`Linux`两个系统）
-#if(defined __linux__)
-    #include <dlfcn.h>
-#elif(defined _WIN32 || defined _WIN64)
-#endif
+// 虚拟机运行选项，由命令行传入
+struct NvmOption {
+    std::string profileFileName = "";   // 不为空时开启采样分析，并将折叠栈格式的结果写入该文件
+    int profileHz = 99;     // 采样频率，不使用整百的频率以免与程序中的周期性行为同步
+    bool perfStats = false;     // 统计硬件性能计数器，结束时输出到`stderr`
+    bool perfByClass = false;   // 同时按指令类别统计
+    bool memStats = false;  // 结束时及收到`SIGUSR1`时输出按对象类别统计的内存使用情况
+    bool memSites = false;  // 同时按字节码偏移统计分配位置
+    bool instrCount = false;    // 结束时输出执行的指令条数
+    std::string imageCache = "";    // 不为空时在该目录中查找或生成程序镜像，见`NlcFile::ImageHeader`
+    size_t taskWorkers = 0;     // 执行`TASK`的工作线程数，为`0`时与CPU核数相同
+    bool arena = false;     // 每次执行（`run`、`Nlib::run`、`Nlib::call`）都在请求作用域中进行，结束时一次性释放，见`PROMOTE`
+    bool escapeAnalysis = true;     // 加载时做逃逸分析，不逃出栈帧的`list`、`map`从`Nregion`分配，见`Nesc`
+    std::string snapshot = "";  // 不为空时先从该堆快照恢复，再从`SNAPSHOT`之后执行，见`NlcFile::SnapshotHeader`
+    std::string snapshotOut = "";   // 不为空时执行到`SNAPSHOT`时写出堆快照并结束执行
+};
 
+/*
+ * USDT静态探针（提供者为`nl`，未附加时只是一条`nop`）：
+ * call_entry(目标地址, 调用深度)     call_return(返回地址, 调用深度)
+ * extern_entry(外部函数名)          extern_return(外部函数名)
+ * import(共享库文件名, 导入的外部函数数量)
+ * list_alloc(list地址)             map_alloc(map地址)
+ * thread_spawn(目标地址, 线程句柄)   thread_join(线程句柄)
+ * task_spawn(目标地址, 任务句柄)     task_await(任务句柄)
+ * io_wait(fd, 事件)
+ *
+ * `SPAWN`/`JOIN`：每个`SPAWN`的线程对应一个系统线程，拥有独立的`Nlthread`，程序镜像、常量及统计由所有线程共用
+ * 执行状态（`ip`、`pc`等）都在`execute`的局部变量或`Nlthread`中，所以`execute`可以在多个系统线程中同时执行不同的`Nlthread`
+ * 没有`JOIN`的线程在`Nvm`析构时等待其结束
+ *
+ * `TASK`/`AWAIT`/`YIELD`：任务是只有自己的`Nlthread`的轻量线程，由`Nsched`调度到工作线程上执行
+ * 任务中`AWAIT`尚未结束的任务或`YIELD`时挂起，让出工作线程，不是任务的线程`AWAIT`时阻塞等待
+ * 每个任务只能被`AWAIT`一次，没有`AWAIT`的任务在`Nvm`析构时等待其结束
+ *
+ * `ACTION_LIST`的`PARALLEL_MAP`/`PARALLEL_REDUCE`：将`list`分块，由当前线程及`Nsched`的工作线程各用独立的`Nlthread`调用函数，结果按原顺序合并
+ * 函数应是纯函数：只读取参数及全局变量，不修改共享的`list`、`map`，其中的`AWAIT`阻塞等待而不挂起
+ * `PARALLEL_REDUCE`的函数还必须满足结合律，各块先分别从第一个元素开始归约，再从初始值开始按顺序归约各块的结果
+ *
+ * 隔离区：每个`Nvm`为一个隔离区，拥有各自的`Nmem`、`SPAWN`的线程、任务调度器及统计，多个隔离区通过`Nprog`共用同一个已加载的程序，可以在不同的系统线程中同时执行
+ * 隔离区之间不共享`list`、`map`及通道，一个隔离区创建的对象不能传入另一个隔离区
+ *
+ * 外部函数通过`nlWait`挂起（见`nl.hpp`）：`CALLE`所在的任务让出工作线程，由`Npoll`在`fd`就绪后交还调度器，从这条`CALLE`重新执行
+ * 因此大量等待I/O的任务只占用一个事件循环线程，不是任务的线程中则阻塞等待后重新调用
+ *
+ * 请求作用域（`Nlib::beginScope`，或`option.arena`时的每次执行）：`MAKE_LIST`、`MAKE_MAP`、`LOAD_ADDR`创建的对象从`arena`分配，结束时一次性释放
+ * PROMOTE [Value]                     将作用域中创建的`list`、`map`、地址（及其中嵌套的，保持共享关系）复制到堆上，其他值不变
+ * `option.arena`时结束执行后全局变量中仍指向`arena`的值被删除，需要保留的值应`PROMOTE`后再存入；`Nlib::call`的返回值自动`PROMOTE`
+ * 作用域中不能使用`SPAWN`、`TASK`及并行的`list`操作
+ *
+ * 栈帧局部对象：逃逸分析证明不会逃出栈帧的`MAKE_LIST`/`MAKE_MAP`从线程的`Nregion`分配，`RET`时随栈帧一起回退
+ * 外部函数不能持有栈上的对象（见`nl.hpp`），否则应以`option.escapeAnalysis = false`（`--no-escape-analysis`）运行
+ * 只作为`CALLE`的参数的对象只在已导入的模块都借用参数（`NL_EXPORT_BORROWS_ARGS`）时从`Nregion`分配，
+ * 已经这样分配过之后再导入不借用参数的共享库时报错，应在程序开头导入
+ *
+ * 堆快照：`option.snapshotOut`时在请求作用域中从程序入口执行，到`SNAPSHOT`时写出全局变量、基栈帧的局部变量及操作数栈、
+ * 其中引用的`list`、`map`、地址及字符串以及已导入的外部函数，然后结束执行
+ * `option.snapshot`时`start`先从快照恢复这些值并重新导入共享库，再从`SNAPSHOT`的下一条指令执行，不再执行初始化部分
+ * SNAPSHOT                            只能在基栈帧中执行，不写出快照时与`NOP`相同
+ * 初始化部分在请求作用域中执行，所以不能使用`SPAWN`、`TASK`及并行的`list`操作，要写出的值中也不能有通道、句柄等其他指针
+ *
+ * 通道（见`Nchan`）：`SEND`在满时、`RECV`在空时，任务中让出工作线程后重新执行该指令，其他线程中阻塞等待
+ * MAKE_CHANNEL [Capacity]             容量为`0`时无界，替换为通道
+ * SEND [Channel] [Value]              弹出值，通道已关闭时报错
+ * RECV [Channel]                      压入值及`1`，通道已关闭且已读完时压入`0`及`0`
+ * TRY_RECV [Channel]                  不阻塞，压入值及`1`，通道为空时压入`0`及`0`，已关闭且已读完时压入`0`及`-1`
+ * CLOSE [Channel]                     关闭后不能再发送，已发送的值仍可读出
+ * 以上指令都保留通道在栈上
+ */
 class Nvm {
 public:
-    Nvm(std::string inputFileName);
+    Nvm(std::string inputFileName, NvmOption option = NvmOption());   // 只加载程序，出错时（及执行出错时）抛出`NlError`
+    Nvm(std::shared_ptr<Nprog> _prog, NvmOption option = NvmOption());    // 与其他隔离区共用已加载的程序，`option.imageCache`不起作用
+    ~Nvm();
+
+    void run(void);     // 在新线程中从程序入口执行，并按`option`输出统计结果
+
+    // 供嵌入接口`Nlib`使用，请求作用域中只能执行一个线程
+    void initThread(Nlthread& thread);  // 建立基栈帧
+    void resetThread(Nlthread& thread);
+    bool execute(Nlthread& thread, size_t entry);   // 从`entry`执行到`EXIT`或代码结束，任务挂起时返回`false`
+    bool start(Nlthread& thread);   // 从程序入口执行，`option.snapshot`时先恢复快照，`thread`应只有基栈帧
+    NlObject call(Nlthread& thread, size_t addr, ListObject* args);    // 以`args`为参数调用`addr`处的函数，返回其`RET`的值
+    bool find(std::string label, size_t& addr);     // 通过调试段查找标签
+    size_t entry(void) { return codeBegin; }
+    std::shared_ptr<Nprog> program(void) { return prog; }
+    ListObject* newList(void);
+    MapObject* newMap(void);
+    void beginScope(void);  // 见`Nmem`的请求作用域
+    void endScope(void);
+    bool arenaMode(void) { return option.arena && ! mem.scoped(); }   // 这次执行是否需要建立作用域（宿主已建立时不需要）
+    void dropScoped(Nlthread& thread);  // 删除全局变量中指向`arena`的值，在`endScope`之前调用
+    NlObject promote(NlObject value);   // 见`PROMOTE`
 
 private:
-    /************ Load File（加载文件）部分 ************/
-    std::ifstream input;
-    std::vector<NlcFile::Num> numTable;
-    std::vector<std::string> stringTable;
-    void loadFile(void);
+    NvmOption option;
+
+    /************ Program（程序）部分 ************/
+    std::shared_ptr<Nprog> prog;    // 只读部分由共用同一程序的所有隔离区共享
+
+    // 以下从`prog`拷贝，执行时少一次间接访问
+    const char* code;   // 取指的基址
+    uint32_t version;   // nlc格式版本，决定操作数的编码方式
+    const NlcFile::Num* numTable;
+    size_t numNum;
+    size_t stringNum;
+    std::atomic<std::string*>* stringCache;
+    size_t codeBegin;
+    size_t codeEnd;     // 代码段结束位置，其后可能为调试段
+    const uint64_t* localSites = nullptr;   // 逃逸分析的结果，见`Nesc::localSites`
+    const uint64_t* borrowSites = nullptr;  // 见`Nesc::borrowSites`，与`localSites`等长
+    size_t localWords = 0;
+    std::atomic<bool> lending{true};    // 已导入的模块都借用参数
+    std::atomic<bool> lent{false};  // 已按借用从`Nregion`分配过
+    void imported(std::string soFileName);  // 导入不借用参数的模块后不再按借用分配
+
+    std::string_view stringView(size_t id);
+    std::string* string(size_t id);
+    std::string describe(size_t offset);
+    std::string symbolize(size_t offset);
 
     /************ Execute（执行）部分 ************/
+    // `pc`为下一个要读取的字节，`width`为当前指令操作数宽度的对数，v1固定为`3`（8字节），`ip`为当前指令的起始位置
+    size_t operand(size_t& pc, int width);  // 读取一个操作数
+    size_t target(size_t& pc, int width, size_t ip);    // 读取一个标签操作数并转换为文件偏移
+    std::atomic<size_t> executed{0};    // 所有线程已执行的指令条数，各线程在`execute`结束时累加
+    std::atomic<Nlthread*> mainThread{nullptr};     // 采样分析及按类别统计只针对`run`的主线程
+    Nprof::Cursor cursor;   // 采样分析时记录执行位置
+    Nperf* perf = nullptr;  // 不为空时统计硬件性能计数器
+    Nmem mem;   // 所有对象的分配都经过`mem`以便统计
+    size_t perfCountdown = 1;   // 距下一条按类别采样的指令还有多少条
     bool objectToBool(NlObject object); // 将普通值转为布尔值
-    void execute(void);
+
+    // `ip`处创建的对象是否从`Nregion`分配
+    bool frameLocal(size_t ip) {
+        size_t i = ip - codeBegin;
+        if(i / 64 >= localWords) {
+            return false;
+        }
+
+        if(localSites[i / 64] >> (i % 64) & 1) {
+            return true;
+        }
+
+        // 先记下`lent`再读`lending`，与`imported`的顺序相反，两者同时发生时至少一方能看到另一方
+        if(borrowSites[i / 64] >> (i % 64) & 1) {
+            if(! lent.load(std::memory_order_relaxed)) {
+                lent.store(true);
+            }
+
+            return lending.load();
+        }
+
+        return false;
+    }
+
+    Nregion* region(Nlthread& thread);
+
+    // `SPAWN`创建的线程，`JOIN`时等待其结束并取得返回值
+    struct Spawned {
+        Nlthread thread;
+        std::thread os;
+        NlObject result;
+        std::string err = "";   // 不为空时线程因出错结束
+    };
+
+    std::mutex spawnedMutex;
+    std::unordered_set<Spawned*> spawned;   // 尚未`JOIN`的线程，`JOIN`时用于检查操作数
+    Spawned* spawn(Nlthread& parent, size_t addr, ListObject* args);
+    NlObject join(Spawned* handle);
+
+    std::mutex schedMutex;
+    std::atomic<Nsched*> sched{nullptr};    // 第一次执行`TASK`时才创建，没有任务的程序不启动工作线程
+    std::mutex tasksMutex;
+    std::unordered_set<Ntask*> tasks;   // 尚未`AWAIT`完成的任务，`AWAIT`时用于检查操作数
+    void enter(Nlthread& thread, ListObject* args);    // 与`CALL`相同地建立栈帧，返回地址为`codeEnd`
+    Nsched* scheduler(void);
+    std::atomic<Npoll*> poll{nullptr};  // 第一次有任务等待`fd`时才创建
+    Npoll* poller(void);
+    Ntask* newTask(Nlthread& parent, size_t addr, ListObject* args);
+    bool runTask(Ntask* task);
+
+    // `PARALLEL_MAP`/`PARALLEL_REDUCE`的一次执行，调用线程及辅助任务从`next`依次领取块
+    struct ParallelJob {
+        size_t chunkNum;
+        std::function<void(Nlthread&, size_t)> chunk;
+        std::atomic<size_t> next{0};
+        std::atomic<bool> failed{false};    // 出错后领取到的块直接跳过
+
+        std::mutex lock;    // 保护以下成员
+        std::condition_variable finished;
+        size_t done = 0;
+        std::string err = "";
+    };
+
+    static const size_t chunksPerWorker = 4;    // 块数多于工作线程数，各元素耗时不均时也能分摊
+    std::string parallel(Nlthread& thread, size_t chunkNum, std::function<void(Nlthread&, size_t)> chunk);  // 返回第一个出错的块的错误信息
+    NlObject apply(Nlthread& thread, size_t addr, std::vector<NlObject> args);
+    ListObject* parallelMap(Nlthread& thread, ListObject* list, size_t addr);
+    NlObject parallelReduce(Nlthread& thread, ListObject* list, size_t addr, NlObject init);
+
+    NlObject promote(NlObject value, std::unordered_map<const void*, void*>& copied);  // `copied`：已复制的对象，处理共享及循环引用
+
+    // 堆快照，见`NlcFile::SnapshotHeader`
+    bool snapshotSaved = false;
+    std::deque<std::string> snapshotStrings;    // 快照中外部函数返回的字符串，`deque`扩容时不移动已有元素
+    void saveSnapshot(Nlthread& thread, size_t resume);
+    size_t loadSnapshot(Nlthread& thread);  // 返回`SNAPSHOT`的下一条指令
 };
\ No newline at end of file
@@ -0,0 +1,62 @@
+/*
+ * @Author: CBH37
+ * @Date: 2026-10-19 10:41:52
+ * @Description: `SystemTap SDT`（USDT）静态探针的最小实现，与`<sys/sdt.h>`的`STAP_PROBEn`宏用法及生成的`.note.stapsdt`格式相同
+ */
+#pragma once
+
+/*
+ * 每个探针在代码中只是一条`nop`，另外在`.note.stapsdt`段中记录该`nop`的地址、提供者名、探针名及各参数的位置
+ * `perf`/`bpftrace`等工具附加探针时才将`nop`替换为断点，因此未附加时几乎没有开销
+ * 用法：STAP_PROBE2(nl, call_entry, addr, depth) 之后即可使用 `bpftrace -e 'usdt:./nl:nl:call_entry { @[arg0] = count(); }'`
+ * 参数描述为`size@operand`，有符号参数的`size`为负数，`operand`由编译器按`nor`约束填入（寄存器、内存或立即数）
+ * 不支持的平台或定义了`NL_NO_SDT`时探针宏为空
+ */
+#if(defined __linux__ && (defined __x86_64__ || defined __aarch64__) && ! defined NL_NO_SDT)
+    #define _SDT_SIGNED(x) ((__typeof__(x)) - 1 < (__typeof__(x)) 1)
+    #define _SDT_SIZE(x) ((_SDT_SIGNED(x) ? 1 : - 1) * (int)sizeof(x))    // `%n`输出时会再取反一次
+
+    #define _SDT_ARG(n, x) [_SDT_S##n] "n" (_SDT_SIZE(x)), [_SDT_A##n] "nor" (x)
+    #define _SDT_ARGFMT(n) "%n[_SDT_S" #n "]@%[_SDT_A" #n "]"
+
+    #define _SDT_ASM(provider, name, argfmt) \
+        "990: nop\n" \
+        ".pushsection .note.stapsdt,\"?\",\"note\"\n" \
+        ".balign 4\n" \
+        ".4byte 992f-991f, 994f-993f, 3\n" \
+        "991: .asciz \"stapsdt\"\n" \
+        "992: .balign 4\n" \
+        "993: .8byte 990b\n" \
+        ".8byte _.stapsdt.base\n" \
+        ".8byte 0\n" \
+        ".asciz \"" #provider "\"\n" \
+        ".asciz \"" #name "\"\n" \
+        ".asciz \"" argfmt "\"\n" \
+        "994: .balign 4\n" \
+        ".popsection\n" \
+        ".ifndef _.stapsdt.base\n" \
+        ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+        ".weak _.stapsdt.base\n" \
+        ".hidden _.stapsdt.base\n" \
+        "_.stapsdt.base: .space 1\n" \
+        ".size _.stapsdt.base, 1\n" \
+        ".popsection\n" \
+        ".endif\n"
+
+    #define STAP_PROBE(provider, name) \
+        __asm__ __volatile__ (_SDT_ASM(provider, name, "") :: )
+    #define STAP_PROBE1(provider, name, a1) \
+        __asm__ __volatile__ (_SDT_ASM(provider, name, _SDT_ARGFMT(1)) \
+            :: _SDT_ARG(1, a1))
+    #define STAP_PROBE2(provider, name, a1, a2) \
+        __asm__ __volatile__ (_SDT_ASM(provider, name, _SDT_ARGFMT(1) " " _SDT_ARGFMT(2)) \
+            :: _SDT_ARG(1, a1), _SDT_ARG(2, a2))
+    #define STAP_PROBE3(provider, name, a1, a2, a3) \
+        __asm__ __volatile__ (_SDT_ASM(provider, name, _SDT_ARGFMT(1) " " _SDT_ARGFMT(2) " " _SDT_ARGFMT(3)) \
+            :: _SDT_ARG(1, a1), _SDT_ARG(2, a2), _SDT_ARG(3, a3))
+#else
+    #define STAP_PROBE(provider, name)
+    #define STAP_PROBE1(provider, name, a1)
+    #define STAP_PROBE2(provider, name, a1, a2)
+    #define STAP_PROBE3(provider, name, a1, a2, a3)
+#endif
\ No newline at end of file
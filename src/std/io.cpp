@@ -6,17 +6,34 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <mutex>
+#include <cerrno>
+
+#include <poll.h>
+#include <unistd.h>
 
 #include "nl.hpp"
 
 // 为了防止`cpp`重载函数导致`dlopen`时找不到对应符号，使用`C`编译方式
-extern "C" {
+// 作为内置模块编译进`nl`（`NL_BUILTIN`）时放在匿名命名空间中不导出，只通过`Nmod`登记，不会与其他内置模块的函数重名
+#ifdef NL_BUILTIN
+    #include "nmod.hpp"
+    #define NL_MODULE_BEGIN namespace {
+#else
+    #define NL_MODULE_BEGIN extern "C" {
+    NL_EXPORT_ABI_VERSION;
+    NL_EXPORT_BORROWS_ARGS;
+#endif
+
+NL_MODULE_BEGIN
+#ifndef NL_BUILTIN
     std::vector<std::string>* driver(void) {
         std::vector<std::string>* externFNNameTable = new std::vector<std::string>();
         *externFNNameTable = { "print", "input" };
 
         return externFNNameTable;
     }
+#endif
 
     // 可输出0个或多个数字或字符串
     NlObject* print(Nlthread* thread, ListObject* args) {
@@ -43,7 +60,13 @@ extern "C" {
         return returnValue;
     }
 
+    // 标准输入按块读入此缓冲区，取出其中完整的一行；`std::cin`的缓冲无法判断是否还能不阻塞地读出一行，所以不再使用
+    static std::mutex inputMutex;
+    static std::string inputBuffer;
+    static bool inputEnd = false;
+
     // 与`Python`的`raw_input`函数相似获取整行输入并将其作为字符串返回
+    // 还没有完整的一行时不阻塞，通过`nlWait`挂起，在任务中调用时其他任务可以继续执行
     NlObject* input(Nlthread* thread, ListObject* args) {
         // `input`函数不需要参数
         if((*args).size() > 0) {
@@ -51,9 +74,26 @@ extern "C" {
             exit(- 1);
         }
 
+        std::lock_guard<std::mutex> lock(inputMutex);
+        size_t newline;
+        while((newline = inputBuffer.find('\n')) == std::string::npos && ! inputEnd) {
+            pollfd target = { .fd = STDIN_FILENO, .events = POLLIN, .revents = 0 };
+            if(poll(&target, 1, 0) == 0) {
+                return nlWait(thread, STDIN_FILENO, NL_READABLE);
+            }
+
+            char chunk[4096];
+            ssize_t n = read(STDIN_FILENO, chunk, sizeof(chunk));
+            if(n > 0) {
+                inputBuffer.append(chunk, n);
+            } else if(n == 0 || (errno != EINTR && errno != EAGAIN)) {
+                inputEnd = true;    // 与`std::getline`相同，读到末尾后返回剩余内容，之后都返回空字符串
+            }
+        }
+
         // `target`不使用`new`就会在栈上分配，外部函数端与虚拟机端的栈不同从而就会发生差错，所以必须使用`new`在堆上分配
-        std::string* target = new std::string();
-        std::getline(std::cin, *target);
+        std::string* target = new std::string(inputBuffer.substr(0, newline));
+        inputBuffer.erase(0, newline == std::string::npos ? std::string::npos : newline + 1);
 
         NlObject* returnValue = new NlObject();
         (*returnValue).type = STRING;
@@ -61,4 +101,8 @@ extern "C" {
 
         return returnValue;
     }
-}
\ No newline at end of file
+}
+
+#ifdef NL_BUILTIN
+    NL_BUILTIN_MODULE(io, { { "print", (void*)print }, { "input", (void*)input } });
+#endif
\ No newline at end of file